@@ -644,7 +644,9 @@ void DkBaseViewPort::draw(QPainter *painter, float opacity) {
 	float oldOp = (float)painter->opacity();
 	painter->setOpacity(opacity);
 
-	if (!movie || !movie->isValid())
+	if ((!movie || !movie->isValid()) && imgStorage.isTiled())
+		imgStorage.drawTiles(painter, imgViewRect, (float)(imgMatrix.m11()*worldMatrix.m11()));
+	else if (!movie || !movie->isValid())
 		painter->drawImage(imgViewRect, imgQt, imgQt.rect());
 	else
 		painter->drawPixmap(imgViewRect, movie->currentPixmap(), movie->frameRect());
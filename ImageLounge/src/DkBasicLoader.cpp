@@ -43,9 +43,24 @@
 #include <QNetworkReply>
 #include <QBuffer>
 #include <QNetworkProxyFactory>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <QMutex>
+#include <QCache>
+#include <QDateTime>
+
+#if QT_VERSION >= 0x050100
+#include <QSaveFile>
+#endif
 
 #include <qmath.h>
 
+// SIMD kernel for developing RAW images
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DK_SSE2
+#include <emmintrin.h>
+#endif
+
 // quazip
 #ifdef WITH_QUAZIP
 #include <quazip/JlCompress.h>
@@ -106,20 +121,24 @@ DkBasicLoader::DkBasicLoader(int mode) {
 	numPages = 1;
 	pageIdx = 1;
 	loader = no_loader;
+	tiffHandle = 0;
+	prefetchEnabled = true;
 
 	this->metaData = QSharedPointer<DkMetaDataT>(new DkMetaDataT());
 }
 
-bool DkBasicLoader::loadGeneral(const QFileInfo& fileInfo, bool loadMetaData, bool fast) {
+bool DkBasicLoader::loadGeneral(const QFileInfo& fileInfo, bool loadMetaData, bool fast, const QSize& maxSize) {
 
-	return loadGeneral(fileInfo, QSharedPointer<QByteArray>(), loadMetaData, fast);
+	return loadGeneral(fileInfo, QSharedPointer<QByteArray>(), loadMetaData, fast, maxSize);
 }
 /**
  * This function loads the images.
  * @param file the image file that should be loaded.
+ * @param maxSize if valid, large images are decoded such that they just fit into maxSize.
+ * Qt (e.g. JPG DCT scaling), RAW (half size) and WebP loaders support this, isDownscaled() is true if the image was reduced.
  * @return bool true if the image could be loaded.
  **/ 
-bool DkBasicLoader::loadGeneral(const QFileInfo& fileInfo, QSharedPointer<QByteArray> ba, bool loadMetaData, bool fast) {
+bool DkBasicLoader::loadGeneral(const QFileInfo& fileInfo, QSharedPointer<QByteArray> ba, bool loadMetaData, bool fast, const QSize& maxSize) {
 
 	bool imgLoaded = false;
 	
@@ -157,7 +176,9 @@ bool DkBasicLoader::loadGeneral(const QFileInfo& fileInfo, QSharedPointer<QByteA
 	if (!imgLoaded && qtFormats.contains(suf.toStdString().c_str())) {
 
 		// if image has Indexed8 + alpha channel -> we crash... sorry for that
-		if (!ba || ba->isEmpty())
+		if (maxSize.isValid())
+			imgLoaded = loadQtFile(file, ba, maxSize);
+		else if (!ba || ba->isEmpty())
 			imgLoaded = qImg.load(file.absoluteFilePath());
 		else
 			imgLoaded = qImg.loadFromData(*ba.data());
@@ -174,7 +195,7 @@ bool DkBasicLoader::loadGeneral(const QFileInfo& fileInfo, QSharedPointer<QByteA
 	// WEBP loader
 	if (!imgLoaded) {
 
-		imgLoaded = loadWebPFile(file, ba);
+		imgLoaded = loadWebPFile(file, ba, maxSize);
 		if (imgLoaded) loader = webp_loader;
 	}
 
@@ -183,7 +204,7 @@ bool DkBasicLoader::loadGeneral(const QFileInfo& fileInfo, QSharedPointer<QByteA
 		
 		// TODO: sometimes (e.g. _DSC6289.tif) strange opencv errors are thrown - catch them!
 		// load raw files
-		imgLoaded = loadRawFile(file, ba, fast);
+		imgLoaded = loadRawFile(file, ba, fast, maxSize);
 		if (imgLoaded) loader = raw_loader;
 	}
 
@@ -243,8 +264,12 @@ bool DkBasicLoader::loadGeneral(const QFileInfo& fileInfo, QSharedPointer<QByteA
 			if (!DkSettings::metaData.ignoreExifOrientation) {
 				int orientation = metaData->getOrientation();
 
-				if (!metaData->isTiff() && !DkSettings::metaData.ignoreExifOrientation)
+				if (!metaData->isTiff() && !DkSettings::metaData.ignoreExifOrientation) {
 					rotate(orientation);
+
+					if (fullSize.isValid() && (qAbs(orientation) == 90 || qAbs(orientation) == 270))
+						fullSize.transpose();
+				}
 			}
 		} catch(...) {}	// ignore if we cannot read the metadata
 	}
@@ -257,6 +282,105 @@ bool DkBasicLoader::loadGeneral(const QFileInfo& fileInfo, QSharedPointer<QByteA
 	return imgLoaded;
 }
 
+/**
+ * Loads images with Qt's image reader.
+ * If the image is larger than maxSize, it is decoded at a reduced resolution.
+ * JPGs are then scaled while decoding (DCT scaling) which is
+ * much faster than decoding the full image.
+ * @param fileInfo the image file.
+ * @param ba the file buffer (the file is read if it is empty).
+ * @param maxSize the maximal size of the image.
+ * @return bool true if the image could be loaded.
+ **/ 
+bool DkBasicLoader::loadQtFile(const QFileInfo& fileInfo, QSharedPointer<QByteArray> ba, const QSize& maxSize) {
+
+	QBuffer buffer;
+	QImageReader reader;
+
+	if (!ba || ba->isEmpty())
+		reader.setFileName(fileInfo.absoluteFilePath());
+	else {
+		buffer.setData(*ba.data());
+		buffer.open(QIODevice::ReadOnly);
+		reader.setDevice(&buffer);
+	}
+
+	QSize imgSize = reader.size();
+	QSize sSize = scaledSize(imgSize, maxSize);
+
+	if (sSize.isValid()) {
+		reader.setScaledSize(sSize);
+		qDebug() << "[Qt loader] decoding" << imgSize << "at" << sSize;
+	}
+
+	QImage img = reader.read();
+
+	if (img.isNull())
+		return false;
+
+	qImg = img;
+
+	if (sSize.isValid())
+		fullSize = imgSize;
+
+	return true;
+}
+
+/**
+ * Computes the size of a reduced resolution image.
+ * @param imgSize the full resolution image size.
+ * @param maxSize the maximal size.
+ * @return QSize the size that fits into maxSize or an invalid size if the image should not be reduced.
+ **/ 
+QSize DkBasicLoader::scaledSize(const QSize& imgSize, const QSize& maxSize) {
+
+	if (!maxSize.isValid() || !imgSize.isValid())
+		return QSize();
+
+	if (imgSize.width() <= maxSize.width() && imgSize.height() <= maxSize.height())
+		return QSize();
+
+	return imgSize.scaled(maxSize, Qt::KeepAspectRatio);
+}
+
+/**
+ * Returns true if the file is decoded by the RAW loader.
+ * Like loadGeneral(), we decide by the suffix: TIFF based RAW files (NEF, DNG, ...)
+ * would be identified as TIFF if the content is sniffed.
+ * @param fileInfo the file.
+ * @return bool true if the suffix is not supported by Qt.
+ **/ 
+bool DkBasicLoader::isRawFile(const QFileInfo& fileInfo) {
+
+	QString suf = fileInfo.suffix().toLower();
+
+	return !suf.isEmpty() && !QImageReader::supportedImageFormats().contains(suf.toStdString().c_str());
+}
+
+/**
+ * Reads the sensor size of a RAW image without unpacking it.
+ * @param ba the file loaded into a bytearray.
+ * @return QSize the size of the developed image or an invalid size if nomacs has no LibRaw.
+ **/ 
+QSize DkBasicLoader::rawImageSize(QSharedPointer<QByteArray> ba) {
+
+#ifdef WITH_LIBRAW
+	// see loadRawFile() - libraw fails on tiny buffers
+	if (!ba || ba->size() < 100)
+		return QSize();
+
+	LibRaw iProcessor;
+
+	if (iProcessor.open_buffer((void*) ba->constData(), ba->size()) != LIBRAW_SUCCESS)
+		return QSize();
+
+	return QSize(iProcessor.imgdata.sizes.width, iProcessor.imgdata.sizes.height);
+#else
+	Q_UNUSED(ba);
+	return QSize();
+#endif
+}
+
 /**
  * Loads special RAW files that are generated by the Hamamatsu camera.
  * @param fileName the filename of the file to be loaded.
@@ -327,16 +451,334 @@ bool DkBasicLoader::loadRohFile(const QFileInfo& fileInfo, QSharedPointer<QByteA
  * @param ba the file loaded into a bytearray.
  * @return bool true if the file could be loaded.
  **/ 
-bool DkBasicLoader::loadRawFile(const QFileInfo& fileInfo, QSharedPointer<QByteArray> ba, bool fast) {
+#ifdef WITH_LIBRAW
+// RAW develop kernels --------------------------------------------------------------------
+// the raw develop pipeline (black point & dynamic range normalization, white balance,
+// color correction, clipping and gamma) is fused into a single pass per row
+struct DkRawDevelopParams {
+	LibRaw* processor;			// needed for the bayer pattern (COLOR)
+	const unsigned short* src;	// interleaved 16 bit input
+	size_t srcStep;				// input elements per row
+	int channels;				// input elements per pixel (3 or 4)
+	float black;				// black point
+	float scale;				// maps [black maximum] to [0 65535]
+	float colorMat[3][3];		// color correction matrix with the white balance multipliers folded in
+	const uchar* gammaLut;		// maps clipped 16 bit values to the final 8 bit values
+};
+
+typedef void (*DkRawRowFunc)(const DkRawDevelopParams*, cv::Mat*, int, int);
+
+/**
+ * Normalizes the bayer mosaic (one value per pixel) to 16 bit.
+ * @param p the develop parameters
+ * @param dst a CV_16UC1 image
+ * @param startRow the first row to be processed
+ * @param endRow the row after the last row to be processed
+ **/ 
+static void normalizeBayerRows(const DkRawDevelopParams* p, cv::Mat* dst, int startRow, int endRow) {
+
+	for (int row = startRow; row < endRow; row++) {
+
+		const unsigned short* sPtr = p->src + row*p->srcStep;
+		unsigned short* dPtr = dst->ptr<unsigned short>(row);
+		
+		// the bayer pattern repeats every other column
+		int colorIdx[2] = {p->processor->COLOR(row, 0), p->processor->COLOR(row, 1)};
+
+		for (int col = 0; col < dst->cols; col++, sPtr += p->channels) {
+			
+			float val = (sPtr[colorIdx[col & 1]] - p->black) * p->scale;
+			dPtr[col] = cv::saturate_cast<unsigned short>(val);
+		}
+	}
+}
+
+/**
+ * Develops interleaved 16 bit RGB(G) values to 8 bit RGB.
+ * @param p the develop parameters
+ * @param dst a CV_8UC3 image
+ * @param startRow the first row to be processed
+ * @param endRow the row after the last row to be processed
+ **/ 
+static void developRawRows(const DkRawDevelopParams* p, cv::Mat* dst, int startRow, int endRow) {
+
+	const float (*m)[3] = p->colorMat;
+	const uchar* lut = p->gammaLut;
+
+#ifdef DK_SSE2
+	const __m128 c0 = _mm_setr_ps(m[0][0], m[1][0], m[2][0], 0.0f);
+	const __m128 c1 = _mm_setr_ps(m[0][1], m[1][1], m[2][1], 0.0f);
+	const __m128 c2 = _mm_setr_ps(m[0][2], m[1][2], m[2][2], 0.0f);
+	const __m128 black = _mm_set1_ps(p->black);
+	const __m128 scale = _mm_set1_ps(p->scale);
+	const __m128 minVal = _mm_setzero_ps();
+	const __m128 maxVal = _mm_set1_ps(65535.0f);
+	const __m128i zero = _mm_setzero_si128();
+	
+	// the vector load reads 4 values - do not read beyond the last pixel of RGB rows
+	const int numVec = p->channels == 4 ? dst->cols : dst->cols-1;
+#endif
+
+	for (int row = startRow; row < endRow; row++) {
+
+		const unsigned short* sPtr = p->src + row*p->srcStep;
+		uchar* dPtr = dst->ptr<uchar>(row);
+		int col = 0;
+
+#ifdef DK_SSE2
+		int idx[4];
+
+		for (; col < numVec; col++, sPtr += p->channels, dPtr += 3) {
+
+			__m128 v = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i*)sPtr), zero));
+			v = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(v, black), scale), minVal), maxVal);
+
+			__m128 rgb = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(c0, _mm_shuffle_ps(v, v, _MM_SHUFFLE(0,0,0,0))),
+				_mm_mul_ps(c1, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1,1,1,1)))),
+				_mm_mul_ps(c2, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2,2,2,2))));
+			rgb = _mm_min_ps(_mm_max_ps(rgb, minVal), maxVal);
+
+			_mm_storeu_si128((__m128i*)idx, _mm_cvtps_epi32(rgb));
+			dPtr[0] = lut[idx[0]];
+			dPtr[1] = lut[idx[1]];
+			dPtr[2] = lut[idx[2]];
+		}
+#endif
+
+		for (; col < dst->cols; col++, sPtr += p->channels, dPtr += 3) {
+
+			float v[3];
+			for (int cIdx = 0; cIdx < 3; cIdx++)
+				v[cIdx] = qMin(qMax((sPtr[cIdx] - p->black) * p->scale, 0.0f), 65535.0f);
+
+			for (int cIdx = 0; cIdx < 3; cIdx++) {
+				int val = qRound(m[cIdx][0]*v[0] + m[cIdx][1]*v[1] + m[cIdx][2]*v[2]);
+				dPtr[cIdx] = lut[(val > 65535) ? 65535 : (val < 0) ? 0 : val];
+			}
+		}
+	}
+}
+
+/**
+ * Processes the rows of dst in parallel bands.
+ * The first band is processed by the calling thread.
+ * @param func the row kernel
+ * @param p the develop parameters
+ * @param dst the destination image
+ **/ 
+static void runRawRows(DkRawRowFunc func, const DkRawDevelopParams* p, cv::Mat* dst) {
+
+	int numBands = qMax(1, qMin(QThread::idealThreadCount(), dst->rows/64));
+	QList<QFuture<void> > futures;
+
+	for (int idx = 1; idx < numBands; idx++)
+		futures.append(QtConcurrent::run(func, p, dst, idx*dst->rows/numBands, (idx+1)*dst->rows/numBands));
+
+	func(p, dst, 0, dst->rows/numBands);
+
+	for (int idx = 0; idx < futures.size(); idx++)
+		futures[idx].waitForFinished();
+}
+
+// chroma filter (filterRawImages) --------------------------------------------------------------------
+// filtered RAW images are cached (key: file, modification date, half size, chroma resolution)
+// so that re-displaying a high ISO image does not filter it again
+static QMutex rawFilterCacheMutex;
+static QCache<QString, QImage> rawFilterCache;
+
+static QString rawFilterCacheKey(const QFileInfo& fileInfo, bool halfSize) {
+
+	return fileInfo.absoluteFilePath() + "|" + fileInfo.lastModified().toString(Qt::ISODate) + "|" + 
+		QString::number(fileInfo.size()) + "|" + QString::number(halfSize) + "|" + QString::number(DkSettings::resources.filterRawHalfChroma);
+}
+
+/**
+ * Median filters a band of rows (tile) of a chroma plane.
+ * The neighboring rows are filtered too so that the result is equal to filtering the whole plane.
+ * @param src the chroma plane
+ * @param dst the filtered plane (same size as src)
+ * @param winSize the median filter's window size
+ * @param startRow the first row to be processed
+ * @param endRow the row after the last row to be processed
+ **/ 
+static void medianBlurRows(const cv::Mat* src, cv::Mat* dst, int winSize, int startRow, int endRow) {
+
+	int border = winSize/2;
+	int bStart = qMax(startRow-border, 0);
+	int bEnd = qMin(endRow+border, src->rows);
+
+	cv::Mat band;
+	cv::medianBlur(src->rowRange(bStart, bEnd), band, winSize);
+	band.rowRange(startRow-bStart, endRow-bStart).copyTo(dst->rowRange(startRow, endRow));
+}
+
+// parameters of the edge aware (joint bilateral) chroma upsampling
+struct DkChromaUpParams {
+	const cv::Mat* luma;			// full resolution luminance (guide)
+	const cv::Mat* lumaSmall;		// half resolution luminance
+	const cv::Mat* chromaSmall[2];	// half resolution (filtered) chroma planes
+	cv::Mat* chroma[2];				// full resolution chroma planes
+	const float* rangeWeights;		// weights of luminance differences [0 255]
+};
+
+/**
+ * Upsamples the chroma planes guided by the full resolution luminance.
+ * Each pixel is interpolated from its 4 neighbors in the half resolution planes. The bilinear weights 
+ * are multiplied by the luminance similarity, hence colors do not bleed across edges.
+ * @param p the upsampling parameters
+ * @param startRow the first row to be processed
+ * @param endRow the row after the last row to be processed
+ **/ 
+static void chromaUpsampleRows(const DkChromaUpParams* p, int startRow, int endRow) {
+
+	const int sw = p->lumaSmall->cols;
+	const int sh = p->lumaSmall->rows;
+
+	for (int row = startRow; row < endRow; row++) {
+
+		float fy = (row+0.5f)*0.5f-0.5f;
+		int y0 = qMax(cvFloor(fy), 0);
+		int y1 = qMin(y0+1, sh-1);
+		float wy = qMin(qMax(fy-y0, 0.0f), 1.0f);
+
+		const uchar* lPtr = p->luma->ptr<uchar>(row);
+		const uchar* ls0 = p->lumaSmall->ptr<uchar>(y0);
+		const uchar* ls1 = p->lumaSmall->ptr<uchar>(y1);
+		const uchar* c00 = p->chromaSmall[0]->ptr<uchar>(y0);
+		const uchar* c01 = p->chromaSmall[0]->ptr<uchar>(y1);
+		const uchar* c10 = p->chromaSmall[1]->ptr<uchar>(y0);
+		const uchar* c11 = p->chromaSmall[1]->ptr<uchar>(y1);
+		uchar* d0 = p->chroma[0]->ptr<uchar>(row);
+		uchar* d1 = p->chroma[1]->ptr<uchar>(row);
+
+		for (int col = 0; col < p->luma->cols; col++) {
+
+			float fx = (col+0.5f)*0.5f-0.5f;
+			int x0 = qMax(cvFloor(fx), 0);
+			int x1 = qMin(x0+1, sw-1);
+			float wx = qMin(qMax(fx-x0, 0.0f), 1.0f);
+
+			int l = lPtr[col];
+			float w[4] = {
+				(1.0f-wx)*(1.0f-wy) * p->rangeWeights[qAbs(l-ls0[x0])],
+				wx*(1.0f-wy) * p->rangeWeights[qAbs(l-ls0[x1])],
+				(1.0f-wx)*wy * p->rangeWeights[qAbs(l-ls1[x0])],
+				wx*wy * p->rangeWeights[qAbs(l-ls1[x1])]};
+			float wSum = w[0]+w[1]+w[2]+w[3];
+
+			if (wSum < 1e-6f) {	// no similar neighbor - fall back to bilinear
+				w[0] = (1.0f-wx)*(1.0f-wy); w[1] = wx*(1.0f-wy); w[2] = (1.0f-wx)*wy; w[3] = wx*wy;
+				wSum = 1.0f;
+			}
+
+			d0[col] = cv::saturate_cast<uchar>((w[0]*c00[x0] + w[1]*c00[x1] + w[2]*c01[x0] + w[3]*c01[x1])/wSum);
+			d1[col] = cv::saturate_cast<uchar>((w[0]*c10[x0] + w[1]*c10[x1] + w[2]*c11[x0] + w[3]*c11[x1])/wSum);
+		}
+	}
+}
+
+/**
+ * Filters color noise with a median filter on the chroma planes.
+ * The planes are split into tiles (bands of rows) which are filtered in parallel.
+ * If halfChroma is true, the chroma planes are filtered at half resolution and upsampled edge aware.
+ * @param rgbImg a CV_8UC3 RGB image which is filtered in place
+ * @param winSize the median filter's window size (at full resolution)
+ * @param halfChroma if true, the chroma is filtered at half resolution
+ **/ 
+static void filterRawChroma(cv::Mat& rgbImg, int winSize, bool halfChroma) {
+
+	std::vector<cv::Mat> ycrcb;
+	cvtColor(rgbImg, rgbImg, CV_RGB2YCrCb);
+	split(rgbImg, ycrcb);
+
+	std::vector<cv::Mat> chroma(2);
+	if (halfChroma) {
+		cv::Size sSize((rgbImg.cols+1)/2, (rgbImg.rows+1)/2);
+		cv::resize(ycrcb[1], chroma[0], sSize, 0, 0, CV_INTER_AREA);
+		cv::resize(ycrcb[2], chroma[1], sSize, 0, 0, CV_INTER_AREA);
+		winSize = qMax(winSize/2 | 1, 3);	// the window covers the same area
+	}
+	else {
+		chroma[0] = ycrcb[1];
+		chroma[1] = ycrcb[2];
+	}
+
+	// filter all tiles of both planes in parallel
+	std::vector<cv::Mat> filtered(2);
+	int rows = chroma[0].rows;
+	int numBands = qMax(1, qMin(QThread::idealThreadCount(), rows/(4*winSize)));
+	QList<QFuture<void> > futures;
+
+	for (int cIdx = 0; cIdx < 2; cIdx++) {
+		filtered[cIdx].create(chroma[cIdx].size(), chroma[cIdx].type());
+
+		for (int idx = 0; idx < numBands; idx++)
+			futures.append(QtConcurrent::run(&medianBlurRows, &chroma[cIdx], &filtered[cIdx], winSize, idx*rows/numBands, (idx+1)*rows/numBands));
+	}
+
+	for (int idx = 0; idx < futures.size(); idx++)
+		futures[idx].waitForFinished();
+
+	if (halfChroma) {
+
+		cv::Mat lumaSmall;
+		cv::resize(ycrcb[0], lumaSmall, filtered[0].size(), 0, 0, CV_INTER_AREA);
+
+		float rangeWeights[256];
+		const float sigma = 12.0f;
+		for (int idx = 0; idx < 256; idx++)
+			rangeWeights[idx] = (float)qExp(-(idx*idx)/(2.0f*sigma*sigma));
+
+		DkChromaUpParams p;
+		p.luma = &ycrcb[0];
+		p.lumaSmall = &lumaSmall;
+		p.chromaSmall[0] = &filtered[0];
+		p.chromaSmall[1] = &filtered[1];
+		p.chroma[0] = &ycrcb[1];
+		p.chroma[1] = &ycrcb[2];
+		p.rangeWeights = rangeWeights;
+
+		int fRows = rgbImg.rows;
+		int numUpBands = qMax(1, qMin(QThread::idealThreadCount(), fRows/64));
+		futures.clear();
+
+		for (int idx = 1; idx < numUpBands; idx++)
+			futures.append(QtConcurrent::run(&chromaUpsampleRows, (const DkChromaUpParams*)&p, idx*fRows/numUpBands, (idx+1)*fRows/numUpBands));
+		chromaUpsampleRows(&p, 0, fRows/numUpBands);
+
+		for (int idx = 0; idx < futures.size(); idx++)
+			futures[idx].waitForFinished();
+	}
+	else {
+		ycrcb[1] = filtered[0];
+		ycrcb[2] = filtered[1];
+	}
+
+	merge(ycrcb, rgbImg);
+	cvtColor(rgbImg, rgbImg, CV_YCrCb2RGB);
+}
+#endif
+
+bool DkBasicLoader::loadRawFile(const QFileInfo& fileInfo, QSharedPointer<QByteArray> ba, bool fast, const QSize& maxSize) {
 	
 	bool imgLoaded = false;
 
+	// progressive: the embedded preview is shown first and marked as downscaled
+	// the full RAW is developed later with an invalid maxSize (see DkImageContainerT::loadFullSizeThreaded)
+	bool progressive = !fast && maxSize.isValid() && DkSettings::resources.loadRawThumb == DkSettings::raw_thumb_progressive;
+
 	try {
 
+		bool exivPreview = fast || DkSettings::resources.loadRawThumb == DkSettings::raw_thumb_always ||
+			DkSettings::resources.loadRawThumb == DkSettings::raw_thumb_if_large;
+#ifndef WITH_LIBRAW
+		exivPreview |= progressive;	// we cannot develop the RAW anyway
+#endif
+
 		// try to get preview image from exiv2
 		if (metaData) { 
-			if (fast || DkSettings::resources.loadRawThumb == DkSettings::raw_thumb_always ||
-				DkSettings::resources.loadRawThumb == DkSettings::raw_thumb_if_large) {
+			if (exivPreview) {
 
 				metaData->readMetaData(fileInfo, ba);
 
@@ -357,7 +799,6 @@ bool DkBasicLoader::loadRawFile(const QFileInfo& fileInfo, QSharedPointer<QByteA
 #ifdef WITH_LIBRAW
 
 		LibRaw iProcessor;
-		QImage image;
 
 		int error = LIBRAW_DATA_ERROR;
 
@@ -392,8 +833,10 @@ bool DkBasicLoader::loadRawFile(const QFileInfo& fileInfo, QSharedPointer<QByteA
 		int tM = qMax(iProcessor.imgdata.thumbnail.twidth, iProcessor.imgdata.thumbnail.twidth);
 		// TODO: check actual screen resolution
 		qDebug() << "max thumb size: " << tM;
+
+		QSize rawSize(iProcessor.imgdata.sizes.width, iProcessor.imgdata.sizes.height);
 				
-		if (fast || DkSettings::resources.loadRawThumb == DkSettings::raw_thumb_always ||
+		if (fast || progressive || DkSettings::resources.loadRawThumb == DkSettings::raw_thumb_always ||
 			(DkSettings::resources.loadRawThumb == DkSettings::raw_thumb_if_large && tM >= 1920)) {
 			
 			// crashes here if image is broken
@@ -410,6 +853,9 @@ bool DkBasicLoader::loadRawFile(const QFileInfo& fileInfo, QSharedPointer<QByteA
 					qImg = tmp;
 					qDebug() << "[RAW] I loaded the RAW's thumbnail";
 
+					if (progressive && (qint64)tmp.width()*tmp.height() < (qint64)rawSize.width()*rawSize.height())
+						fullSize = rawSize;
+
 					return imgLoaded;
 				}
 				else
@@ -419,8 +865,35 @@ bool DkBasicLoader::loadRawFile(const QFileInfo& fileInfo, QSharedPointer<QByteA
 				qDebug() << "error unpacking the thumb...";
 		}
 
-		qDebug() << "[RAW] loading full raw file";
+		// the half size image (each 2x2 bayer block is one pixel) is large enough for the screen
+		QSize sSize = DkBasicLoader::scaledSize(rawSize, maxSize);
+		bool halfSize = sSize.isValid() && 
+			sSize.width() <= rawSize.width()/2 && sSize.height() <= rawSize.height()/2;
 
+		if (halfSize) {
+			iProcessor.imgdata.params.half_size = 1;
+			qDebug() << "[RAW] loading half size raw file";
+		}
+		else
+			qDebug() << "[RAW] loading full raw file";
+
+		// filtered images are cached - the filter is the most expensive part of high ISO images
+		QString filterKey;
+		if (DkSettings::resources.filterRawImages && iProcessor.imgdata.other.iso_speed > 0 && fileInfo.exists()) {
+			
+			filterKey = rawFilterCacheKey(fileInfo, halfSize);
+
+			QMutexLocker locker(&rawFilterCacheMutex);
+			QImage* cachedImg = rawFilterCache.object(filterKey);
+
+			if (cachedImg) {
+				qImg = *cachedImg;
+				if (halfSize)
+					fullSize = rawSize;
+				qDebug() << "[RAW] filtered image loaded from cache";
+				return true;
+			}
+		}
 
 		//unpack the data
 		error = iProcessor.unpack();
@@ -433,8 +906,9 @@ bool DkBasicLoader::loadRawFile(const QFileInfo& fileInfo, QSharedPointer<QByteA
 		//iProcessor.dcraw_process();
 		//iProcessor.dcraw_ppm_tiff_writer("test.tiff");
 
-		unsigned short cols = iProcessor.imgdata.sizes.width,//.raw_width,
-			rows = iProcessor.imgdata.sizes.height;//.raw_height;
+		// raw2image already merged the bayer blocks if we load half size images
+		unsigned short cols = halfSize ? iProcessor.imgdata.sizes.iwidth : iProcessor.imgdata.sizes.width,//.raw_width,
+			rows = halfSize ? iProcessor.imgdata.sizes.iheight : iProcessor.imgdata.sizes.height;//.raw_height;
 
 		cv::Mat rawMat, rgbImg;
 
@@ -475,90 +949,19 @@ bool DkBasicLoader::loadRawFile(const QFileInfo& fileInfo, QSharedPointer<QByteA
 
 		if (strcmp(iProcessor.imgdata.idata.cdesc, "RGBG")) throw DkException("Wrong Bayer Pattern (not RGBG)\n", __LINE__, __FILE__);
 
-		// 1. read raw image and normalize it according to dynamic range and black point
-		
+		// 1. normalize according to dynamic range and black point
 		//dynamic range is defined by maximum - black
 		float dynamicRange = (float)(iProcessor.imgdata.color.maximum-iProcessor.imgdata.color.black);	// iProcessor.imgdata.color.channel_maximum[0]-iProcessor.imgdata.color.black;	// dynamic range
 
-		if (iProcessor.imgdata.idata.filters) {
-
-			rawMat = cv::Mat(rows, cols, CV_32FC1);
-
-			for (uint row = 0; row < rows; row++) {
-				float *ptrRaw = rawMat.ptr<float>(row);
-
-				for (uint col = 0; col < cols; col++) {
-
-					int colorIdx = iProcessor.COLOR(row, col);
-					ptrRaw[col] = (float)(iProcessor.imgdata.image[cols*(row) + col][colorIdx]);
-
-					//correct the image values according the black point defined by the camera
-					ptrRaw[col] -= iProcessor.imgdata.color.black;
-					//normalize according the dynamic range
-					ptrRaw[col] /= dynamicRange;
-					ptrRaw[col] *= 65535;  // for conversion to 16U
-				}
-			}
-			
-			// 2. demosaic raw image
-			rawMat.convertTo(rawMat, CV_16U);
-
-			//cvtColor(rawMat, rgbImg, CV_BayerBG2RGB);
-			unsigned long type = (unsigned long)iProcessor.imgdata.idata.filters;
-			type = type & 255;
-
-			//define bayer pattern
-			if (type == 180) cvtColor(rawMat, rgbImg, CV_BayerBG2RGB);      //bitmask  10 11 01 00  -> 3(G) 2(B) 1(G) 0(R) -> RG RG RG
-			//												                                                                  GB GB GB
-			else if (type == 30) cvtColor(rawMat, rgbImg, CV_BayerRG2RGB);		//bitmask  00 01 11 10	-> 0 1 3 2
-			else if (type == 225) cvtColor(rawMat, rgbImg, CV_BayerGB2RGB);		//bitmask  11 10 00 01
-			else if (type == 75) cvtColor(rawMat, rgbImg, CV_BayerGR2RGB);		//bitmask  01 00 10 11
-			else throw DkException("Wrong Bayer Pattern (not BG, RG, GB, GR)\n", __LINE__, __FILE__);
-		}
-		else {
-
-			rawMat = cv::Mat(rows, cols, CV_32FC3);
-			rawMat.setTo(0);
-			std::vector<cv::Mat> rawCh;
-			split(rawMat, rawCh);
-
-			for (unsigned int row = 0; row < rows; row++) {
-				float *ptrR = rawCh[0].ptr<float>(row);
-				float *ptrG = rawCh[1].ptr<float>(row);
-				float *ptrB = rawCh[2].ptr<float>(row);
-				//float *ptrE = rawCh[3].ptr<float>(row);
-
-				for (unsigned int col = 0; col < cols; col++) {
-
-					ptrR[col] = (float)(iProcessor.imgdata.image[cols*(row) + col][0]);
-					ptrR[col] -= iProcessor.imgdata.color.black;
-					ptrR[col] /= dynamicRange;
-					ptrR[col] *= 65535;  // for conversion to 16U
-
-					ptrG[col] = (float)(iProcessor.imgdata.image[cols*(row) + col][1]);
-					ptrG[col] -= iProcessor.imgdata.color.black;
-					ptrG[col] /= dynamicRange;
-					ptrG[col] *= 65535;  // for conversion to 16U
-
-					ptrB[col] = (float)(iProcessor.imgdata.image[cols*(row) + col][2]);
-					ptrB[col] -= iProcessor.imgdata.color.black;
-					ptrB[col] /= dynamicRange;
-					ptrB[col] *= 65535;  // for conversion to 16U
-
-				}
-			}
-			merge(rawCh, rgbImg);
-			rgbImg.convertTo(rgbImg, CV_16U);
-		}
-
-		rawMat.release();
-
-		// 3.. 4., 5.: apply white balance, color correction and gamma 
-
-		// get color correction matrix
-		float colorCorrMat[3][4] = {};
-		for(int i=0;i<3;i++) for(int j=0;j<4;j++) colorCorrMat[i][j] = iProcessor.imgdata.color.rgb_cam[i][j];
+		DkRawDevelopParams params;
+		params.processor = &iProcessor;
+		params.src = &iProcessor.imgdata.image[0][0];
+		params.srcStep = (size_t)cols*4;
+		params.channels = 4;
+		params.black = (float)iProcessor.imgdata.color.black;
+		params.scale = 65535.0f/dynamicRange;	// for conversion to 16U
 
+		// 3. white balance
 		// get camera white balance multipliers
 		float mulWhite[4];
 		mulWhite[0] = iProcessor.imgdata.color.cam_mul[0];
@@ -566,13 +969,6 @@ bool DkBasicLoader::loadRawFile(const QFileInfo& fileInfo, QSharedPointer<QByteA
 		mulWhite[2] = iProcessor.imgdata.color.cam_mul[2];
 		mulWhite[3] = iProcessor.imgdata.color.cam_mul[3];
 
-		//read gamma value and create gamma table
-		float gamma = (float)iProcessor.imgdata.params.gamm[0];///(float)iProcessor.imgdata.params.gamm[1];
-		float gammaTable[65536];
-		for (int i = 0; i < 65536; i++) {
-			gammaTable[i] = (float)(1.099f*pow((float)i/65535.0f, gamma)-0.099f);
-		}
-
 		// normalize white balance multipliers
 		float w = (mulWhite[0] + mulWhite[1] + mulWhite[2] + mulWhite[3])/4.0f;
 		float maxW = 1.0f;//mulWhite[0];
@@ -595,50 +991,61 @@ bool DkBasicLoader::loadRawFile(const QFileInfo& fileInfo, QSharedPointer<QByteA
 		if (mulWhite[3] == 0)
 			mulWhite[3] = mulWhite[1];
 
-		//apply corrections
-		std::vector<cv::Mat> corrCh;
-		split(rgbImg, corrCh);
-
-		for (uint row = 0; row < rows; row++)
-		{
-			unsigned short *ptrR = corrCh[0].ptr<unsigned short>(row);
-			unsigned short *ptrG = corrCh[1].ptr<unsigned short>(row);
-			unsigned short *ptrB = corrCh[2].ptr<unsigned short>(row);
-
-			for (uint col = 0; col < cols; col++)
-			{
-				//apply white balance correction
-				int tempR = qRound(ptrR[col] * mulWhite[0]);
-				int tempG = qRound(ptrG[col] * mulWhite[1]);
-				int tempB = qRound(ptrB[col] * mulWhite[2]);
-
-				//apply color correction					
-				int corrR = qRound(colorCorrMat[0][0] * tempR + colorCorrMat[0][1] * tempG  + colorCorrMat[0][2] * tempB);
-				int corrG = qRound(colorCorrMat[1][0] * tempR + colorCorrMat[1][1] * tempG  + colorCorrMat[1][2] * tempB);
-				int corrB = qRound(colorCorrMat[2][0] * tempR + colorCorrMat[2][1] * tempG  + colorCorrMat[2][2] * tempB);
-				// without color correction: change above three lines to the bottom ones
-				//int corrR = tempR;
-				//int corrG = tempG;
-				//int corrB = tempB;
-
-				//clipping
-				ptrR[col] = (corrR > 65535) ? 65535 : (corrR < 0) ? 0 : (unsigned short)corrR;
-				ptrG[col] = (corrG > 65535) ? 65535 : (corrG < 0) ? 0 : (unsigned short)corrG;
-				ptrB[col] = (corrB > 65535) ? 65535 : (corrB < 0) ? 0 : (unsigned short)corrB;
-
-				//apply gamma correction
-				ptrR[col] = ptrR[col] <= 0.018f * 65535.0f ? (unsigned short)(ptrR[col]*(float)iProcessor.imgdata.params.gamm[1]/257.0f) :
-					(unsigned short)(gammaTable[ptrR[col]] * 255);
-				//									(1.099f*(float)(pow((float)ptrRaw[col], gamma))-0.099f);
-				ptrG[col] = ptrG[col] <= 0.018f * 65535.0f ? (unsigned short)(ptrG[col]*(float)iProcessor.imgdata.params.gamm[1]/257.0f) :
-					(unsigned short)(gammaTable[ptrG[col]] * 255);
-				ptrB[col] = ptrB[col] <= 0.018f * 65535.0f ? (unsigned short)(ptrB[col]*(float)iProcessor.imgdata.params.gamm[1]/257.0f) :
-					(unsigned short)(gammaTable[ptrB[col]] * 255);
-			}
+		// 4. color correction - the white balance multipliers are folded into the color correction matrix
+		for (int i = 0; i < 3; i++) 
+			for (int j = 0; j < 3; j++) 
+				params.colorMat[i][j] = iProcessor.imgdata.color.rgb_cam[i][j] * mulWhite[j];
+
+		// 5. gamma correction - the table maps clipped 16 bit values to the final 8 bit values
+		float gamma = (float)iProcessor.imgdata.params.gamm[0];///(float)iProcessor.imgdata.params.gamm[1];
+		float linearSlope = (float)iProcessor.imgdata.params.gamm[1]/257.0f;
+		QVector<uchar> gammaLut(65536);
+		for (int i = 0; i < 65536; i++) {
+			float val = i <= 0.018f * 65535.0f ? 
+				(float)(unsigned short)(i*linearSlope) :
+				(float)(unsigned short)((1.099f*pow((float)i/65535.0f, gamma)-0.099f) * 255);
+			gammaLut[i] = cv::saturate_cast<uchar>(val);
 		}
+		params.gammaLut = gammaLut.constData();
+
+		DkTimer dt;
+		rgbImg = cv::Mat(rows, cols, CV_8UC3);
+
+		if (iProcessor.imgdata.idata.filters && !halfSize) {
 
-		merge(corrCh, rgbImg);
-		rgbImg.convertTo(rgbImg, CV_8U);
+			//define bayer pattern
+			unsigned long type = (unsigned long)iProcessor.imgdata.idata.filters;
+			type = type & 255;
+			int bayerCode;
+
+			if (type == 180) bayerCode = CV_BayerBG2RGB;		//bitmask  10 11 01 00  -> 3(G) 2(B) 1(G) 0(R) -> RG RG RG
+			//												                                                            GB GB GB
+			else if (type == 30) bayerCode = CV_BayerRG2RGB;	//bitmask  00 01 11 10	-> 0 1 3 2
+			else if (type == 225) bayerCode = CV_BayerGB2RGB;	//bitmask  11 10 00 01
+			else if (type == 75) bayerCode = CV_BayerGR2RGB;	//bitmask  01 00 10 11
+			else throw DkException("Wrong Bayer Pattern (not BG, RG, GB, GR)\n", __LINE__, __FILE__);
+
+			rawMat = cv::Mat(rows, cols, CV_16UC1);
+			runRawRows(&normalizeBayerRows, &params, &rawMat);
+
+			// 2. demosaic raw image
+			cv::Mat demosaiced;
+			cvtColor(rawMat, demosaiced, bayerCode);
+			rawMat.release();
+
+			// the demosaiced image is already normalized
+			params.src = demosaiced.ptr<unsigned short>();
+			params.srcStep = demosaiced.step1();
+			params.channels = 3;
+			params.black = 0.0f;
+			params.scale = 1.0f;
+			runRawRows(&developRawRows, &params, &rgbImg);
+		}
+		else
+			runRawRows(&developRawRows, &params, &rgbImg);
+
+		double mp = (double)rows*cols/1e6;
+		qDebug() << "[RAW] developed" << mp << "MP in" << dt.getTotal() << "(" << dt.getTotalTime()*1000/qMax(mp, 1e-6) << "ms/MP)";
 			
 		// filter color noise withe a median filter
 		if (DkSettings::resources.filterRawImages) {
@@ -654,16 +1061,8 @@ bool DkBasicLoader::loadRawFile(const QFileInfo& fileInfo, QSharedPointer<QByteA
 				else if (isoSpeed >= 400) winSize = 7;
 				else winSize = 5;
 
-				DkTimer dMed;			
-
-				cvtColor(rgbImg, rgbImg, CV_RGB2YCrCb);
-				split(rgbImg, corrCh);
-
-				cv::medianBlur(corrCh[1], corrCh[1], winSize);
-				cv::medianBlur(corrCh[2], corrCh[2], winSize);
-
-				merge(corrCh, rgbImg);
-				cvtColor(rgbImg, rgbImg, CV_YCrCb2RGB);
+				DkTimer dMed;
+				filterRawChroma(rgbImg, winSize, DkSettings::resources.filterRawHalfChroma);
 
 				qDebug() << "median blurred in: " << dMed.getTotal() << ", winSize: " << winSize;
 			}
@@ -686,8 +1085,18 @@ bool DkBasicLoader::loadRawFile(const QFileInfo& fileInfo, QSharedPointer<QByteA
 			rgbImg = rawMat;
 		}
 
-		//create the final image
-		image = QImage(rgbImg.data, (int)rgbImg.cols, (int)rgbImg.rows, (int)rgbImg.step/*rgbImg.cols*3*/, QImage::Format_RGB888);
+		//create the final image (adopts the buffer of rgbImg)
+		qImg = DkImage::mat2QImageView(rgbImg);
+
+		if (!filterKey.isEmpty()) {
+			
+			// the cache may use a quarter of the image cache's memory (cost is in KB)
+			int maxCacheMB = DkSettings::resources.cacheMemory > 0 ? qRound(DkSettings::resources.cacheMemory*0.25f) : 256;
+
+			QMutexLocker locker(&rawFilterCacheMutex);
+			rawFilterCache.setMaxCost(maxCacheMB*1024);
+			rawFilterCache.insert(filterKey, new QImage(qImg), qImg.bytesPerLine()*qImg.height()/1024);
+		}
 
 		//orientation is done in loadGeneral with libExiv
 		//orientation = iProcessor.imgdata.sizes.flip;
@@ -698,7 +1107,6 @@ bool DkBasicLoader::loadRawFile(const QFileInfo& fileInfo, QSharedPointer<QByteA
 		//case 6: orientation = 90; break;
 		//}
 
-		qImg = image.copy();
 		//if (orientation!=0) {
 		//	QTransform rotationMatrix;
 		//	rotationMatrix.rotate((double)orientation);
@@ -706,6 +1114,9 @@ bool DkBasicLoader::loadRawFile(const QFileInfo& fileInfo, QSharedPointer<QByteA
 		//}
 		imgLoaded = true;
 
+		if (halfSize)
+			fullSize = rawSize;
+
 		iProcessor.recycle();
 
 #else
@@ -984,15 +1395,24 @@ QSharedPointer<QByteArray> DkBasicLoader::loadFileToBuffer(const QFileInfo& file
 	return ba;
 }
 
-bool DkBasicLoader::writeBufferToFile(const QFileInfo& fileInfo, const QSharedPointer<QByteArray> ba) const {
+bool DkBasicLoader::writeBufferToFile(const QFileInfo& fileInfo, const QSharedPointer<QByteArray> ba) {
 
 	if (!ba || ba->isEmpty())
 		return false;
 
+#if QT_VERSION >= 0x050100
+	// replace the file atomically - a failed write does not destroy the old file
+	QSaveFile file(fileInfo.absoluteFilePath());
+	file.open(QIODevice::WriteOnly);
+	qint64 bytesWritten = file.write(*ba.data(), ba->size());
+	if (!file.commit())
+		bytesWritten = -1;
+#else
 	QFile file(fileInfo.absoluteFilePath());
 	file.open(QIODevice::WriteOnly);
 	qint64 bytesWritten = file.write(*ba.data(), ba->size());
 	file.close();
+#endif
 	qDebug() << "[DkBasicLoader] buffer saved, bytes written: " << bytesWritten;
 
 	if (!bytesWritten || bytesWritten == -1)
@@ -1009,6 +1429,8 @@ void DkBasicLoader::indexPages(const QFileInfo& fileInfo) {
 
 #ifdef WITH_LIBTIFF
 
+	closeTiff();
+
 	// for now we just support tiff's
 	if (!fileInfo.suffix().contains(QRegExp("(tif|tiff)", Qt::CaseInsensitive)))
 		return;
@@ -1019,31 +1441,60 @@ void DkBasicLoader::indexPages(const QFileInfo& fileInfo) {
 	oldErrorHandler = TIFFSetErrorHandler(NULL); 
 
 	DkTimer dt;
-	TIFF* tiff = TIFFOpen(this->file.absoluteFilePath().toLatin1(), "r");
+	QMutexLocker locker(&tiffMutex);
+	tiffHandle = TIFFOpen(this->file.absoluteFilePath().toLatin1(), "r");
 
-	if (!tiff) 
-		return;
+	if (tiffHandle) {
 
-	// libtiff example
-	int dircount = 0;
+		// remember where each directory starts - so that we can jump to any page later on
+		do {
+			tiffDirOffsets.append((quint64)TIFFCurrentDirOffset(tiffHandle));
+		} while (TIFFReadDirectory(tiffHandle));
 
-	do {
-		dircount++;
+		numPages = tiffDirOffsets.size();
+		qDebug() << numPages << " TIFF directories... " << dt.getTotal();
 
-	} while (TIFFReadDirectory(tiff));
+		// the first page is loaded with Qt - so we just keep the handle for multi-page documents
+		if (numPages <= 1) {
+			TIFFClose(tiffHandle);
+			tiffHandle = 0;
+			tiffDirOffsets.clear();
+		}
+	}
 
-	numPages = dircount;
+	TIFFSetWarningHandler(oldWarningHandler);
+	TIFFSetErrorHandler(oldErrorHandler);
+#endif
 
-	if (numPages > 1)
-		pageIdx = 1;
+}
 
-	qDebug() << dircount << " TIFF directories... " << dt.getTotal();
-	TIFFClose(tiff);
+/**
+ * Closes the TIFF handle (if any) and drops all prefetched pages.
+ **/ 
+void DkBasicLoader::closeTiff() {
 
-	TIFFSetWarningHandler(oldWarningHandler);
-	TIFFSetWarningHandler(oldErrorHandler);
-#endif
+#ifdef WITH_LIBTIFF
+	
+	prefetchMutex.lock();
+	QList<QFuture<void> > futures = prefetchFutures;
+	prefetchFutures.clear();
+	prefetchMutex.unlock();
 
+	// the workers lock the tiffMutex to store their pages
+	for (int idx = 0; idx < futures.size(); idx++)
+		futures[idx].waitForFinished();
+
+	QMutexLocker locker(&tiffMutex);
+
+	if (tiffHandle)
+		TIFFClose(tiffHandle);
+	
+	tiffHandle = 0;
+	tiffDirOffsets.clear();
+
+	QMutexLocker pagesLocker(&pagesMutex);
+	prefetchedPages.clear();
+#endif
 }
 
 bool DkBasicLoader::loadPage(int skipIdx) {
@@ -1069,47 +1520,214 @@ bool DkBasicLoader::loadPageAt(int pageIdx) {
 	if (pageIdx > numPages || pageIdx < 1)
 		return imgLoaded;
 
+	// the handle is gone if the loader was released in the meantime
+	if (!tiffHandle) {
+		int cPageIdx = this->pageIdx;
+		indexPages(file);
+		this->pageIdx = cPageIdx;
+	}
+
+	DkTimer dt;
+	
+	{
+		QMutexLocker pagesLocker(&pagesMutex);
+
+		if (prefetchedPages.contains(pageIdx)) {
+			qImg = prefetchedPages.value(pageIdx);
+			imgLoaded = true;
+		}
+	}
+
+	if (!imgLoaded) {
+		QMutexLocker locker(&tiffMutex);
+		imgLoaded = readTiffPage(pageIdx, qImg);
+	}
+
+	qDebug() << "TIFF page" << pageIdx << "loaded in" << dt.getTotal();
+
+	if (imgLoaded)
+		prefetchPages(pageIdx);
+#endif
+
+	return imgLoaded;
+}
+
+/**
+ * Decodes a TIFF page - the caller has to lock the tiffMutex.
+ * @param pageIdx the page index (starting with 1)
+ * @param img the decoded page
+ * @return bool true if the page could be decoded
+ **/ 
+bool DkBasicLoader::readTiffPage(int pageIdx, QImage& img) {
+
+	if (!tiffHandle || pageIdx < 1 || pageIdx > tiffDirOffsets.size())
+		return false;
+
+	return readTiffDirectory(tiffHandle, tiffDirOffsets[pageIdx-1], img);
+}
+
+/**
+ * Decodes a TIFF directory.
+ * The handle must not be used by another thread meanwhile.
+ * @param handle the TIFF handle
+ * @param dirOffset the offset of the directory (see tiffDirOffsets)
+ * @param img the decoded page
+ * @return bool true if the page could be decoded
+ **/ 
+bool DkBasicLoader::readTiffDirectory(struct tiff* handle, quint64 dirOffset, QImage& img) {
+
+	bool imgLoaded = false;
+
+#ifdef WITH_LIBTIFF
+
+	if (!handle)
+		return imgLoaded;
+
 	// first turn off nasty warning/error dialogs - (we do the GUI : )
 	TIFFErrorHandler oldErrorHandler, oldWarningHandler;
 	oldWarningHandler = TIFFSetWarningHandler(NULL);
 	oldErrorHandler = TIFFSetErrorHandler(NULL); 
 
-	DkTimer dt;
-	TIFF* tiff = TIFFOpen(this->file.absoluteFilePath().toLatin1(), "r");
+	// go to current directory - without walking through all previous directories
+	if (TIFFSetSubDirectory(handle, (toff_t)dirOffset)) {
 
-	if (!tiff)
-		return imgLoaded;
+		uint32 width = 0;
+		uint32 height = 0;
+		TIFFGetField(handle, TIFFTAG_IMAGEWIDTH, &width);
+		TIFFGetField(handle, TIFFTAG_IMAGELENGTH, &height);
 
-	uint32 width = 0;
-	uint32 height = 0;
-	TIFFGetField(tiff, TIFFTAG_IMAGEWIDTH, &width);
-	TIFFGetField(tiff, TIFFTAG_IMAGELENGTH, &height);
+		// init the qImage
+		img = QImage(width, height, QImage::Format_ARGB32);
 
-	// go to current directory
-	for (int idx = 1; idx < pageIdx; idx++) {
+		const int stopOnError = 1;
+		imgLoaded = !img.isNull() && TIFFReadRGBAImageOriented(handle, width, height, reinterpret_cast<uint32 *>(img.bits()), ORIENTATION_TOPLEFT, stopOnError) != 0;
 
-		if (!TIFFReadDirectory(tiff))
-			return false;
+		if (imgLoaded) {
+			for (uint32 y=0; y<height; ++y)
+				convert32BitOrder(img.scanLine(y), width);
+		}
+		else
+			img = QImage();
+	}
+
+	TIFFSetWarningHandler(oldWarningHandler);
+	TIFFSetErrorHandler(oldErrorHandler);
+#endif
+
+	return imgLoaded;
+}
+
+/**
+ * Decodes the previous & next page in the background.
+ * Pages are not prefetched if prefetching is turned off (see setPrefetchPages) or
+ * if they would exceed the cache memory.
+ * @param pageIdx the page that is currently displayed
+ **/ 
+void DkBasicLoader::prefetchPages(int pageIdx) {
+
+	QMutexLocker futureLocker(&prefetchMutex);
+
+	for (int idx = prefetchFutures.size()-1; idx >= 0; idx--) {
+		if (prefetchFutures[idx].isFinished())
+			prefetchFutures.removeAt(idx);
+	}
+
+	QMutexLocker locker(&tiffMutex);
+	QMutexLocker pagesLocker(&pagesMutex);
+
+	// we just keep the neighbors of the current page
+	QMutableMapIterator<int, QImage> pIter(prefetchedPages);
+	while (pIter.hasNext()) {
+		pIter.next();
+		if (!prefetchEnabled || qAbs(pIter.key()-pageIdx) > 1)
+			pIter.remove();
+	}
+
+	// the user is paging faster than we can decode
+	if (!prefetchEnabled || prefetchFutures.size() > 2)
+		return;
+
+	// each page needs about as much memory as the current page
+	float pageMemory = DkImage::getBufferSizeFloat(qImg.size(), 32);
+	float prefetchMemory = 0;
+	QMapIterator<int, QImage> mIter(prefetchedPages);
+	while (mIter.hasNext()) {
+		mIter.next();
+		prefetchMemory += DkImage::getBufferSizeFloat(mIter.value().size(), mIter.value().depth());
 	}
 
-	// init the qImage
-	qImg = QImage(width, height, QImage::Format_ARGB32);
+	for (int idx = pageIdx-1; idx <= pageIdx+1; idx += 2) {
 
-	const int stopOnError = 1;
-	imgLoaded = TIFFReadRGBAImageOriented(tiff, width, height, reinterpret_cast<uint32 *>(qImg.bits()), ORIENTATION_TOPLEFT, stopOnError) != 0;
+		if (idx < 1 || idx > numPages || idx > tiffDirOffsets.size() || prefetchedPages.contains(idx))
+			continue;
+
+		if (prefetchMemory + pageMemory > DkSettings::resources.cacheMemory*0.5f)
+			break;
 
-	if (imgLoaded) {
-		for (uint32 y=0; y<height; ++y)
-			convert32BitOrder(qImg.scanLine(y), width);
+		prefetchMemory += pageMemory;
+		prefetchFutures.append(QtConcurrent::run(this, &DkBasicLoader::prefetchPage, 
+			file.absoluteFilePath(), idx, tiffDirOffsets[idx-1]));
 	}
+}
 
-	TIFFClose(tiff);
+/**
+ * Decodes a page in the background.
+ * The page is decoded with its own TIFF handle so that the 
+ * foreground (loadPageAt) does not wait for speculative reads.
+ * @param filePath the TIFF file
+ * @param pageIdx the page index (starting with 1)
+ * @param dirOffset the offset of the page's directory
+ **/ 
+void DkBasicLoader::prefetchPage(QString filePath, int pageIdx, quint64 dirOffset) {
+
+#ifdef WITH_LIBTIFF
+	{
+		QMutexLocker pagesLocker(&pagesMutex);
+		if (prefetchedPages.contains(pageIdx))
+			return;
+	}
 
+	// first turn off nasty warning/error dialogs - (we do the GUI : )
+	TIFFErrorHandler oldErrorHandler, oldWarningHandler;
+	oldWarningHandler = TIFFSetWarningHandler(NULL);
+	oldErrorHandler = TIFFSetErrorHandler(NULL); 
+	struct tiff* handle = TIFFOpen(filePath.toLatin1(), "r");
 	TIFFSetWarningHandler(oldWarningHandler);
-	TIFFSetWarningHandler(oldErrorHandler);
+	TIFFSetErrorHandler(oldErrorHandler);
+
+	if (!handle)
+		return;
+
+	QImage img;
+	bool loaded = readTiffDirectory(handle, dirOffset, img);
+	TIFFClose(handle);
+
+	QMutexLocker locker(&tiffMutex);
+	QMutexLocker pagesLocker(&pagesMutex);
+
+	// the document was closed meanwhile (closeTiff waits for us before the next document is opened)
+	if (loaded && tiffHandle && !prefetchedPages.contains(pageIdx))
+		prefetchedPages.insert(pageIdx, img);
 #endif
+}
 
-	return imgLoaded;
+/**
+ * Returns the memory of the prefetched pages.
+ * This does not wait for pages that are being decoded (see pagesMutex).
+ * @return float the memory in MB.
+ **/ 
+float DkBasicLoader::getPrefetchMemory() {
+
+	QMutexLocker locker(&pagesMutex);
+
+	float memSize = 0;
+	QMapIterator<int, QImage> pIter(prefetchedPages);
+	while (pIter.hasNext()) {
+		pIter.next();
+		memSize += DkImage::getBufferSizeFloat(pIter.value().size(), pIter.value().depth());
+	}
+
+	return memSize;
 }
 
 bool DkBasicLoader::setPageIdx(int skipIdx) {
@@ -1351,7 +1969,12 @@ void DkBasicLoader::release(bool clear) {
 	saveMetaData(file);
 
 	qImg = QImage();
+	fullSize = QSize();
 	//metaData.clear();
+
+	// keep the TIFF open if we are paging through it
+	if (clear || !pageIdxDirty)
+		closeTiff();
 	
 	// TODO: where should we clear the metadata?
 	if (clear || !metaData->isDirty())
@@ -1365,7 +1988,7 @@ void DkBasicLoader::release(bool clear) {
 
 #ifdef WITH_WEBP
 
-bool DkBasicLoader::loadWebPFile(const QFileInfo& fileInfo, QSharedPointer<QByteArray> ba) {
+bool DkBasicLoader::loadWebPFile(const QFileInfo& fileInfo, QSharedPointer<QByteArray> ba, const QSize& maxSize) {
 
 	if (!ba || ba->isEmpty())
 		ba = loadFileToBuffer(fileInfo);
@@ -1377,6 +2000,35 @@ bool DkBasicLoader::loadWebPFile(const QFileInfo& fileInfo, QSharedPointer<QByte
 	int error = WebPGetFeatures((const uint8_t*)ba->data(), ba->size(), &features);
 	if (error) return false;
 
+	QSize sSize = scaledSize(QSize(features.width, features.height), maxSize);
+
+	// let libwebp scale the image while decoding
+	if (sSize.isValid()) {
+
+		WebPDecoderConfig config;
+		if (!WebPInitDecoderConfig(&config))
+			return false;
+
+		config.options.use_scaling = 1;
+		config.options.scaled_width = sSize.width();
+		config.options.scaled_height = sSize.height();
+		config.output.colorspace = features.has_alpha ? MODE_BGRA : MODE_RGB;
+
+		if (WebPDecode((const uint8_t*) ba->data(), ba->size(), &config) != VP8_STATUS_OK)
+			return false;
+
+		const WebPRGBABuffer& buf = config.output.u.RGBA;
+		qImg = QImage(buf.rgba, config.output.width, config.output.height, buf.stride, 
+			features.has_alpha ? QImage::Format_ARGB32 : QImage::Format_RGB888);
+
+		// clone the image so we own the buffer
+		qImg = qImg.copy();
+		WebPFreeDecBuffer(&config.output);
+		fullSize = QSize(features.width, features.height);
+
+		return true;
+	}
+
 	uint8_t* webData = 0;
 
 	if (features.has_alpha) {
@@ -33,6 +33,9 @@
 #include <QUrl>
 #include <QFileInfo>
 #include <QImage>
+#include <QMutex>
+#include <QMap>
+#include <QFuture>
 #pragma warning(pop)
 
 //#include "DkImageStorage.h"
@@ -68,6 +71,7 @@
 
 // Qt defines
 class QNetworkReply;
+struct tiff;		// libtiff handle
 
 namespace nmc {
 
@@ -134,15 +138,16 @@ public:
 	/**
 	 * Convenience function.
 	 **/ 
-	bool loadGeneral(const QFileInfo& file, bool loadMetaData = false, bool fast = false);
+	bool loadGeneral(const QFileInfo& file, bool loadMetaData = false, bool fast = false, const QSize& maxSize = QSize());
 
 	/**
 	 * Loads the image for the given file
 	 * @param file an image file
 	 * @param skipIdx the number of (internal) pages to be skipped
+	 * @param maxSize if valid, loaders that can decode at a reduced resolution are allowed to return an image that just fits maxSize
 	 * @return bool true if the image was loaded
 	 **/ 
-	bool loadGeneral(const QFileInfo& file, const QSharedPointer<QByteArray> ba, bool loadMetaData = false, bool fast = false);
+	bool loadGeneral(const QFileInfo& file, const QSharedPointer<QByteArray> ba, bool loadMetaData = false, bool fast = false, const QSize& maxSize = QSize());
 
 	/**
 	 * Loads the page requested (with respect to the current page)
@@ -150,8 +155,26 @@ public:
 	 * @return bool true if we could load the page requested
 	 **/ 
 	bool loadPage(int skipIdx = 0);
+
+	/**
+	 * Loads the page requested (absolute index starting with 1).
+	 * The neighboring pages are decoded in the background.
+	 * @param pageIdx the page index
+	 * @return bool true if we could load the page requested
+	 **/ 
 	bool loadPageAt(int pageIdx = 0);
 
+	/**
+	 * Enables decoding the neighboring pages in the background.
+	 * Callers that load the pages sequentially (e.g. exporting all pages) should turn it off.
+	 * @param prefetch if false, no pages are prefetched
+	 **/ 
+	void setPrefetchPages(bool prefetch) {
+		prefetchEnabled = prefetch;
+	};
+
+	float getPrefetchMemory();
+
 	int getNumPages() const {
 		return numPages;
 	};
@@ -181,6 +204,7 @@ public:
 
 		this->file = file;
 		qImg = img;
+		fullSize = QSize();
 	};
 
 	void setTraining(bool training) {
@@ -231,9 +255,29 @@ public:
 		return !qImg.isNull();
 	};
 
+	/**
+	 * Returns true if the image was decoded at a reduced resolution.
+	 * @return bool true if the image is smaller than the image stored in the file.
+	 **/ 
+	bool isDownscaled() const {
+		return fullSize.isValid();
+	};
+
+	/**
+	 * Returns the size of the image stored in the file.
+	 * @return QSize the full resolution image size.
+	 **/ 
+	QSize getFullSize() const {
+		return fullSize.isValid() ? fullSize : qImg.size();
+	};
+
+	static QSize scaledSize(const QSize& imgSize, const QSize& maxSize);
+	static bool isRawFile(const QFileInfo& fileInfo);
+	static QSize rawImageSize(QSharedPointer<QByteArray> ba);
+
 	void loadFileToBuffer(const QFileInfo& fileInfo, QByteArray& ba) const;
 	QSharedPointer<QByteArray> loadFileToBuffer(const QFileInfo& fileInfo) const;
-	bool writeBufferToFile(const QFileInfo& fileInfo, const QSharedPointer<QByteArray> ba) const;
+	static bool writeBufferToFile(const QFileInfo& fileInfo, const QSharedPointer<QByteArray> ba);
 
 	void release(bool clear = false);
 
@@ -254,11 +298,11 @@ public:
 
 	bool loadPSDFile(const QFileInfo& fileInfo, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
 #ifdef WITH_WEBP
-	bool loadWebPFile(const QFileInfo& fileInfo, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
+	bool loadWebPFile(const QFileInfo& fileInfo, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>(), const QSize& maxSize = QSize());
 	bool saveWebPFile(const QFileInfo& fileInfo, const QImage img, int compression);
 	bool saveWebPFile(const QImage img, QSharedPointer<QByteArray>& ba, int compression, int speed = 4);
 #else
-	bool loadWebPFile(const QFileInfo&, QSharedPointer<QByteArray> = QSharedPointer<QByteArray>()) {return false;};	// not supported if webP was not linked
+	bool loadWebPFile(const QFileInfo&, QSharedPointer<QByteArray> = QSharedPointer<QByteArray>(), const QSize& = QSize()) {return false;};	// not supported if webP was not linked
 	bool saveWebPFile(const QFileInfo&, const QImage, int) {return false;};
 	bool saveWebPFile(const QImage, QSharedPointer<QByteArray>&, int, int = 4) {return false;};
 #endif
@@ -271,8 +315,14 @@ public slots:
 
 protected:
 	bool loadRohFile(const QFileInfo& fileInfo, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
-	bool loadRawFile(const QFileInfo& fileInfo, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>(), bool fast = false);
+	bool loadRawFile(const QFileInfo& fileInfo, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>(), bool fast = false, const QSize& maxSize = QSize());
+	bool loadQtFile(const QFileInfo& fileInfo, QSharedPointer<QByteArray> ba, const QSize& maxSize);
 	void indexPages(const QFileInfo& fileInfo);
+	void closeTiff();
+	bool readTiffPage(int pageIdx, QImage& img);
+	static bool readTiffDirectory(struct tiff* handle, quint64 dirOffset, QImage& img);
+	void prefetchPages(int pageIdx);
+	void prefetchPage(QString filePath, int pageIdx, quint64 dirOffset);
 	void convert32BitOrder(void *buffer, int width);
 
 	int loader;
@@ -280,11 +330,22 @@ protected:
 	int mode;
 	QImage qImg;
 	QFileInfo file;
+	QSize fullSize;		// valid if the image was decoded at a reduced resolution
 	int numPages;
 	int pageIdx;
 	bool pageIdxDirty;
 	QSharedPointer<DkMetaDataT> metaData;
 
+	// multi-page TIFFs
+	struct tiff* tiffHandle;			// kept open while a multi-page document is displayed
+	QVector<quint64> tiffDirOffsets;	// directory offset of each page
+	QMutex tiffMutex;					// guards the handle (held while decoding)
+	QMutex pagesMutex;					// guards prefetchedPages (never held while decoding) - lock it after the tiffMutex
+	QMap<int, QImage> prefetchedPages;
+	QMutex prefetchMutex;				// guards prefetchFutures
+	QList<QFuture<void> > prefetchFutures;
+	bool prefetchEnabled;
+
 #ifdef WITH_OPENCV
 	cv::Mat cvImg;
 #endif
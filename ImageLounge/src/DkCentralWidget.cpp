@@ -605,7 +605,7 @@ void DkCentralWidget::showRecentFiles(bool show) {
 	// TODO: fix the missing recent files (e.g. after the thumbnails are loaded once)
 
 	if (show) {
-		recentFilesWidget->setCustomStyle(!viewport->getImage().isNull() || thumbScrollWidget->isVisible());
+		recentFilesWidget->setCustomStyle(viewport->getImageStorage()->hasImage() || thumbScrollWidget->isVisible());
 		recentFilesWidget->raise();
 		recentFilesWidget->show();
 		qDebug() << "recent files size: " << recentFilesWidget->size();
@@ -3103,6 +3103,9 @@ int DkExportTiffDialog::exportImages(QFileInfo file, QFileInfo saveFile, int fro
 
 	processing = true;
 
+	// we load the pages one after another - decoding the neighbors would be wasted
+	loader.setPrefetchPages(false);
+
 	// Do your job
 	for (int idx = from; idx <= to; idx++) {
 
@@ -3808,7 +3811,8 @@ int DkMosaicDialog::computeMosaic(QFileInfo file, QString filter, QString suffix
 	processing = true;
 
 	// compute new image size
-	cv::Mat mImg = DkImage::qImage2Mat(loader.image());
+	QImage srcImg = loader.image();
+	cv::Mat mImg = DkImage::qImage2MatView(srcImg);	// read-only: just sub-matrices are taken and cvtColor writes to mImgLab
 
 	filesUsed.clear();
 	QSize numPatches = QSize(numPatchesH, 0);
@@ -3943,7 +3947,7 @@ int DkMosaicDialog::computeMosaic(QFileInfo file, QString filter, QString suffix
 					cv::Mat imgT3;
 					cv::merge(channels, imgT3);
 					cv::cvtColor(imgT3, imgT3, CV_Lab2BGR);
-					emit updateImage(DkImage::mat2QImage(imgT3));
+					emit updateImage(DkImage::mat2QImageView(imgT3));
 				}
 
 				if (ccPtr[maxIdx.x] == 0) {
@@ -4243,7 +4247,7 @@ bool DkMosaicDialog::postProcessMosaic(float multiply /* = 0.3 */, float screen
 		cv::cvtColor(origR, origR, CV_Lab2BGR);
 		qDebug() << "color converted";
 
-		mosaic = DkImage::mat2QImage(origR);
+		mosaic = DkImage::mat2QImageView(origR);
 		qDebug() << "mosaicing computed...";
 
 	}
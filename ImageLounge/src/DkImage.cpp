@@ -41,7 +41,6 @@
 #pragma warning(push, 0)	// no warnings from includes - begin
 #include <QWidget>
 #include <QImageWriter>
-#include <QFileSystemWatcher>
 #include <QFileInfo>
 #include <QFile>
 #include <QSettings>
@@ -56,6 +55,7 @@
 #include <QStringList>
 #include <QMessageBox>
 #include <QDirIterator>
+#include <QSet>
 #include <QProgressDialog>
 #include <QReadLocker>
 #include <QWriteLocker>
@@ -71,6 +71,8 @@
 #include <qmath.h>
 #include <QtConcurrentRun>
 
+#include <algorithm>
+
 // quazip
 #ifdef WITH_QUAZIP
 #include <quazip/JlCompress.h>
@@ -104,13 +106,28 @@ DkImageLoader::DkImageLoader(QFileInfo file) {
 
 	qRegisterMetaType<QFileInfo>("QFileInfo");
 
-	dirWatcher = new QFileSystemWatcher(this);
-	connect(dirWatcher, SIGNAL(directoryChanged(QString)), this, SLOT(directoryChanged(QString)));
+	// the file watcher reports single files if it's native, otherwise the directory is listed again
+	DkFileWatcher& watcher = DkFileWatcher::instance();
+	connect(&watcher, SIGNAL(directoryChangedSignal(const QString&)), this, SLOT(directoryChanged(const QString&)));
+	connect(&watcher, SIGNAL(fileChangedSignal(const QString&, int)), this, SLOT(fileChanged(const QString&, int)));
+	savingFile = false;
+
+	fileEventTimer.setSingleShot(true);
+	fileEventTimer.setInterval(250);
+	connect(&fileEventTimer, SIGNAL(timeout()), this, SLOT(updateChangedFiles()));
 
 	sortingIsDirty = false;
 	sortingImages = false;
 	folderUpdated = false;
 	tmpFileIdx = 0;
+	dirIndexer = 0;
+	loadPendingFile = false;
+	pendingFileIdx = 0;
+	lastCacheIdx = -1;
+	cacheDirection = 1;
+	numCacheHits = 0;
+	numCacheMisses = 0;
+	numCacheEvictions = 0;
 
 	connect(&createImageWatcher, SIGNAL(finished()), this, SLOT(imagesSorted()));
 
@@ -132,6 +149,11 @@ DkImageLoader::DkImageLoader(QFileInfo file) {
  **/ 
 DkImageLoader::~DkImageLoader() {
 	
+	stopIndexing();
+
+	if (!watchedDir.isEmpty())
+		DkFileWatcher::instance().unwatchDir(watchedDir);
+
 	if (createImageWatcher.isRunning())
 		createImageWatcher.blockSignals(true);
 }
@@ -144,11 +166,16 @@ DkImageLoader::~DkImageLoader() {
  **/ 
 void DkImageLoader::clearPath() {
 
+	stopIndexing();
+
 	// lastFileLoaded must exist
 	if (currentImage && currentImage->exists()) {
 		currentImage->receiveUpdates(this, false);
 		lastImageLoaded = currentImage;
 		images.clear();
+		indexImages();
+		recentImages.clear();
+		lastCacheIdx = -1;
 	}
 
 	currentImage.clear();
@@ -161,6 +188,8 @@ void DkImageLoader::clearPath() {
  **/ 
 bool DkImageLoader::loadZipArchive(QFileInfo zipFile) {
 
+	stopIndexing();
+
 	QStringList fileNameList = JlCompress::getFileList(zipFile.absoluteFilePath());
 	
 	// remove the * in fileFilters
@@ -186,6 +215,7 @@ bool DkImageLoader::loadZipArchive(QFileInfo zipFile) {
 		fileInfoList.append(DkZipContainer::encodeZipFile(zipFile, fileList.at(idx)));
 
 	images.clear();
+	indexImages();
 	createImages(fileInfoList);
 	
 	// zip archives could not contain known image formats
@@ -228,6 +258,10 @@ bool DkImageLoader::loadDir(QDir newDir, bool scanRecursive) {
 	//	return false;
 	//}
 
+	// the folder is currently indexed - it is updated when the indexer is finished
+	if (dirIndexer && newDir.absolutePath() == dir.absolutePath())
+		return true;
+
 	// folder changed signal was emitted
 	if (folderUpdated && newDir.absolutePath() == dir.absolutePath()) {
 		
@@ -238,6 +272,7 @@ bool DkImageLoader::loadDir(QDir newDir, bool scanRecursive) {
  		if (files.empty()) {
 			emit showInfoSignal(tr("%1 \n does not contain any image").arg(dir.absolutePath()), 4000);	// stop showing
 			images.clear();
+			indexImages();
 			emit updateDirSignal(images);
 			return false;
 		}
@@ -257,6 +292,8 @@ bool DkImageLoader::loadDir(QDir newDir, bool scanRecursive) {
 
 		QFileInfoList files;
 
+		stopIndexing();
+
 		// update save directory
 		dir = newDir;
 		dir.setNameFilters(DkSettings::app.fileFilters);
@@ -266,7 +303,16 @@ bool DkImageLoader::loadDir(QDir newDir, bool scanRecursive) {
 		folderKeywords.clear();	// delete key words -> otherwise user may be confused
 		emit folderFiltersChanged(folderKeywords);
 
-		if (scanRecursive && DkSettings::global.scanSubFolders)
+		// index the folder in the background - images are added as soon as they are found
+		// sub folders are still indexed synchronously since getSkippedImage needs their files immediately
+		if (!DkSettings::global.scanSubFolders) {
+			images.clear();
+			indexImages();
+			indexDir();
+			return true;
+		}
+
+		if (scanRecursive)
 			files = updateSubFolders(dir);
 		else 
 			files = getFilteredFileInfoList(dir, ignoreKeywords, keywords, folderKeywords);		// this line takes seconds if you have lots of files and slow loading (e.g. network)
@@ -278,12 +324,11 @@ bool DkImageLoader::loadDir(QDir newDir, bool scanRecursive) {
 
 		// ok new folder, this should speed-up loading
 		images.clear();
+		indexImages();
 		
-		// TODO: creating ~120 000 images takes about 2 secs
-		// but sorting (just filenames) takes ages (on windows)
-		// so we should fix this using 2 strategies: 
-		// - thread the image creation process
-		// - while loading (if the user wants to move in the folder) we could display some message (e.g. indexing dir)
+		// containers just keep their file record until they are used - so creating them is cheap
+		// however, sorting (just filenames) takes ages (on windows) - hence large folders are sorted threaded
+		// TODO: while sorting (if the user wants to move in the folder) we could display some message (e.g. indexing dir)
 		if (files.size() > 2000) {
 			createImages(files, false);
 			sortImagesThreaded(images);
@@ -318,6 +363,7 @@ void DkImageLoader::imagesSorted() {
 
 	sortingImages = false;
 	images = createImageWatcher.result();
+	indexImages();
 
 	if (sortingIsDirty) {
 		qDebug() << "re-sorting because it's dirty...";
@@ -326,55 +372,269 @@ void DkImageLoader::imagesSorted() {
 	}
 
 	emit updateDirSignal(images);
+	watchDir();
 
-	if (dirWatcher) {
-		if (!dirWatcher->directories().isEmpty())
-			dirWatcher->removePaths(dirWatcher->directories());
-		dirWatcher->addPath(dir.absolutePath());
+	// the file was requested while the images were sorted
+	if (loadPendingFile) {
+		loadPendingFile = false;
+		loadFileAt(pendingFileIdx);
 	}
 
 	qDebug() << "images sorted...";
 }
 
+/**
+ * Watches the current directory for changes.
+ **/ 
+void DkImageLoader::watchDir() {
+
+	QString dirPath = dir.absolutePath();
+
+	if (dirPath == watchedDir)
+		return;
+
+	DkFileWatcher& watcher = DkFileWatcher::instance();
+	
+	if (!watchedDir.isEmpty())
+		watcher.unwatchDir(watchedDir);
+
+	watchedDir = dirPath;
+	watcher.watchDir(watchedDir);
+}
+
+/**
+ * Starts indexing the current directory in a background thread.
+ * Images are appended (see filesIndexed) while the directory is indexed.
+ **/ 
+void DkImageLoader::indexDir() {
+
+	stopIndexing();
+	indexedFiles.clear();
+
+	dirIndexer = new DkDirIndexer(dir);
+	connect(dirIndexer, SIGNAL(filesIndexedSignal(const QStringList&, bool)), this, SLOT(filesIndexed(const QStringList&, bool)));
+	connect(dirIndexer, SIGNAL(finished()), dirIndexer, SLOT(deleteLater()));
+	dirIndexer->start();
+
+	qDebug() << "[DkImageLoader] indexing: " << dir.absolutePath();
+}
+
+/**
+ * Stops the directory indexer and waits until it is finished.
+ * The indexer deletes itself as soon as its thread is finished.
+ **/ 
+void DkImageLoader::stopIndexing() {
+
+	if (!dirIndexer)
+		return;
+
+	disconnect(dirIndexer, SIGNAL(filesIndexedSignal(const QStringList&, bool)), this, SLOT(filesIndexed(const QStringList&, bool)));
+	dirIndexer->stop();
+	dirIndexer->wait();		// it stops after the current directory entry
+	dirIndexer = 0;
+	loadPendingFile = false;
+}
+
+/**
+ * Receives file names from the directory indexer.
+ * The images are appended in the order they are indexed 
+ * and sorted as soon as the directory is indexed completely.
+ * @param fileNames the file names of the current batch
+ * @param finished if true, the directory is indexed completely
+ **/ 
+void DkImageLoader::filesIndexed(const QStringList& fileNames, bool finished) {
+
+	// ignore batches of old indexers
+	if (!dirIndexer || sender() != dirIndexer)
+		return;
+
+	indexedFiles.append(fileNames);
+
+	if (finished) {
+		dirIndexer = 0;	// deletes itself
+		folderIndexed();
+		return;
+	}
+
+	appendImages(filterFileList(dir, fileNames, ignoreKeywords, keywords, folderKeywords));
+	emit updateDirSignal(images);
+
+	// display the first image right away
+	if (loadPendingFile && pendingFileIdx == 0 && !images.empty()) {
+		loadPendingFile = false;
+		loadFileAt(0);
+	}
+}
+
+/**
+ * Updates the images when the directory indexer is finished.
+ * Containers that were appended while indexing are kept.
+ **/ 
+void DkImageLoader::folderIndexed() {
+
+	QFileInfoList files = filterFileList(dir, indexedFiles, ignoreKeywords, keywords, folderKeywords);
+	indexedFiles.clear();
+
+	qDebug() << "[DkImageLoader] " << dir.absolutePath() << " indexed, it contains: " << files.size() << " images";
+
+	if (files.empty()) {
+		emit showInfoSignal(tr("%1 \n does not contain any image").arg(dir.absolutePath()), 4000);	// stop showing
+		images.clear();
+		indexImages();
+		emit updateDirSignal(images);
+		loadPendingFile = false;
+		return;
+	}
+
+	QVector<QSharedPointer<DkImageContainerT > > indexedImages;
+	indexedImages.reserve(files.size());
+
+	for (int idx = 0; idx < files.size(); idx++) {
+
+		int cIdx = imageIdx.value(fileKey(files.at(idx)), -1);
+
+		if (cIdx != -1)
+			indexedImages.append(images.at(cIdx));
+		else
+			indexedImages.append(QSharedPointer<DkImageContainerT>(new DkImageContainerT(files.at(idx))));
+	}
+
+	images = indexedImages;
+	indexImages();
+
+	// see the comment in loadDir - the pending file is loaded in imagesSorted()
+	if (images.size() > 2000) {
+		sortImagesThreaded(images);
+		return;
+	}
+
+	images = sortImages(images);
+	indexImages();
+	emit updateDirSignal(images);
+	watchDir();
+
+	if (loadPendingFile) {
+		loadPendingFile = false;
+		loadFileAt(pendingFileIdx);
+	}
+}
+
+/**
+ * Appends new containers for all files that are not in images yet.
+ * @param files the files to be appended
+ **/ 
+void DkImageLoader::appendImages(const QFileInfoList& files) {
+
+	QString currentKey = currentImage ? fileKey(currentImage->file()) : QString();
+
+	for (int idx = 0; idx < files.size(); idx++) {
+
+		QString cKey = fileKey(files.at(idx));
+
+		if (imageIdx.contains(cKey))
+			continue;
+
+		// do not create a second container for the image that is already displayed
+		if (cKey == currentKey)
+			images.append(currentImage);
+		else
+			images.append(QSharedPointer<DkImageContainerT>(new DkImageContainerT(files.at(idx))));
+
+		imageIdx.insert(cKey, images.size()-1);
+	}
+}
+
 void DkImageLoader::createImages(const QFileInfoList& files, bool sort) {
 
 	DkTimer dt;
 	QVector<QSharedPointer<DkImageContainerT > > oldImages = images;
+	QHash<QString, int> oldImageIdx = imageIdx;
 	images.clear();
+	images.reserve(files.size());
 
 	for (int idx = 0; idx < files.size(); idx++) {
 
-		int oIdx = findFileIdx(files.at(idx), oldImages);
+		QString cKey = fileKey(files.at(idx));
+		int oIdx = oldImageIdx.value(cKey, -1);
 
-		if (oIdx != -1 && oldImages.at(oIdx)->file().lastModified() == files.at(idx).lastModified())
+		// keep old containers if the file was not modified (they might have cached their image)
+		if (oIdx != -1 && 
+			fileKey(oldImages.at(oIdx)->file()) == cKey && 
+			oldImages.at(oIdx)->file().lastModified() == files.at(idx).lastModified())
 			images.append(oldImages.at(oIdx));
 		else
 			images.append(QSharedPointer<DkImageContainerT >(new DkImageContainerT(files.at(idx))));
 	}
 	qDebug() << "[DkImageLoader] " << images.size() << " containers created in " << dt.getTotal();
 
+	if (sort)
+		images = sortImages(images);
+
+	indexImages();
+
 	if (sort) {
-		qSort(images.begin(), images.end(), imageContainerLessThanPtr);
 		qDebug() << "[DkImageLoader] after sorting: " << dt.getTotal();
 
 		emit updateDirSignal(images);
-
-		if (dirWatcher) {
-			if (!dirWatcher->directories().isEmpty())
-				dirWatcher->removePaths(dirWatcher->directories());
-			dirWatcher->addPath(dir.absolutePath());
-		}
+		watchDir();
 	}
 
 }
 
+/**
+ * Sorts the images according to the current sort mode.
+ * The sort keys are computed once (single threaded) so that comparisons
+ * just compare flat keys. Large folders are split into chunks 
+ * which are sorted in parallel and merged afterwards.
+ * @param images the images to be sorted
+ * @return QVector<QSharedPointer<DkImageContainerT > > the sorted images.
+ **/ 
 QVector<QSharedPointer<DkImageContainerT > > DkImageLoader::sortImages(QVector<QSharedPointer<DkImageContainerT > > images) const {
 
-	qSort(images.begin(), images.end(), imageContainerLessThanPtr);
+	DkTimer dt;
+	int sortMode = DkSettings::global.sortMode;
+	DkImageContainerLessThan lessThan(sortMode, DkSettings::global.sortDir);
+
+	// this is the only place where the file system might be touched (e.g. sort by date)
+	for (int idx = 0; idx < images.size(); idx++)
+		images[idx]->prepareSortKey(sortMode);
+
+	int numChunks = qMin(QThread::idealThreadCount(), images.size()/5000);
+
+	if (numChunks < 2) {
+		std::sort(images.begin(), images.end(), lessThan);
+	}
+	else {
+		QSharedPointer<DkImageContainerT>* data = images.data();
+		int chunkSize = qCeil((double)images.size()/numChunks);
+		QVector<int> bounds;
+
+		for (int idx = 0; idx < images.size(); idx += chunkSize)
+			bounds.append(idx);
+		bounds.append(images.size());
+
+		QList<QFuture<void> > futures;
+		for (int idx = 0; idx < bounds.size()-1; idx++)
+			futures.append(QtConcurrent::run(&DkImageLoader::sortRange, data+bounds[idx], data+bounds[idx+1], lessThan));
+
+		for (int idx = 0; idx < futures.size(); idx++)
+			futures[idx].waitForFinished();
+
+		// merge the sorted chunks
+		for (int idx = 1; idx < bounds.size()-1; idx++)
+			std::inplace_merge(data, data+bounds[idx], data+bounds[idx+1], lessThan);
+	}
+
+	qDebug() << "[DkImageLoader] " << images.size() << " images sorted in " << dt.getTotal();
 
 	return images;
 }
 
+void DkImageLoader::sortRange(QSharedPointer<DkImageContainerT>* begin, QSharedPointer<DkImageContainerT>* end, DkImageContainerLessThan lessThan) {
+
+	std::sort(begin, end, lessThan);
+}
+
 /**
  * Loads the ancesting or subsequent file.
  * @param skipIdx the number of files that should be skipped after/before the current file.
@@ -443,7 +703,7 @@ QSharedPointer<DkImageContainerT> DkImageLoader::getSkippedImage(int skipIdx, bo
 
 		QFileInfo file = (currentImage->exists()) ? currentImage->file() : DkSettings::global.recentFiles.first();
 
-		tmpFileIdx = findFileIdx(file, images);
+		tmpFileIdx = findFileIdx(file);
 
 		// could not locate the file -> it was deleted?!
 		if (tmpFileIdx == -1) {
@@ -593,6 +853,13 @@ void DkImageLoader::loadFileAt(int idx) {
 	if (currentImage && !dir.exists())
 		loadDir(currentImage->file());
 
+	// the folder is still indexed or sorted - load the file as soon as it is available
+	if ((dirIndexer && (images.empty() || idx == -1)) || sortingImages) {
+		loadPendingFile = true;
+		pendingFileIdx = idx;
+		return;
+	}
+
 	if(images.empty())
 		return;
 
@@ -653,13 +920,35 @@ QSharedPointer<DkImageContainerT> DkImageLoader::findFile(const QFileInfo& file)
 		}
 	}
 
-	for (int idx = 0; idx < images.size(); idx++) {
+	int idx = findFileIdx(file);
+
+	if (idx < 0)
+		return QSharedPointer<DkImageContainerT>();
+	
+	return images[idx];
+}
 
-		if (images[idx]->file() == file)
-			return images[idx];
+/**
+ * Returns the index of a file in the current folder.
+ * The look-up is done using the file index which is updated 
+ * whenever images changes (no linear search).
+ * @param file the file to look for
+ * @return int the index of file in images or -1 if it is not in the current folder.
+ **/ 
+int DkImageLoader::findFileIdx(const QFileInfo& file) const {
+
+	int idx = imageIdx.value(fileKey(file), -1);
+
+	if (idx >= 0 && idx < images.size() && fileKey(images[idx]->file()) == fileKey(file))
+		return idx;
+	
+	// the index is outdated (e.g. a container changed its file info)
+	if (idx != -1) {
+		qDebug() << "[DkImageLoader] WARNING: file index is outdated for: " << file.absoluteFilePath();
+		return findFileIdx(file, images);
 	}
 
-	return QSharedPointer<DkImageContainerT>();
+	return -1;
 }
 
 int DkImageLoader::findFileIdx(const QFileInfo& file, const QVector<QSharedPointer<DkImageContainerT> >& images) const {
@@ -673,6 +962,41 @@ int DkImageLoader::findFileIdx(const QFileInfo& file, const QVector<QSharedPoint
 	return -1;
 }
 
+/**
+ * Updates the file index.
+ * Call this function whenever images is changed.
+ **/ 
+void DkImageLoader::indexImages() {
+
+	imageIdx.clear();
+	imageIdx.reserve(images.size());
+
+	for (int idx = 0; idx < images.size(); idx++)
+		imageIdx.insert(fileKey(images[idx]->file()), idx);
+
+	// forget about cached images that are not part of the folder anymore
+	for (int idx = recentImages.size()-1; idx >= 0; idx--) {
+
+		int rIdx = imageIdx.value(fileKey(recentImages.at(idx)->file()), -1);
+
+		if (rIdx == -1 || images.at(rIdx) != recentImages.at(idx))
+			recentImages.removeAt(idx);
+	}
+}
+
+/**
+ * Returns the key of a file in the file index.
+ * @param file the file
+ * @return QString the absolute file path (lower case on windows since its file system is case insensitive).
+ **/ 
+QString DkImageLoader::fileKey(const QFileInfo& file) {
+
+#ifdef WIN32
+	return file.absoluteFilePath().toLower();
+#else
+	return file.absoluteFilePath();
+#endif
+}
 
 //
 ///**
@@ -706,6 +1030,7 @@ QVector<QSharedPointer<DkImageContainerT> > DkImageLoader::getImages() {
 void DkImageLoader::setImages(QVector<QSharedPointer<DkImageContainerT> > images) {
 
 	this->images = images;
+	indexImages();
 	emit updateDirSignal(images);
 }
 
@@ -850,6 +1175,7 @@ void DkImageLoader::reloadImage() {
 
 	dir = QDir();
 	images.clear();
+	indexImages();
 	currentImage->clear();
 	setCurrentImage(currentImage);
 	load(currentImage);
@@ -880,6 +1206,9 @@ void DkImageLoader::load(QSharedPointer<DkImageContainerT> image /* = QSharedPoi
 	if (!image)
 		return;
 
+	// the user selected an image - forget about pending first/last file requests
+	loadPendingFile = false;
+
 #ifdef WITH_QUAZIP
 	bool isZipArchive = DkBasicLoader::isContainer(image->file());
 
@@ -895,6 +1224,12 @@ void DkImageLoader::load(QSharedPointer<DkImageContainerT> image /* = QSharedPoi
 	if (currentImage && currentImage->getLoadState() == DkImageContainerT::loading)
 		return;
 
+	// revisiting a cached image costs nothing
+	if (currentImage->hasImage())
+		numCacheHits++;
+	else
+		numCacheMisses++;
+
 	emit updateSpinnerSignalDelayed(true);
 	bool loaded = currentImage->loadImageThreaded();	// loads file threaded
 	
@@ -923,12 +1258,17 @@ void DkImageLoader::imageLoaded(bool loaded /* = false */) {
 		emit updateFileSignal(currentImage->file());
 
 		// this signal is needed by the folder scrollbar
-		int idx = findFileIdx(currentImage->file(), images);
+		int idx = findFileIdx(currentImage->file());
 		emit imageUpdatedSignal(idx);
 	}
 
 	QApplication::sendPostedEvents();	// force an event post here
 
+	// progressive RAW loading: the embedded preview is shown - develop the full image in the background
+	if (DkSettings::resources.loadRawThumb == DkSettings::raw_thumb_progressive && 
+		currentImage && currentImage->isDownscaled() && currentImage->getLoader()->getLoader() == DkBasicLoader::raw_loader)
+		currentImage->loadFullSizeThreaded();
+
 	if (currentImage && currentImage->isFileDownloaded())
 		saveTempFile(currentImage->image());
 
@@ -939,6 +1279,23 @@ void DkImageLoader::imageLoaded(bool loaded /* = false */) {
 		emit imageHasGPSSignal(DkMetaDataHelper::getInstance().hasGPS(currentImage->getMetaData()));
 }
 
+/**
+ * Loads the full resolution of the current image if it was decoded at screen resolution.
+ **/ 
+void DkImageLoader::loadFullSize() {
+
+	if (currentImage && currentImage->isDownscaled())
+		currentImage->loadFullSizeThreaded();
+}
+
+void DkImageLoader::fullSizeLoaded(bool loaded) {
+
+	if (!currentImage || !loaded)
+		return;
+
+	emit imageFullSizeSignal(currentImage);
+}
+
 void DkImageLoader::downloadFile(const QUrl& url) {
 
 	QSharedPointer<DkImageContainerT> newImg = findOrCreateFile(QFileInfo());
@@ -1279,15 +1636,20 @@ void DkImageLoader::saveFile(QFileInfo file, QImage saveImg, QString fileFilter,
 	}
 
 	emit updateSpinnerSignalDelayed(true);
+
+	// never save the screen sized image
+	if (saveImg.isNull())
+		imgC->loadFullSize();
+
 	QImage sImg = (saveImg.isNull()) ? imgC->image() : saveImg;
 
 	qDebug() << "saving: " << file.absoluteFilePath();
 
-	dirWatcher->blockSignals(true);
+	savingFile = true;
 	bool saveStarted = (threaded) ? imgC->saveImageThreaded(file, sImg, compression) : imgC->saveImage(file, sImg, compression);
 
 	if (!saveStarted) {
-		dirWatcher->blockSignals(false);
+		savingFile = false;
 		imageSaved(QFileInfo(), false);
 	}
 	else if (saveStarted && !threaded) {
@@ -1298,7 +1660,7 @@ void DkImageLoader::saveFile(QFileInfo file, QImage saveImg, QString fileFilter,
 void DkImageLoader::imageSaved(QFileInfo file, bool saved) {
 
 	emit updateSpinnerSignalDelayed(false);
-	dirWatcher->blockSignals(false);
+	savingFile = false;
 
 	if (!file.exists() || !file.isFile() || !saved)
 		return;
@@ -1512,6 +1874,8 @@ void DkImageLoader::rotateImage(double angle) {
 		return;
 	}
 
+	// the rotated image might be saved
+	currentImage->loadFullSize();
 	currentImage->getLoader()->rotate(qRound(angle));
 
 	QImage thumb = DkImage::createThumb(currentImage->image());
@@ -1601,6 +1965,10 @@ bool DkImageLoader::restoreFile(const QFileInfo& fileInfo) {
  **/ 
 void DkImageLoader::directoryChanged(const QString& path) {
 
+	// imageSaved updates the folder
+	if (savingFile && !path.isEmpty())
+		return;
+
 	if (path.isEmpty() || QDir(path) == dir.absolutePath()) {
 
 		folderUpdated = true;
@@ -1623,6 +1991,117 @@ void DkImageLoader::directoryChanged(const QString& path) {
 	
 }
 
+/**
+ * Collects file events of the current directory.
+ * The events are coalesced and applied in updateChangedFiles.
+ * @param filePath the file that was created, modified or deleted
+ * @param event the DkFileWatcher event
+ **/ 
+void DkImageLoader::fileChanged(const QString& filePath, int event) {
+
+	if (QFileInfo(filePath).absolutePath() != watchedDir)
+		return;
+
+	changedFiles.insert(filePath, event);	// the last event wins
+
+	if (!fileEventTimer.isActive())
+		fileEventTimer.start();
+}
+
+/**
+ * Applies the collected file events to the images.
+ * Deleted files are removed and new files are inserted at their sorted position,
+ * so the directory does not need to be listed again. Modified files get
+ * a new container (except for the current image which reloads itself).
+ * The directory is listed again if the events cannot be applied incrementally.
+ **/ 
+void DkImageLoader::updateChangedFiles() {
+
+	if (changedFiles.empty())
+		return;
+
+	// filtering duplicates needs all files, sub folders are not watched
+	// and the indexer/sorting threads will replace images anyway
+	if (dirIndexer || createImageWatcher.isRunning() || 
+		DkSettings::resources.filterDuplicats || DkSettings::global.scanSubFolders) {
+		changedFiles.clear();
+		directoryChanged(watchedDir);
+		return;
+	}
+
+	DkTimer dt;
+	QString currentKey = currentImage ? fileKey(currentImage->file()) : QString();
+	QSet<QString> removedKeys;
+	QStringList newFiles;
+
+	QHash<QString, int>::const_iterator fIter = changedFiles.constBegin();
+	for (; fIter != changedFiles.constEnd(); fIter++) {
+
+		QFileInfo cFile(fIter.key());
+		QString cKey = fileKey(cFile);
+
+		if (fIter.value() == DkFileWatcher::file_deleted) {
+			removedKeys.insert(cKey);
+			continue;
+		}
+
+		// the current image updates itself
+		if (cKey == currentKey && imageIdx.contains(cKey))
+			continue;
+
+		if (!QDir::match(DkSettings::app.browseFilters, cFile.fileName()))
+			continue;
+
+		// replace containers of modified files (they might have cached the old image)
+		if (imageIdx.contains(cKey))
+			removedKeys.insert(cKey);
+
+		newFiles.append(cFile.fileName());
+	}
+	changedFiles.clear();
+
+	QFileInfoList files = filterFileList(dir, newFiles, ignoreKeywords, keywords, folderKeywords);
+
+	if (removedKeys.empty() && files.empty())
+		return;
+
+	if (!removedKeys.empty()) {
+
+		QVector<QSharedPointer<DkImageContainerT> > keptImages;
+		keptImages.reserve(images.size());
+
+		for (int idx = 0; idx < images.size(); idx++) {
+			if (!removedKeys.contains(fileKey(images.at(idx)->file())))
+				keptImages.append(images.at(idx));
+		}
+		images = keptImages;
+	}
+
+	int sortMode = DkSettings::global.sortMode;
+	DkImageContainerLessThan lessThan(sortMode, DkSettings::global.sortDir);
+
+	for (int idx = 0; idx < files.size(); idx++) {
+
+		// the file might be gone already
+		if (!files.at(idx).exists())
+			continue;
+
+		// do not create a second container for the image that is already displayed
+		QSharedPointer<DkImageContainerT> imgC = (fileKey(files.at(idx)) == currentKey) ? 
+			currentImage : QSharedPointer<DkImageContainerT>(new DkImageContainerT(files.at(idx)));
+		imgC->prepareSortKey(sortMode);
+		images.insert(std::upper_bound(images.begin(), images.end(), imgC, lessThan), imgC);
+	}
+
+	indexImages();
+	qDebug() << "[DkImageLoader]" << removedKeys.size() << "removed," << files.size() << "new files applied in" << dt.getTotal();
+
+	if (images.empty())
+		emit showInfoSignal(tr("%1 \n does not contain any image").arg(dir.absolutePath()), 4000);	// stop showing
+
+	emit updateDirSignal(images);
+}
+
 /**
  * Returns true if a file was specified.
  * @return bool true if a file name/path was specified
@@ -1793,6 +2272,15 @@ void DkImageLoader::errorDialog(const QString& msg) const {
 	errorDialog.exec();
 }
 
+/**
+ * Updates the image cache.
+ * Images are kept in a least recently used list. If the images
+ * need more memory than DkSettings::resources.cacheMemory, the least recently
+ * used images are released. The previous image and the next maxImagesCached
+ * images (in browsing direction) are never released and they are prefetched
+ * if there is memory left (the next image is loaded, the others are just read into memory).
+ * @param imgC the image that was just loaded.
+ **/ 
 void DkImageLoader::updateCacher(QSharedPointer<DkImageContainerT> imgC) {
 
 	if (!imgC || !DkSettings::resources.cacheMemory)
@@ -1800,57 +2288,125 @@ void DkImageLoader::updateCacher(QSharedPointer<DkImageContainerT> imgC) {
 
 	DkTimer dt;
 
-	//// no caching? delete all
-	//if (!DkSettings::resources.cacheMemory) {
-	//	for (int idx = 0; idx < images.size(); idx++) {
-	//		images.at(idx)->clear();
-	//	}
-	//	return;
-	//}
-
-	int cIdx = findFileIdx(imgC->file(), images);
-	float mem = 0;
+	int cIdx = findFileIdx(imgC->file());
 
 	if (cIdx == -1) {
 		qDebug() << "WARNING: image not found for caching!";
 		return;
 	}
 
-	for (int idx = 0; idx < images.size(); idx++) {
+	// guess the browsing direction
+	if (lastCacheIdx != -1 && lastCacheIdx < images.size()) {
+		int diff = cIdx - lastCacheIdx;
+
+		// we jumped from the last to the first image (or vice versa)
+		if (DkSettings::global.loop && qAbs(diff) > images.size()/2)
+			diff = -diff;
+
+		if (diff != 0)
+			cacheDirection = (diff > 0) ? 1 : -1;
+	}
+	lastCacheIdx = cIdx;
+
+	// the current image is the most recently used one
+	recentImages.removeAll(imgC);
+	recentImages.prepend(imgC);
+
+	// the prefetch window: the previous image + the next images in browsing direction
+	QVector<QSharedPointer<DkImageContainerT> > prefetchImages;
+
+	for (int idx = 1; idx <= DkSettings::resources.maxImagesCached; idx++) {
+
+		int pIdx = cIdx + idx*cacheDirection;
+
+		if (DkSettings::global.loop)
+			pIdx = (pIdx % images.size() + images.size()) % images.size();
+
+		if (pIdx >= 0 && pIdx < images.size() && pIdx != cIdx && !prefetchImages.contains(images.at(pIdx)))
+			prefetchImages.append(images.at(pIdx));
+	}
+
+	int lIdx = cIdx - cacheDirection;
+	if (DkSettings::global.loop)
+		lIdx = (lIdx % images.size() + images.size()) % images.size();
+	QSharedPointer<DkImageContainerT> lastImg = (lIdx >= 0 && lIdx < images.size() && lIdx != cIdx) ? images.at(lIdx) : QSharedPointer<DkImageContainerT>();
+
+	float mem = 0;
+
+	for (int idx = recentImages.size()-1; idx >= 0; idx--) {
+
+		QSharedPointer<DkImageContainerT> cImg = recentImages.at(idx);
 
 		// clear images if they are edited
-		if (idx != cIdx && images.at(idx)->isEdited()) {
-			images.at(idx)->clear();
+		if (cImg != imgC && cImg->isEdited()) {
+			cImg->clear();
+			recentImages.removeAt(idx);
 			continue;
 		}
 
-		if (idx >= cIdx-1 && idx <= cIdx+DkSettings::resources.maxImagesCached)
-			mem += images.at(idx)->getMemoryUsage();
-		else {
-			images.at(idx)->clear();
+		mem += cImg->getMemoryUsage();
+	}
+
+	// release the least recently used images
+	for (int idx = recentImages.size()-1; idx > 0 && mem > DkSettings::resources.cacheMemory; idx--) {
+
+		QSharedPointer<DkImageContainerT> cImg = recentImages.at(idx);
+
+		if (cImg == imgC || cImg == lastImg || prefetchImages.contains(cImg))
 			continue;
-		}
 
-		// ignore the last and current one
-		if (idx == cIdx-1 || idx == cIdx) {
+		mem -= cImg->getMemoryUsage();
+		cImg->clear();
+		recentImages.removeAt(idx);
+		numCacheEvictions++;
+		qDebug() << "[Cacher] " << cImg->file().fileName() << " released";
+	}
+
+	// prefetch - the nearest images first
+	for (int idx = 0; idx < prefetchImages.size() && mem < DkSettings::resources.cacheMemory; idx++) {
+
+		QSharedPointer<DkImageContainerT> cImg = prefetchImages.at(idx);
+
+		if (!recentImages.contains(cImg))
+			recentImages.insert(qMin(idx+1, recentImages.size()), cImg);
+
+		if (cImg->getLoadState() != DkImageContainerT::not_loaded)
 			continue;
-		}
+
 		// fully load the next image
-		else if (idx == cIdx+1 && mem < DkSettings::resources.cacheMemory && images.at(idx)->getLoadState() == DkImageContainerT::not_loaded) {
-			images.at(idx)->loadImageThreaded();
-			qDebug() << "[Cacher] " << images.at(idx)->file().absoluteFilePath() << " fully cached...";
+		if (idx == 0) {
+			cImg->loadImageThreaded();
+			qDebug() << "[Cacher] " << cImg->file().absoluteFilePath() << " fully cached...";
 		}
-		else if (idx > cIdx && idx < cIdx+DkSettings::resources.maxImagesCached-2 && mem < DkSettings::resources.cacheMemory && images.at(idx)->getLoadState() == DkImageContainerT::not_loaded) {
-			//dt.getIvl();
-			images.at(idx)->fetchFile();		// TODO: crash detected here
-			qDebug() << "[Cacher] " << images.at(idx)->file().absoluteFilePath() << " file fetched...";
+		else {
+			cImg->fetchFile();
+			qDebug() << "[Cacher] " << cImg->file().absoluteFilePath() << " file fetched...";
 		}
+
+		// we don't know the image size yet
+		mem += cImg->getFileSize();
 	}
 
-	qDebug() << "cache with: " << mem << " MB created in: " << dt.getTotal();
+	qDebug() << "cache with: " << mem << " MB created in: " << dt.getTotal() << 
+		" hits: " << numCacheHits << " misses: " << numCacheMisses << " evictions: " << numCacheEvictions;
 
 }
 
+int DkImageLoader::getNumCacheHits() const {
+
+	return numCacheHits;
+}
+
+int DkImageLoader::getNumCacheMisses() const {
+
+	return numCacheMisses;
+}
+
+int DkImageLoader::getNumCacheEvictions() const {
+
+	return numCacheEvictions;
+}
+
 /**
  * Returns the file list of the directory dir.
  * Note: this function might get slow if lots of files (> 10000) are in the
@@ -1931,6 +2487,20 @@ QFileInfoList DkImageLoader::getFilteredFileInfoList(const QDir& dir, QStringLis
 
 #endif
 
+	return filterFileList(dir, fileList, ignoreKeywords, keywords, folderKeywords);
+}
+
+/**
+ * Filters a list of file names.
+ * @param dir the directory of the files.
+ * @param fileList the file names.
+ * @param ignoreKeywords if one of these keywords is in the file name, the file will be ignored.
+ * @param keywords if one of these keywords is not in the file name, the file will be ignored.
+ * @param folderKeywords the folder filters (set by the user).
+ * @return QFileInfoList all filtered files.
+ **/ 
+QFileInfoList DkImageLoader::filterFileList(const QDir& dir, QStringList fileList, QStringList ignoreKeywords, QStringList keywords, QStringList folderKeywords) {
+
 	for (int idx = 0; idx < ignoreKeywords.size(); idx++) {
 		QRegExp exp = QRegExp("^((?!" + ignoreKeywords[idx] + ").)*$");
 		exp.setCaseSensitivity(Qt::CaseInsensitive);
@@ -1963,34 +2533,7 @@ QFileInfoList DkImageLoader::getFilteredFileInfoList(const QDir& dir, QStringLis
 		preferredExtension = preferredExtension.replace("*.", "");
 		qDebug() << "preferred extension: " << preferredExtension;
 
-		QStringList resultList = fileList;
-		fileList.clear();
-		
-		for (int idx = 0; idx < resultList.size(); idx++) {
-			
-			QFileInfo cFName = QFileInfo(resultList.at(idx));
-
-			if (preferredExtension.compare(cFName.suffix(), Qt::CaseInsensitive) == 0) {
-				fileList.append(resultList.at(idx));
-				continue;
-			}
-
-			QString cFBase = cFName.baseName();
-			bool remove = false;
-
-			for (int cIdx = 0; cIdx < resultList.size(); cIdx++) {
-
-				QString ccBase = QFileInfo(resultList.at(cIdx)).baseName();
-
-				if (cIdx != idx && ccBase == cFBase && resultList.at(cIdx).contains(preferredExtension, Qt::CaseInsensitive)) {
-					remove = true;
-					break;
-				}
-			}
-			
-			if (!remove)
-				fileList.append(resultList.at(idx));
-		}
+		fileList = filterDuplicates(fileList, preferredExtension);
 	}
 
 	//fileList = sort(fileList, dir);
@@ -2003,9 +2546,59 @@ QFileInfoList DkImageLoader::getFilteredFileInfoList(const QDir& dir, QStringLis
 	return fileInfoList;
 }
 
+/**
+ * Removes duplicated files (e.g. RAW+JPG).
+ * Files are grouped by their base name (file name up to the first dot).
+ * If a group contains a file with the preferred extension, all other
+ * files of this group are removed. Groups without preferred files are kept.
+ * The file names are parsed just once - so this is linear in the number of files
+ * (the former nested loop created O(n^2) QFileInfos).
+ * @param fileList the file names (no paths)
+ * @param preferredExtension the preferred extension (without *.)
+ * @return QStringList the file names without duplicates (the order is kept).
+ **/ 
+QStringList DkImageLoader::filterDuplicates(const QStringList& fileList, const QString& preferredExtension) {
+
+	DkTimer dt;
+	QVector<QString> baseNames(fileList.size());
+	QVector<bool> preferred(fileList.size(), false);
+	QSet<QString> preferredBaseNames;
+	preferredBaseNames.reserve(fileList.size());
+
+	// first sweep: find all groups that contain a preferred file
+	for (int idx = 0; idx < fileList.size(); idx++) {
+
+		const QString& cName = fileList.at(idx);
+		int suffixIdx = cName.lastIndexOf('.');
+
+		// same as QFileInfo::baseName() but without creating a QFileInfo
+		baseNames[idx] = cName.left(cName.indexOf('.'));
+
+		if (suffixIdx != -1 && preferredExtension.compare(cName.mid(suffixIdx+1), Qt::CaseInsensitive) == 0) {
+			preferred[idx] = true;
+			preferredBaseNames.insert(baseNames[idx]);
+		}
+	}
+
+	// second sweep: keep preferred files and files whose group has no preferred file
+	QStringList resultList;
+	resultList.reserve(fileList.size());
+
+	for (int idx = 0; idx < fileList.size(); idx++) {
+
+		if (preferred[idx] || !preferredBaseNames.contains(baseNames[idx]))
+			resultList.append(fileList.at(idx));
+	}
+
+	qDebug() << "[DkImageLoader]" << fileList.size()-resultList.size() << "of" << fileList.size() << "duplicates removed in" << dt.getTotal();
+
+	return resultList;
+}
+
 void DkImageLoader::sort() {
 	
-	qSort(images.begin(), images.end(), imageContainerLessThanPtr);
+	images = sortImages(images);
+	indexImages();
 	emit updateDirSignal(images);
 }
 
@@ -2150,6 +2743,124 @@ QString DkImageLoader::fileName() {
 	return currentImage->file().fileName();
 }
 
+// DkDirIndexer --------------------------------------------------------------------
+DkDirIndexer::DkDirIndexer(const QDir& dir) {
+
+	this->dir = dir;
+	isActive = 1;
+}
+
+QDir DkDirIndexer::getDir() const {
+
+	return dir;
+}
+
+/**
+ * Stops indexing.
+ * The thread finishes after the current directory entry.
+ **/ 
+void DkDirIndexer::stop() {
+
+	isActive.fetchAndStoreOrdered(0);
+}
+
+bool DkDirIndexer::active() {
+
+	return isActive.testAndSetOrdered(1, 1);
+}
+
+/**
+ * Thread routine.
+ * Reads the directory entries and emits the file names in batches.
+ * The first batch holds just one file so that it can be displayed immediately.
+ * Subsequent batches grow, so that the receiver's updates stay linear in the folder size.
+ **/ 
+void DkDirIndexer::run() {
+
+	DkTimer dt;
+	QStringList fileNames;
+	int batchSize = 1;
+	int numFiles = 0;
+	QTime batchTime;
+	batchTime.start();
+
+#ifdef WIN32
+
+	QString winPath = QDir::toNativeSeparators(dir.path()) + "\\*.*";
+	const wchar_t* fname = reinterpret_cast<const wchar_t *>(winPath.utf16());
+
+	// remove the * in fileFilters
+	QStringList fileFiltersClean = DkSettings::app.browseFilters;
+	for (int idx = 0; idx < fileFiltersClean.size(); idx++)
+		fileFiltersClean[idx].replace("*", "");
+
+	WIN32_FIND_DATAW findFileData;
+	HANDLE MyHandle = FindFirstFileW(fname, &findFileData);
+
+	if (MyHandle != INVALID_HANDLE_VALUE) {
+
+		do {
+			QString qFilename = DkUtils::stdWStringToQString(findFileData.cFileName);
+
+			// see getFilteredFileInfoList
+			for (int idx = 0; idx < fileFiltersClean.size(); idx++) {
+
+				if (qFilename.contains(fileFiltersClean[idx], Qt::CaseInsensitive)) {
+					fileNames.append(qFilename);
+					break;
+				}
+			}
+
+			numFiles += sendBatch(fileNames, batchSize, batchTime);
+
+		} while (active() && FindNextFileW(MyHandle, &findFileData) != 0);
+	}
+
+	FindClose(MyHandle);
+#else
+
+	QDirIterator dirIterator(dir.absolutePath(), DkSettings::app.browseFilters, QDir::Files);
+
+	while (active() && dirIterator.hasNext()) {
+		dirIterator.next();
+		fileNames.append(dirIterator.fileName());
+		numFiles += sendBatch(fileNames, batchSize, batchTime);
+	}
+#endif
+
+	if (!active()) {
+		qDebug() << "[DkDirIndexer] stopped...";
+		return;
+	}
+
+	numFiles += fileNames.size();
+	emit filesIndexedSignal(fileNames, true);
+	
+	qDebug() << "[DkDirIndexer] " << numFiles << " files indexed in: " << dt.getTotal();
+}
+
+/**
+ * Emits the current batch if it is full or if the last batch was emitted a while ago.
+ * @param fileNames the current batch - it is cleared if it was emitted
+ * @param batchSize the current batch size - it is doubled if the batch was emitted
+ * @param batchTime the time since the last batch was emitted
+ * @return int the number of files emitted.
+ **/ 
+int DkDirIndexer::sendBatch(QStringList& fileNames, int& batchSize, QTime& batchTime) {
+
+	if (fileNames.empty() || (fileNames.size() < batchSize && batchTime.elapsed() < 500))
+		return 0;
+
+	int numFiles = fileNames.size();
+	emit filesIndexedSignal(fileNames, false);
+
+	fileNames.clear();
+	batchSize = qMin(qMax(batchSize*2, 256), 16384);
+	batchTime.restart();
+
+	return numFiles;
+}
+
 // DkColorLoader --------------------------------------------------------------------
 DkColorLoader::DkColorLoader(QVector<QSharedPointer<DkImageContainerT> > images) {
 
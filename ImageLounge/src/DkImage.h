@@ -34,6 +34,10 @@
 #include <QMutex>
 #include <QStringList>
 #include <QImage>
+#include <QHash>
+#include <QDir>
+#include <QTime>
+#include <QAtomicInt>
 #pragma warning(pop)	// no warnings from includes - end
 
 #ifndef DllExport
@@ -72,11 +76,38 @@
 //#endif
 
 // Qt defines
-class QFileSystemWatcher;
 class QUrl;
 
 namespace nmc {
 
+/**
+ * Indexes a directory in a separate thread.
+ * The file names are delivered in batches, so the 
+ * folder can be browsed before it is indexed completely
+ * (e.g. large folders on network shares).
+ **/ 
+class DkDirIndexer : public QThread {
+	Q_OBJECT
+
+public:
+	DkDirIndexer(const QDir& dir);
+	~DkDirIndexer() {};
+
+	void run();
+	void stop();
+	QDir getDir() const;
+
+signals:
+	void filesIndexedSignal(const QStringList& fileNames, bool finished);
+
+protected:
+	int sendBatch(QStringList& fileNames, int& batchSize, QTime& batchTime);
+	bool active();
+
+	QDir dir;
+	QAtomicInt isActive;	// cleared by stop() from the GUI thread
+};
+
 /**
  * This class is a basic image loader class.
  * It takes care of the file watches for the current folder,
@@ -100,6 +131,8 @@ public:
 	static QStringList getFoldersRecursive(QDir dir);
 	QFileInfoList updateSubFolders(QDir rootDir);
 	QFileInfoList getFilteredFileInfoList(const QDir& dir, QStringList ignoreKeywords = QStringList(), QStringList keywords = QStringList(), QStringList folderKeywords = QStringList());
+	static QStringList filterDuplicates(const QStringList& fileList, const QString& preferredExtension);
+	QFileInfoList filterFileList(const QDir& dir, QStringList fileList, QStringList ignoreKeywords = QStringList(), QStringList keywords = QStringList(), QStringList folderKeywords = QStringList());
 
 	void rotateImage(double angle);
 	QSharedPointer<DkImageContainerT> getCurrentImage() const;
@@ -125,6 +158,7 @@ public:
 	void sort();
 	QSharedPointer<DkImageContainerT> findOrCreateFile(const QFileInfo& file) const;
 	QSharedPointer<DkImageContainerT> findFile(const QFileInfo& file) const;
+	int findFileIdx(const QFileInfo& file) const;
 	int findFileIdx(const QFileInfo& file, const QVector<QSharedPointer<DkImageContainerT> >& images) const;
 	void setCurrentImage(QSharedPointer<DkImageContainerT> newImg);
 #ifdef WITH_QUAZIP
@@ -141,6 +175,10 @@ public:
 
 	static bool restoreFile(const QFileInfo &fileInfo);
 
+	int getNumCacheHits() const;
+	int getNumCacheMisses() const;
+	int getNumCacheEvictions() const;
+
 signals:
 	void folderFiltersChanged(QStringList filters);
 	void updateImageSignal();
@@ -155,6 +193,7 @@ signals:
 	void imageUpdatedSignal(QSharedPointer<DkImageContainerT> image);
 	void imageUpdatedSignal(int idx);	// folder scrollbar needs that
 	void imageLoadedSignal(QSharedPointer<DkImageContainerT> image, bool loaded = true);
+	void imageFullSizeSignal(QSharedPointer<DkImageContainerT> image);
 	void showInfoSignal(QString msg, int time = 3000, int position = 0);
 	void updateDirSignal(QVector<QSharedPointer<DkImageContainerT> > images);
 	void imageHasGPSSignal(bool hasGPS);
@@ -162,6 +201,8 @@ signals:
 public slots:
 	void changeFile(int skipIdx);
 	void directoryChanged(const QString& path = QString());
+	void fileChanged(const QString& filePath, int event);
+	void updateChangedFiles();
 	void saveFileWeb(QImage saveImg);
 	void saveUserFileAs(QImage saveImg, bool silent);
 	void saveFile(QFileInfo filename, QImage saveImg = QImage(), QString fileFilter = "", int compression = -1, bool threaded = true);
@@ -181,9 +222,12 @@ public slots:
 	// new slots
 	void imageLoaded(bool loaded = false);
 	void imageSaved(QFileInfo file, bool saved = true);
+	void fullSizeLoaded(bool loaded = true);
+	void loadFullSize();
 	void imagesSorted();
 	bool unloadFile();
 	void reloadImage();
+	void filesIndexed(const QStringList& fileNames, bool finished);
 
 protected:
 
@@ -191,9 +235,13 @@ protected:
 	bool timerBlockedUpdate;
 	QDir dir;
 	QDir saveDir;
-	QFileSystemWatcher* dirWatcher;
+	QString watchedDir;					// the directory registered with DkFileWatcher
+	QHash<QString, int> changedFiles;	// file path -> last DkFileWatcher event
+	QTimer fileEventTimer;				// coalesces file events
+	bool savingFile;
 	QStringList subFolders;
 	QVector<QSharedPointer<DkImageContainerT > > images;
+	QHash<QString, int> imageIdx;	// file path -> index in images (must be updated whenever images changes)
 	QSharedPointer<DkImageContainerT > currentImage;
 	QSharedPointer<DkImageContainerT > lastImageLoaded;
 	bool folderUpdated;
@@ -201,9 +249,23 @@ protected:
 	bool sortingImages;
 	bool sortingIsDirty;
 	QFutureWatcher<QVector<QSharedPointer<DkImageContainerT > > > createImageWatcher;
+	DkDirIndexer* dirIndexer;
+	QStringList indexedFiles;
+	bool loadPendingFile;
+	int pendingFileIdx;
+
+	// cache
+	QList<QSharedPointer<DkImageContainerT> > recentImages;	// most recently used images first
+	int lastCacheIdx;
+	int cacheDirection;
+	int numCacheHits;
+	int numCacheMisses;
+	int numCacheEvictions;
 
 	// functions
 	void updateCacher(QSharedPointer<DkImageContainerT> imgC);
+	void indexImages();
+	static QString fileKey(const QFileInfo& file);
 	int getNextFolderIdx(int folderIdx);
 	int getPrevFolderIdx(int folderIdx);
 	void updateHistory();
@@ -211,7 +273,13 @@ protected:
 	QString getTitleAttributeString();
 	void sortImagesThreaded(QVector<QSharedPointer<DkImageContainerT > > images);
 	void createImages(const QFileInfoList& files, bool sort = true);
+	void appendImages(const QFileInfoList& files);
+	void indexDir();
+	void stopIndexing();
+	void folderIndexed();
+	void watchDir();
 	QVector<QSharedPointer<DkImageContainerT > > sortImages(QVector<QSharedPointer<DkImageContainerT > > images) const;
+	static void sortRange(QSharedPointer<DkImageContainerT>* begin, QSharedPointer<DkImageContainerT>* end, DkImageContainerLessThan lessThan);
 };
 
 // deprecated
@@ -37,7 +37,17 @@
 #pragma warning(push, 0)	// no warnings from includes - begin
 #include <QObject>
 #include <QImage>
+#include <QDateTime>
 #include <QtConcurrentRun>
+#include <QApplication>
+#include <QDesktopWidget>
+#include <QCoreApplication>
+#include <QSocketNotifier>
+#include <QFileSystemWatcher>
+#include <QDir>
+#include <QFile>
+#include <QThread>
+#include <QThreadStorage>
 
 // quazip
 #ifdef WITH_QUAZIP
@@ -45,6 +55,13 @@
 #endif
 #pragma warning(pop)		// no warnings from includes - end
 
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
 #pragma warning(disable: 4251)	// TODO: remove
 
 
@@ -62,6 +79,7 @@ QString DkZipContainer::mZipMarker = "dIrChAr";
  **/ 
 DkImageContainer::DkImageContainer(const QFileInfo& fileInfo) {
 	
+	sortRandom = 0;
 	setFileInfo(fileInfo);
 	loadState = not_loaded;
 	init();
@@ -205,6 +223,7 @@ float DkImageContainer::getMemoryUsage() const {
 
 	float memSize = fileBuffer ? fileBuffer->size()/(1024.0f*1024.0f) : 0;
 	memSize += DkImage::getBufferSizeFloat(loader->image().size(), loader->image().depth());
+	memSize += loader->getPrefetchMemory();	// neighboring pages of multi-page TIFFs
 
 	return memSize;
 }
@@ -239,13 +258,9 @@ void DkImageContainer::setFileInfo(const QFileInfo& fileInfo) {
 
 	this->fileInfo = fileInfo;
 
-#ifdef WIN32
-#if QT_VERSION < 0x050000
-	this->fileNameStr = fileInfo.fileName().toStdWString();
-#else
-	this->fileNameStr = DkUtils::qStringToStdWString(fileInfo.fileName());
-#endif
-#endif
+	// parse the file name once - sorting just compares the keys
+	sortName = DkUtils::naturalSortKey(fileInfo.fileName());
+	sortDatesCached = false;
 }
 
 bool DkImageContainer::hasImage() const {
@@ -261,11 +276,22 @@ int DkImageContainer::getLoadState() const {
 	return loadState;
 }
 
-bool DkImageContainer::loadImage() {
+/**
+ * Loads the file to the buffer (if it is not already there) without decoding it.
+ * @return bool true if the buffer is not empty
+ **/ 
+bool DkImageContainer::readFile() {
 
 	if (getFileBuffer()->isEmpty())
 		fileBuffer = loadFileToBuffer(fileInfo);
 
+	return fileBuffer && !fileBuffer->isEmpty();
+}
+
+bool DkImageContainer::loadImage() {
+
+	readFile();
+
 	loader = loadImageIntern(fileInfo, getLoader(), fileBuffer);
 
 	return loader->hasImage();
@@ -308,10 +334,10 @@ QSharedPointer<QByteArray> DkImageContainer::loadFileToBuffer(const QFileInfo fi
 }
 
 
-QSharedPointer<DkBasicLoader> DkImageContainer::loadImageIntern(const QFileInfo fileInfo, QSharedPointer<DkBasicLoader> loader, const QSharedPointer<QByteArray> fileBuffer) {
+QSharedPointer<DkBasicLoader> DkImageContainer::loadImageIntern(const QFileInfo fileInfo, QSharedPointer<DkBasicLoader> loader, const QSharedPointer<QByteArray> fileBuffer, const QSize maxSize) {
 
 	try {
-		loader->loadGeneral(fileInfo, fileBuffer, true);
+		loader->loadGeneral(fileInfo, fileBuffer, true, false, maxSize);
 	} catch(...) {}
 
 	return loader;
@@ -344,6 +370,15 @@ bool DkImageContainer::isEdited() const {
 	return edited;
 }
 
+/**
+ * Returns true if the image was decoded at a reduced (screen) resolution.
+ * @return bool true if the full resolution image is not loaded yet.
+ **/ 
+bool DkImageContainer::isDownscaled() const {
+
+	return loader && loader->isDownscaled();
+}
+
 bool DkImageContainer::isSelected() const {
 
 	return selected;
@@ -367,12 +402,90 @@ QSharedPointer<DkZipContainer> DkImageContainer::getZipData() {
 	return zipData;
 }
 #endif
-#ifdef WIN32
-std::wstring DkImageContainer::getFileNameWStr() const {
-	
-	return fileNameStr;
+/**
+ * Computes the sort keys that are needed for the given sort mode.
+ * Sort keys that are not cached yet (e.g. file dates) are computed lazily
+ * if they are needed. Call this function for all containers before
+ * sorting them in parallel.
+ * @param sortMode the sort mode (DkSettings::sortMode)
+ **/ 
+void DkImageContainer::prepareSortKey(int sortMode) {
+
+	if (sortMode == DkSettings::sort_date_created || sortMode == DkSettings::sort_date_modified)
+		cacheSortDates();
+	else if (sortMode == DkSettings::sort_random)
+		sortRandom = randomSortKey();
+}
+
+/**
+ * Returns a random number.
+ * Sorting might run in worker threads and qrand() is seeded per thread,
+ * so each thread is seeded the first time it creates a random key.
+ * @return int a random sort key.
+ **/ 
+int DkImageContainer::randomSortKey() {
+
+	static QThreadStorage<bool*> seeded;
+
+	if (!seeded.hasLocalData()) {
+		qsrand((uint)QDateTime::currentMSecsSinceEpoch() ^ (uint)(quintptr)QThread::currentThreadId());
+		seeded.setLocalData(new bool(true));
+	}
+
+	return qrand();
+}
+
+void DkImageContainer::cacheSortDates() const {
+
+	if (sortDatesCached)
+		return;
+
+	sortDateCreated = fileInfo.created().toMSecsSinceEpoch();
+	sortDateModified = fileInfo.lastModified().toMSecsSinceEpoch();
+	sortDatesCached = true;
+}
+
+/**
+ * Compares two containers (ascending).
+ * Only cached sort keys are compared. Hence, a file is
+ * neither parsed nor stat-ed if this function is called.
+ * Containers with equal dates are sorted by their file names.
+ * @param o the container to compare with
+ * @param sortMode the sort mode (DkSettings::sortMode)
+ * @return bool true if this container is less than o.
+ **/ 
+bool DkImageContainer::lessThan(const DkImageContainer& o, int sortMode) const {
+
+	switch (sortMode) {
+
+	case DkSettings::sort_date_created:
+		cacheSortDates();
+		o.cacheSortDates();
+		if (sortDateCreated != o.sortDateCreated)
+			return sortDateCreated < o.sortDateCreated;
+		break;
+
+	case DkSettings::sort_date_modified:
+		cacheSortDates();
+		o.cacheSortDates();
+		if (sortDateModified != o.sortDateModified)
+			return sortDateModified < o.sortDateModified;
+		break;
+
+	case DkSettings::sort_random:
+		if (sortRandom != o.sortRandom)
+			return sortRandom < o.sortRandom;
+		break;
+	}
+
+	int cmp = sortName.compare(o.sortName);
+
+	// e.g. img01.png vs img1.png
+	if (cmp == 0)
+		return fileInfo.fileName() < o.fileInfo.fileName();
+
+	return cmp < 0;
 }
-#endif
 
 bool imageContainerLessThanPtr(const QSharedPointer<DkImageContainer> l, const QSharedPointer<DkImageContainer> r) {
 
@@ -384,83 +497,290 @@ bool imageContainerLessThanPtr(const QSharedPointer<DkImageContainer> l, const Q
 
 bool imageContainerLessThan(const DkImageContainer& l, const DkImageContainer& r) {
 
-	switch(DkSettings::global.sortMode) {
-
-	case DkSettings::sort_filename:
-#ifdef WIN32
-		// not beautiful if you take a look at the code, but:
-		// time on Win8 with compFilename:
-		//		WinAPI, indexed ( 73872 ) files in:  " 92 ms"
-		//		[DkImageLoader]  73872  containers created in  " 1.825 sec"
-		//		[DkImageLoader] after sorting:  " 52.246 sec"
-		// time on Win8 with direct wCompLogic:
-		//		WinAPI, indexed ( 73872 ) files in:  " 63 ms"
-		//		[DkImageLoader]  73872  containers created in  " 1.203 sec"
-		//		[DkImageLoader] after sorting:  " 14.407 sec"
-		if (DkSettings::global.sortDir == DkSettings::sort_ascending)
-			return DkUtils::wCompLogic(l.getFileNameWStr(), r.getFileNameWStr());
-		else
-			return !DkUtils::wCompLogic(l.getFileNameWStr(), r.getFileNameWStr());
-		break;
-#else
-		if (DkSettings::global.sortDir == DkSettings::sort_ascending)
-			return DkUtils::compFilename(l.file(), r.file());
-		else
-			return DkUtils::compFilenameInv(l.file(), r.file());
-		break;
+	// not beautiful if you take a look at the code, but:
+	// time on Win8 with compFilename:
+	//		WinAPI, indexed ( 73872 ) files in:  " 92 ms"
+	//		[DkImageLoader]  73872  containers created in  " 1.825 sec"
+	//		[DkImageLoader] after sorting:  " 52.246 sec"
+	// time on Win8 with direct wCompLogic:
+	//		WinAPI, indexed ( 73872 ) files in:  " 63 ms"
+	//		[DkImageLoader]  73872  containers created in  " 1.203 sec"
+	//		[DkImageLoader] after sorting:  " 14.407 sec"
+	// now we compare the sort keys which are computed once per file
+	if (DkSettings::global.sortDir == DkSettings::sort_descending)
+		return r.lessThan(l, DkSettings::global.sortMode);
+	
+	return l.lessThan(r, DkSettings::global.sortMode);
+}
+
+// DkImageContainerLessThan --------------------------------------------------------------------
+DkImageContainerLessThan::DkImageContainerLessThan(int sortMode, int sortDir) {
+
+	this->sortMode = sortMode;
+	this->sortDir = sortDir;
+}
+
+bool DkImageContainerLessThan::operator()(const QSharedPointer<DkImageContainerT>& l, const QSharedPointer<DkImageContainerT>& r) const {
+
+	if (!l || !r)
+		return false;
+
+	if (sortDir == DkSettings::sort_descending)
+		return r->lessThan(*l, sortMode);
+
+	return l->lessThan(*r, sortMode);
+}
+
+// DkFileWatcher --------------------------------------------------------------------
+DkFileWatcher::DkFileWatcher(QObject* parent) : QObject(parent) {
+
+	inotifyFd = -1;
+	notifier = 0;
+	fallbackWatcher = 0;
+
+#ifdef Q_OS_LINUX
+	inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if (inotifyFd != -1) {
+		notifier = new QSocketNotifier(inotifyFd, QSocketNotifier::Read, this);
+		connect(notifier, SIGNAL(activated(int)), this, SLOT(readEvents()));
+	}
+	else
+		qWarning() << "[DkFileWatcher] inotify is not available: " << strerror(errno);
 #endif
 
-	case DkSettings::sort_date_created:
-		if (DkSettings::global.sortDir == DkSettings::sort_ascending)
-			return DkUtils::compDateCreated(l.file(), r.file());
-		else
-			return DkUtils::compDateCreatedInv(l.file(), r.file());
-		break;
+	if (inotifyFd == -1) {
+		fallbackWatcher = new QFileSystemWatcher(this);
+		connect(fallbackWatcher, SIGNAL(directoryChanged(const QString&)), this, SIGNAL(directoryChangedSignal(const QString&)));
+	}
+}
 
-	case DkSettings::sort_date_modified:
-		if (DkSettings::global.sortDir == DkSettings::sort_ascending)
-			return DkUtils::compDateModified(l.file(), r.file());
-		else
-			return DkUtils::compDateModifiedInv(l.file(), r.file());
+DkFileWatcher::~DkFileWatcher() {
 
-	case DkSettings::sort_random:
-		return DkUtils::compRandom(l.file(), r.file());
+#ifdef Q_OS_LINUX
+	if (inotifyFd != -1) {
+		delete notifier;
+		notifier = 0;
+		::close(inotifyFd);	// removes all watches
+	}
+#endif
+}
+
+/**
+ * Returns the file watcher shared by all containers and loaders.
+ * The watcher is a child of the application since its socket notifier
+ * needs the event loop.
+ * @return DkFileWatcher& the file watcher.
+ **/ 
+DkFileWatcher& DkFileWatcher::instance() {
+
+	static QPointer<DkFileWatcher> inst;
+	if (!inst)
+		inst = new DkFileWatcher(QCoreApplication::instance());
+	return *inst;
+}
+
+/**
+ * Returns true if file events are reported.
+ * If false, just directoryChangedSignal is emitted and
+ * single files need to be polled.
+ * @return bool true if inotify is used.
+ **/ 
+bool DkFileWatcher::isNative() const {
+
+	return inotifyFd != -1;
+}
+
+/**
+ * Starts watching a directory.
+ * Each call must be balanced by a call to unwatchDir.
+ * @param dirPath the directory
+ **/ 
+void DkFileWatcher::watchDir(const QString& dirPath) {
 
-	default:
-		// filename
-		return DkUtils::compFilename(l.file(), r.file());
+	if (dirPath.isEmpty())
+		return;
+
+	QString cPath = QDir(dirPath).absolutePath();
+	int count = watchCount.value(cPath, 0);
+	watchCount.insert(cPath, count+1);
+
+	// already watched
+	if (count > 0)
+		return;
+
+#ifdef Q_OS_LINUX
+	if (inotifyFd != -1) {
+
+		int wd = inotify_add_watch(inotifyFd, QFile::encodeName(cPath).constData(), 
+			IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF);
+
+		if (wd == -1) {
+			qWarning() << "[DkFileWatcher] cannot watch" << cPath << ":" << strerror(errno);
+			return;
+		}
+
+		watchDescriptors.insert(cPath, wd);
+		watchPaths.insert(wd, cPath);
+		return;
 	}
-	
+#endif
+
+	fallbackWatcher->addPath(cPath);
+}
+
+/**
+ * Stops watching a directory.
+ * The directory is released if no one else watches it.
+ * @param dirPath the directory
+ **/ 
+void DkFileWatcher::unwatchDir(const QString& dirPath) {
+
+	if (dirPath.isEmpty())
+		return;
+
+	QString cPath = QDir(dirPath).absolutePath();
+	int count = watchCount.value(cPath, 0);
+
+	if (count > 1) {
+		watchCount.insert(cPath, count-1);
+		return;
+	}
+	else if (count == 0)
+		return;
+
+	watchCount.remove(cPath);
+
+#ifdef Q_OS_LINUX
+	if (inotifyFd != -1) {
+
+		int wd = watchDescriptors.value(cPath, -1);
+
+		if (wd != -1) {
+			inotify_rm_watch(inotifyFd, wd);
+			watchDescriptors.remove(cPath);
+			watchPaths.remove(wd);
+		}
+		return;
+	}
+#endif
+
+	fallbackWatcher->removePath(cPath);
 }
 
+/**
+ * Reads all pending inotify events and emits them as file events.
+ **/ 
+void DkFileWatcher::readEvents() {
+
+#ifdef Q_OS_LINUX
+	// the buffer must be aligned for inotify_event (see man 7 inotify)
+	char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+
+	for (;;) {
+
+		ssize_t len = ::read(inotifyFd, buffer, sizeof(buffer));
+
+		// EAGAIN - all events are read
+		if (len <= 0)
+			break;
+
+		for (char* ptr = buffer; ptr < buffer + len; ) {
+
+			const struct inotify_event* e = reinterpret_cast<const struct inotify_event*>(ptr);
+			ptr += sizeof(struct inotify_event) + e->len;
+
+			// events were dropped - everyone needs to update
+			if (e->mask & IN_Q_OVERFLOW) {
+				QList<QString> dirs = watchPaths.values();
+				for (int idx = 0; idx < dirs.size(); idx++)
+					emit directoryChangedSignal(dirs.at(idx));
+				continue;
+			}
+
+			QString dirPath = watchPaths.value(e->wd);
+
+			if (dirPath.isEmpty())
+				continue;
+
+			// the kernel removed the watch (e.g. the directory was deleted)
+			if (e->mask & IN_IGNORED) {
+				watchPaths.remove(e->wd);
+				watchDescriptors.remove(dirPath);
+				continue;
+			}
+
+			if (e->mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+				emit directoryChangedSignal(dirPath);
+				continue;
+			}
+
+			if (e->mask & IN_ISDIR || e->len == 0)
+				continue;
+
+			QString filePath = dirPath + "/" + QFile::decodeName(e->name);
+
+			if (e->mask & (IN_CREATE | IN_MOVED_TO))
+				emit fileChangedSignal(filePath, file_created);
+			else if (e->mask & IN_CLOSE_WRITE)
+				emit fileChangedSignal(filePath, file_modified);
+			else if (e->mask & (IN_DELETE | IN_MOVED_FROM))
+				emit fileChangedSignal(filePath, file_deleted);
+		}
+	}
+#endif
+}
+
+// DkImageContainerAsync --------------------------------------------------------------------
+/**
+ * The asynchronous machinery of a DkImageContainerT.
+ * It is created by DkImageContainerT::activate() for images that are used.
+ **/ 
+class DkImageContainerAsync : public QObject {
+
+public:
+	DkImageContainerAsync(QObject* parent = 0) : QObject(parent) {
+
+		// our file watcher (polling is just used if DkFileWatcher is not native)
+		fileUpdateTimer.setSingleShot(false);
+		fileUpdateTimer.setInterval(500);
+	}
+
+	QFutureWatcher<QSharedPointer<QByteArray> > bufferWatcher;
+	QFutureWatcher<QSharedPointer<DkBasicLoader> > imageWatcher;
+	QFutureWatcher<QSharedPointer<DkBasicLoader> > fullSizeWatcher;
+	QFutureWatcher<QFileInfo> saveImageWatcher;
+
+	QSharedPointer<FileDownloader> fileDownloader;
+	QTimer fileUpdateTimer;		// polls the file if no native file watcher is available
+};
+
 // DkImageContainerT --------------------------------------------------------------------
 DkImageContainerT::DkImageContainerT(const QFileInfo& file) : DkImageContainer(file) {
 	
+	async = 0;
 	fetchingImage = false;
 	fetchingBuffer = false;
-	
-	// our file watcher
-	fileUpdateTimer.setSingleShot(false);
-	fileUpdateTimer.setInterval(500);
+	fetchingFullSize = false;
 	waitForUpdate = false;
 	downloaded = false;
-
-	connect(&fileUpdateTimer, SIGNAL(timeout()), this, SLOT(checkForFileUpdates()), Qt::UniqueConnection);
-	//connect(&metaDataWatcher, SIGNAL(finished()), this, SLOT(metaDataLoaded()));
 }
 
 DkImageContainerT::~DkImageContainerT() {
 	
-	bufferWatcher.blockSignals(true);
-	bufferWatcher.cancel();
-	imageWatcher.blockSignals(true);
-	imageWatcher.cancel();
+	stopFileWatcher();
+
+	if (async) {
+		async->bufferWatcher.blockSignals(true);
+		async->bufferWatcher.cancel();
+		async->imageWatcher.blockSignals(true);
+		async->imageWatcher.cancel();
+		async->fullSizeWatcher.blockSignals(true);
+		async->fullSizeWatcher.cancel();
+		async->saveImageWatcher.blockSignals(true);
+	}
 
 	saveMetaData();
-
-	// we have to wait here
-	saveMetaDataWatcher.blockSignals(true);
-	saveImageWatcher.blockSignals(true);
 }
 
 void DkImageContainerT::clear() {
@@ -471,6 +791,45 @@ void DkImageContainerT::clear() {
 		return;
 
 	DkImageContainer::clear();
+	deactivate();
+}
+
+/**
+ * Creates the threads, timers and downloader of this image.
+ * @return DkImageContainerAsync* the asynchronous machinery.
+ **/ 
+DkImageContainerAsync* DkImageContainerT::activate() {
+
+	if (!async) {
+		async = new DkImageContainerAsync(this);
+		connect(&async->fileUpdateTimer, SIGNAL(timeout()), this, SLOT(checkForFileUpdates()), Qt::UniqueConnection);
+	}
+
+	return async;
+}
+
+/**
+ * Releases the threads, timers and downloader if the image is not used anymore.
+ * Images that are displayed, loaded or saved keep them.
+ **/ 
+void DkImageContainerT::deactivate() {
+
+	if (!async || selected || fetchingImage || fetchingBuffer || fetchingFullSize || 
+		async->fileDownloader || async->saveImageWatcher.isRunning() || async->fileUpdateTimer.isActive())
+		return;
+
+	// we might be called by one of the watchers
+	async->deleteLater();
+	async = 0;
+}
+
+/**
+ * Returns true if the image's threads, timers or downloader exist.
+ * @return bool true if the image is loaded, saved or watched.
+ **/ 
+bool DkImageContainerT::isActive() const {
+
+	return async != 0;
 }
 
 void DkImageContainerT::checkForFileUpdates() {
@@ -499,7 +858,7 @@ void DkImageContainerT::checkForFileUpdates() {
 #endif
 
 	if (changed) {
-		fileUpdateTimer.stop();
+		stopFileWatcher();
 		if (DkSettings::global.askToSaveDeletedFiles) {
 			edited = changed;
 			emit fileLoadedSignal(true);
@@ -520,6 +879,71 @@ void DkImageContainerT::checkForFileUpdates() {
 
 }
 
+/**
+ * Receives file events of the shared file watcher.
+ * @param filePath the file that changed
+ * @param event the DkFileWatcher event
+ **/ 
+void DkImageContainerT::fileChanged(const QString& filePath, int event) {
+
+	if (filePath != file().absoluteFilePath())
+		return;
+
+	// the modification date might not change if the file is written twice within a second
+	if (event != DkFileWatcher::file_deleted)
+		waitForUpdate = true;
+
+	checkForFileUpdates();
+}
+
+/**
+ * Starts watching the file for changes.
+ * The directory is registered with DkFileWatcher if it reports file events,
+ * otherwise the file is polled.
+ **/ 
+void DkImageContainerT::startFileWatcher() {
+
+	DkFileWatcher& watcher = DkFileWatcher::instance();
+	bool poll = !watcher.isNative() || !exists();
+
+#ifdef WITH_QUAZIP
+	poll |= isFromZip();	// the archive changes - not the image
+#endif
+
+	if (poll) {
+		stopFileWatcher();
+		activate()->fileUpdateTimer.start();
+		return;
+	}
+
+	QString dirPath = file().absolutePath();
+
+	if (dirPath == watchedDir)
+		return;
+
+	stopFileWatcher();
+	watchedDir = dirPath;
+	watcher.watchDir(watchedDir);
+	connect(&watcher, SIGNAL(fileChangedSignal(const QString&, int)), this, SLOT(fileChanged(const QString&, int)), Qt::UniqueConnection);
+}
+
+/**
+ * Stops watching the file.
+ **/ 
+void DkImageContainerT::stopFileWatcher() {
+
+	if (async)
+		async->fileUpdateTimer.stop();
+
+	if (watchedDir.isEmpty())
+		return;
+
+	DkFileWatcher& watcher = DkFileWatcher::instance();
+	disconnect(&watcher, SIGNAL(fileChangedSignal(const QString&, int)), this, SLOT(fileChanged(const QString&, int)));
+	watcher.unwatchDir(watchedDir);
+	watchedDir.clear();
+}
+
 bool DkImageContainerT::loadImageThreaded(bool force) {
 
 #ifdef WITH_QUAZIP
@@ -571,7 +995,7 @@ void DkImageContainerT::fetchFile() {
 		return;
 	}
 	if (fetchingImage)
-		imageWatcher.waitForFinished();
+		async->imageWatcher.waitForFinished();
 	// I think we missed to return here
 	if (fetchingBuffer)
 		return;
@@ -583,9 +1007,10 @@ void DkImageContainerT::fetchFile() {
 	}
 
 	fetchingBuffer = true;	// saves the threaded call
-	connect(&bufferWatcher, SIGNAL(finished()), this, SLOT(bufferLoaded()), Qt::UniqueConnection);
+	activate();
+	connect(&async->bufferWatcher, SIGNAL(finished()), this, SLOT(bufferLoaded()), Qt::UniqueConnection);
 
-	bufferWatcher.setFuture(QtConcurrent::run(this, 
+	async->bufferWatcher.setFuture(QtConcurrent::run(this, 
 		&nmc::DkImageContainerT::loadFileToBuffer, file()));
 }
 
@@ -593,8 +1018,8 @@ void DkImageContainerT::bufferLoaded() {
 
 	fetchingBuffer = false;
 
-	if (!bufferWatcher.isCanceled())
-		fileBuffer = bufferWatcher.result();
+	if (async && !async->bufferWatcher.isCanceled())
+		fileBuffer = async->bufferWatcher.result();
 
 	if (getLoadState() == loading)
 		fetchImage();
@@ -608,7 +1033,7 @@ void DkImageContainerT::bufferLoaded() {
 void DkImageContainerT::fetchImage() {
 
 	if (fetchingBuffer)
-		bufferWatcher.waitForFinished();
+		async->bufferWatcher.waitForFinished();
 
 	if (fetchingImage) {
 		loadState = loading;
@@ -623,10 +1048,106 @@ void DkImageContainerT::fetchImage() {
 	qDebug() << "fetching: " << file().absoluteFilePath();
 	fetchingImage = true;
 
-	connect(&imageWatcher, SIGNAL(finished()), this, SLOT(imageLoaded()), Qt::UniqueConnection);
+	// decode large images at screen resolution - the full image is loaded if the user zooms in
+	QSize maxSize = DkSettings::resources.loadReducedSize ? maxScreenSize() : QSize();
+
+	activate();
+	connect(&async->imageWatcher, SIGNAL(finished()), this, SLOT(imageLoaded()), Qt::UniqueConnection);
 
-	imageWatcher.setFuture(QtConcurrent::run(this, 
-		&nmc::DkImageContainerT::loadImageIntern, file(), loader, fileBuffer));
+	async->imageWatcher.setFuture(QtConcurrent::run(this, 
+		&nmc::DkImageContainerT::loadImageIntern, file(), loader, fileBuffer, maxSize));
+}
+
+/**
+ * Loads the full resolution image if the current image was decoded at a reduced resolution.
+ * The image is decoded with a new loader so that the current image can be displayed meanwhile.
+ * fullSizeLoadedSignal is emitted when the image is replaced.
+ * @return bool true if the full resolution image is being loaded.
+ **/ 
+bool DkImageContainerT::loadFullSizeThreaded() {
+
+	if (!isDownscaled() || getLoadState() != loaded)
+		return false;
+
+	if (fetchingFullSize)
+		return true;
+
+	fetchingFullSize = true;
+	activate();
+	connect(&async->fullSizeWatcher, SIGNAL(finished()), this, SLOT(fullSizeLoaded()), Qt::UniqueConnection);
+
+	async->fullSizeWatcher.setFuture(QtConcurrent::run(this, 
+		&nmc::DkImageContainerT::loadImageIntern, file(), QSharedPointer<DkBasicLoader>(new DkBasicLoader()), fileBuffer, QSize()));
+
+	return true;
+}
+
+/**
+ * Loads the full resolution image (blocking).
+ * Use this if the image pixels are needed (e.g. for editing).
+ * @return bool true if the downscaled image was replaced.
+ **/ 
+bool DkImageContainerT::loadFullSize() {
+
+	if (!isDownscaled())
+		return false;
+
+	QSharedPointer<DkBasicLoader> fullLoader;
+
+	if (fetchingFullSize) {
+		async->fullSizeWatcher.waitForFinished();
+		fullLoader = async->fullSizeWatcher.result();
+		fetchingFullSize = false;	// fullSizeLoaded() ignores the result now
+	}
+	else
+		fullLoader = loadImageIntern(file(), QSharedPointer<DkBasicLoader>(new DkBasicLoader()), fileBuffer);
+
+	return setFullSizeImage(fullLoader);
+}
+
+void DkImageContainerT::fullSizeLoaded() {
+
+	if (!fetchingFullSize || !async)
+		return;
+
+	fetchingFullSize = false;
+	setFullSizeImage(async->fullSizeWatcher.result());
+}
+
+bool DkImageContainerT::setFullSizeImage(QSharedPointer<DkBasicLoader> fullLoader) {
+
+	// the image was released or edited meanwhile
+	if (getLoadState() != loaded || !isDownscaled() || !fullLoader || !fullLoader->hasImage()) {
+		emit fullSizeLoadedSignal(false);
+		return false;
+	}
+
+	// keep the loader (and its meta data) - just replace the image
+	getLoader()->setImage(fullLoader->image(), file());
+	
+	emit fullSizeLoadedSignal(true);
+	return true;
+}
+
+/**
+ * Returns the size of the largest screen.
+ * The size is square so that rotated images fit too.
+ * @return QSize the maximal size images are decoded at.
+ **/ 
+QSize DkImageContainerT::maxScreenSize() {
+
+	QDesktopWidget* dw = QApplication::desktop();
+
+	if (!dw)
+		return QSize();
+
+	int maxSide = 0;
+	for (int idx = 0; idx < dw->screenCount(); idx++) {
+		QRect sr = dw->screenGeometry(idx);
+		maxSide = qMax(maxSide, qMax(sr.width(), sr.height()));
+	}
+
+	return maxSide > 0 ? QSize(maxSide, maxSide) : QSize();
 }
 
 void DkImageContainerT::imageLoaded() {
@@ -640,7 +1161,8 @@ void DkImageContainerT::imageLoaded() {
 	}
 
 	// deliver image
-	loader = imageWatcher.result();
+	if (async)
+		loader = async->imageWatcher.result();
 
 	loadingFinished();
 }
@@ -656,7 +1178,7 @@ void DkImageContainerT::loadingFinished() {
 	}
 
 	if (!getLoader()->hasImage()) {
-		fileUpdateTimer.stop();
+		stopFileWatcher();
 		edited = false;
 		QString msg = tr("Sorry, I could not load: %1").arg(file().fileName());
 		emit showInfoSignal(msg);
@@ -678,23 +1200,26 @@ void DkImageContainerT::loadingFinished() {
 
 void DkImageContainerT::downloadFile(const QUrl& url) {
 
-	if (!fileDownloader) {
-		fileDownloader = QSharedPointer<FileDownloader>(new FileDownloader(url, this));
-		connect(fileDownloader.data(), SIGNAL(downloaded()), this, SLOT(fileDownloaded()), Qt::UniqueConnection);
+	activate();
+
+	if (!async->fileDownloader) {
+		async->fileDownloader = QSharedPointer<FileDownloader>(new FileDownloader(url, this));
+		connect(async->fileDownloader.data(), SIGNAL(downloaded()), this, SLOT(fileDownloaded()), Qt::UniqueConnection);
 		qDebug() << "trying to download: " << url;
 	}
 	else
-		fileDownloader->downloadFile(url);
+		async->fileDownloader->downloadFile(url);
 }
 
 void DkImageContainerT::fileDownloaded() {
 
-	if (!fileDownloader) {
+	if (!async || !async->fileDownloader) {
 		qDebug() << "empty fileDownloader, where it should not be";
 		emit fileLoadedSignal(false);
 		return;
 	}
 
+	QSharedPointer<FileDownloader> fileDownloader = async->fileDownloader;
 	fileBuffer = fileDownloader->downloadedData();
 
 	if (!fileBuffer || fileBuffer->isEmpty()) {
@@ -726,18 +1251,22 @@ void DkImageContainerT::receiveUpdates(QObject* obj, bool connectSignals /* = tr
 		connect(this, SIGNAL(fileLoadedSignal(bool)), obj, SLOT(imageLoaded(bool)), Qt::UniqueConnection);
 		connect(this, SIGNAL(showInfoSignal(QString, int, int)), obj, SIGNAL(showInfoSignal(QString, int, int)), Qt::UniqueConnection);
 		connect(this, SIGNAL(fileSavedSignal(QFileInfo, bool)), obj, SLOT(imageSaved(QFileInfo, bool)), Qt::UniqueConnection);
-		fileUpdateTimer.start();
+		connect(this, SIGNAL(fullSizeLoadedSignal(bool)), obj, SLOT(fullSizeLoaded(bool)), Qt::UniqueConnection);
+		startFileWatcher();
 	}
 	else if (!connectSignals) {
 		disconnect(this, SIGNAL(errorDialogSignal(const QString&)), obj, SLOT(errorDialog(const QString&)));
 		disconnect(this, SIGNAL(fileLoadedSignal(bool)), obj, SLOT(imageLoaded(bool)));
 		disconnect(this, SIGNAL(showInfoSignal(QString, int, int)), obj, SIGNAL(showInfoSignal(QString, int, int)));
 		disconnect(this, SIGNAL(fileSavedSignal(QFileInfo, bool)), obj, SLOT(imageSaved(QFileInfo, bool)));
-		fileUpdateTimer.stop();
+		disconnect(this, SIGNAL(fullSizeLoadedSignal(bool)), obj, SLOT(fullSizeLoaded(bool)));
+		stopFileWatcher();
 	}
 
 	selected = connectSignals;
 
+	if (!selected)
+		deactivate();
 }
 
 void DkImageContainerT::saveMetaDataThreaded() {
@@ -745,7 +1274,7 @@ void DkImageContainerT::saveMetaDataThreaded() {
 	if (!exists() || (getLoader()->getMetaData() && !getLoader()->getMetaData()->isDirty()))
 		return;
 
-	fileUpdateTimer.stop();
+	stopFileWatcher();
 	QFuture<void> future = QtConcurrent::run(this, 
 		&nmc::DkImageContainerT::saveMetaDataIntern, file(), getLoader(), getFileBuffer());
 
@@ -753,13 +1282,15 @@ void DkImageContainerT::saveMetaDataThreaded() {
 
 bool DkImageContainerT::saveImageThreaded(const QFileInfo fileInfo, int compression /* = -1 */) {
 
+	loadFullSize();	// do not save the screen sized image
 	return saveImageThreaded(fileInfo, getLoader()->image(), compression);
 }
 
 
 bool DkImageContainerT::saveImageThreaded(const QFileInfo fileInfo, const QImage saveImg, int compression /* = -1 */) {
 
-	saveImageWatcher.waitForFinished();
+	activate();
+	async->saveImageWatcher.waitForFinished();
 
 	if (saveImg.isNull()) {
 		QString msg = tr("I can't save an empty file, sorry...\n");
@@ -779,10 +1310,10 @@ bool DkImageContainerT::saveImageThreaded(const QFileInfo fileInfo, const QImage
 
 	qDebug() << "attempting to save: " << fileInfo.absoluteFilePath();
 
-	fileUpdateTimer.stop();
-	connect(&saveImageWatcher, SIGNAL(finished()), this, SLOT(savingFinished()), Qt::UniqueConnection);
+	stopFileWatcher();
+	connect(&async->saveImageWatcher, SIGNAL(finished()), this, SLOT(savingFinished()), Qt::UniqueConnection);
 
-	saveImageWatcher.setFuture(QtConcurrent::run(this, 
+	async->saveImageWatcher.setFuture(QtConcurrent::run(this, 
 		&nmc::DkImageContainerT::saveImageIntern, fileInfo, loader, saveImg, compression));
 
 	return true;
@@ -790,7 +1321,10 @@ bool DkImageContainerT::saveImageThreaded(const QFileInfo fileInfo, const QImage
 
 void DkImageContainerT::savingFinished() {
 
-	QFileInfo saveFile = saveImageWatcher.result();
+	if (!async)
+		return;
+
+	QFileInfo saveFile = async->saveImageWatcher.result();
 	saveFile.refresh();
 	qDebug() << "save file: " << saveFile.absoluteFilePath();
 	
@@ -807,7 +1341,7 @@ void DkImageContainerT::savingFinished() {
 		downloaded = false;
 		if (selected) {
 			loadImageThreaded(true);	// force a reload
-			fileUpdateTimer.start();
+			startFileWatcher();
 		}
 		emit fileSavedSignal(saveFile);
 	}
@@ -818,9 +1352,9 @@ QSharedPointer<QByteArray> DkImageContainerT::loadFileToBuffer(const QFileInfo f
 	return DkImageContainer::loadFileToBuffer(fileInfo);
 }
 
-QSharedPointer<DkBasicLoader> DkImageContainerT::loadImageIntern(const QFileInfo fileInfo, QSharedPointer<DkBasicLoader> loader, const QSharedPointer<QByteArray> fileBuffer) {
+QSharedPointer<DkBasicLoader> DkImageContainerT::loadImageIntern(const QFileInfo fileInfo, QSharedPointer<DkBasicLoader> loader, const QSharedPointer<QByteArray> fileBuffer, const QSize maxSize) {
 
-	return DkImageContainer::loadImageIntern(fileInfo, loader, fileBuffer);
+	return DkImageContainer::loadImageIntern(fileInfo, loader, fileBuffer, maxSize);
 }
 
 QFileInfo DkImageContainerT::saveImageIntern(const QFileInfo fileInfo, QSharedPointer<DkBasicLoader> loader, QImage saveImg, int compression) {
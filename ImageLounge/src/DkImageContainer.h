@@ -32,6 +32,8 @@
 #include <QTimer>
 #include <QFileInfo>
 #include <QSharedPointer>
+#include <QHash>
+#include <QPointer>
 #pragma warning(pop)		// no warnings from includes - end
 
 #pragma warning(disable: 4251)	// TODO: remove
@@ -48,6 +50,9 @@
 
 #include "DkThumbs.h"
 
+class QSocketNotifier;
+class QFileSystemWatcher;
+
 namespace nmc {
 
 // nomacs defines
@@ -55,6 +60,7 @@ class DkBasicLoader;
 class DkMetaDataT;
 class DkZipContainer;
 class FileDownloader;
+class DkImageContainerAsync;
 
 class DllExport DkImageContainer {
 
@@ -83,6 +89,7 @@ public:
 	bool isFromZip();
 	bool isEdited() const;
 	bool isSelected() const;
+	bool isDownscaled() const;
 	void setEdited(bool edited);
 	int getPageIdx() const;
 	QString getTitleAttribute() const;
@@ -95,14 +102,14 @@ public:
 #ifdef WITH_QUAZIP
 	QSharedPointer<DkZipContainer> getZipData();
 #endif
-#ifdef WIN32
-	std::wstring getFileNameWStr() const;
-#endif
+	void prepareSortKey(int sortMode);
+	bool lessThan(const DkImageContainer& o, int sortMode) const;
 
 	bool exists();
 	bool setPageIdx(int skipIdx);
 
 	QSharedPointer<QByteArray> loadFileToBuffer(const QFileInfo fileInfo);
+	bool readFile();
 	bool loadImage();
 	void setImage(const QImage& img);
 	void setImage(const QImage& img, const QFileInfo& fileInfo);
@@ -118,19 +125,25 @@ protected:
 #ifdef WITH_QUAZIP	
 	QSharedPointer<DkZipContainer> zipData;
 #endif
-#ifdef WIN32
-	std::wstring fileNameStr;	// speeds up sorting of filenames on windows
-#endif
+
+	// sort keys - they are computed once so that sorting does not parse file names or touch the file system
+	QString sortName;
+	mutable qint64 sortDateCreated;
+	mutable qint64 sortDateModified;
+	mutable bool sortDatesCached;
+	int sortRandom;
 
 	int loadState;
 	bool edited;
 	bool selected;
 
-	QSharedPointer<DkBasicLoader> loadImageIntern(const QFileInfo fileInfo, QSharedPointer<DkBasicLoader> loader, const QSharedPointer<QByteArray> fileBuffer);
+	QSharedPointer<DkBasicLoader> loadImageIntern(const QFileInfo fileInfo, QSharedPointer<DkBasicLoader> loader, const QSharedPointer<QByteArray> fileBuffer, const QSize maxSize = QSize());
 	void saveMetaDataIntern(const QFileInfo fileInfo, QSharedPointer<DkBasicLoader> loader, QSharedPointer<QByteArray> fileBuffer = QSharedPointer<QByteArray>());
 	QFileInfo saveImageIntern(const QFileInfo fileInfo, QSharedPointer<DkBasicLoader> loader, QImage saveImg, int compression);
 	void init();
 	void setFileInfo(const QFileInfo& fileInfo);
+	void cacheSortDates() const;
+	static int randomSortKey();
 
 private:
 	QFileInfo fileInfo;
@@ -140,6 +153,58 @@ private:
 bool imageContainerLessThan(const DkImageContainer& l, const DkImageContainer& r);
 bool imageContainerLessThanPtr(const QSharedPointer<DkImageContainer> l, const QSharedPointer<DkImageContainer> r);
 
+/**
+ * Watches directories for file changes.
+ * A single instance is shared by all image containers and loaders so
+ * that each directory is watched once, no matter how many objects are interested.
+ * On linux, inotify reports which file was created, modified or deleted.
+ * Other systems fall back to a QFileSystemWatcher which only reports
+ * that a directory changed (see isNative()).
+ **/ 
+class DllExport DkFileWatcher : public QObject {
+	Q_OBJECT
+
+public:
+	enum {
+		file_created = 0,
+		file_modified,
+		file_deleted,
+
+		file_end
+	};
+
+	static DkFileWatcher& instance();
+
+	void watchDir(const QString& dirPath);
+	void unwatchDir(const QString& dirPath);
+	bool isNative() const;
+
+signals:
+	void fileChangedSignal(const QString& filePath, int event);
+	void directoryChangedSignal(const QString& dirPath);
+
+protected slots:
+	void readEvents();
+
+protected:
+	DkFileWatcher(QObject* parent = 0);
+	virtual ~DkFileWatcher();
+
+	QHash<QString, int> watchCount;			// dir path -> number of objects watching it
+	QHash<QString, int> watchDescriptors;	// dir path -> inotify watch descriptor
+	QHash<int, QString> watchPaths;			// inotify watch descriptor -> dir path
+	int inotifyFd;
+	QSocketNotifier* notifier;
+	QFileSystemWatcher* fallbackWatcher;
+};
+
+/**
+ * An image of the current folder.
+ * Folders might contain hundreds of thousands of files, so a container just
+ * keeps the file record (file info, sort keys and load state) until it is used.
+ * The threads, timers and downloader (see DkImageContainerAsync) are created as soon
+ * as the image is loaded, saved or watched and released if it is cleared.
+ **/ 
 class DllExport DkImageContainerT : public QObject, public DkImageContainer {
 	Q_OBJECT
 
@@ -154,10 +219,13 @@ public:
 	void downloadFile(const QUrl& url);
 
 	bool loadImageThreaded(bool force = false);
+	bool loadFullSizeThreaded();
+	bool loadFullSize();
 	bool saveImageThreaded(const QFileInfo fileInfo, const QImage saveImg, int compression = -1);
 	bool saveImageThreaded(const QFileInfo fileInfo, int compression = -1);
 	void saveMetaDataThreaded();
 	bool isFileDownloaded() const;
+	bool isActive() const;
 
 	virtual QSharedPointer<DkBasicLoader> getLoader();
 	virtual QSharedPointer<DkThumbNailT> getThumb();
@@ -168,9 +236,11 @@ signals:
 	void showInfoSignal(QString msg, int time = 3000, int position = 0);
 	void errorDialogSignal(const QString& msg);
 	void thumbLoadedSignal(bool loaded = true);
+	void fullSizeLoadedSignal(bool loaded = true);
 
 public slots:
 	void checkForFileUpdates(); 
+	void fileChanged(const QString& filePath, int event);
 
 protected slots:
 	void bufferLoaded();
@@ -178,30 +248,51 @@ protected slots:
 	void savingFinished();
 	void loadingFinished();
 	void fileDownloaded();
+	void fullSizeLoaded();
 
 protected:
 	void fetchImage();
+	bool setFullSizeImage(QSharedPointer<DkBasicLoader> fullLoader);
+	static QSize maxScreenSize();
+	void startFileWatcher();
+	void stopFileWatcher();
+	DkImageContainerAsync* activate();
+	void deactivate();
 	
 	QSharedPointer<QByteArray> loadFileToBuffer(const QFileInfo fileInfo);
-	QSharedPointer<DkBasicLoader> loadImageIntern(const QFileInfo fileInfo, QSharedPointer<DkBasicLoader> loader, const QSharedPointer<QByteArray> fileBuffer);
+	QSharedPointer<DkBasicLoader> loadImageIntern(const QFileInfo fileInfo, QSharedPointer<DkBasicLoader> loader, const QSharedPointer<QByteArray> fileBuffer, const QSize maxSize = QSize());
 	QFileInfo saveImageIntern(const QFileInfo fileInfo, QSharedPointer<DkBasicLoader> loader, QImage saveImg, int compression);
 	void saveMetaDataIntern(QFileInfo fileInfo, QSharedPointer<DkBasicLoader> loader, QSharedPointer<QByteArray> fileBuffer);
 	
-	QFutureWatcher<QSharedPointer<QByteArray> > bufferWatcher;
-	QFutureWatcher<QSharedPointer<DkBasicLoader> > imageWatcher;
-	QFutureWatcher<QFileInfo> saveImageWatcher;
-	QFutureWatcher<bool> saveMetaDataWatcher;
+	DkImageContainerAsync* async;	// null if the image is not used
 
-	QSharedPointer<FileDownloader> fileDownloader;
 
 	bool fetchingImage;
 	bool fetchingBuffer;
+	bool fetchingFullSize;
 	bool waitForUpdate;
 	bool downloaded;
 
-	QTimer fileUpdateTimer;
+	QString watchedDir;			// the directory registered with DkFileWatcher (empty if not watched)
 	//bool savingImage;
 	//bool savingMetaData;
 };
 
+/**
+ * Compares image containers using their cached sort keys.
+ * The sort mode and direction are fixed when the functor is created.
+ * Call DkImageContainer::prepareSortKey before sorting in parallel.
+ **/ 
+class DllExport DkImageContainerLessThan {
+
+public:
+	DkImageContainerLessThan(int sortMode, int sortDir);
+
+	bool operator()(const QSharedPointer<DkImageContainerT>& l, const QSharedPointer<DkImageContainerT>& r) const;
+
+protected:
+	int sortMode;
+	int sortDir;
+};
+
 };
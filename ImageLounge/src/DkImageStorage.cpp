@@ -34,6 +34,17 @@
 #include <QThread>
 #include <QPixmap>
 #include <QPainter>
+#include <QtConcurrentRun>
+
+// SIMD kernels for down sampling
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define DK_SSE2
+#include <emmintrin.h>
+#endif
+#if defined(__AVX2__)
+#define DK_AVX2
+#include <immintrin.h>
+#endif
 #pragma warning(pop)		// no warnings from includes - end
 
 #if defined(WIN32) && !defined(SOCK_STREAM)
@@ -254,7 +265,7 @@ QImage DkImage::resizeImage(const QImage& img, const QSize& newSize, float facto
 	try {
 		
 		QImage qImg;
-		cv::Mat resizeImage = DkImage::qImage2Mat(img);
+		cv::Mat resizeImage = DkImage::qImage2MatView(img);	// read-only: cv::resize and convertTo write to new buffers
 		
 		if (correctGamma) {
 			resizeImage.convertTo(resizeImage, CV_16U, USHRT_MAX/255.0f);
@@ -276,7 +287,7 @@ QImage DkImage::resizeImage(const QImage& img, const QSize& newSize, float facto
 				resizeImage.convertTo(resizeImage, CV_8U, 255.0f/USHRT_MAX);
 			}
 
-			qImg = DkImage::mat2QImage(resizeImage);
+			qImg = DkImage::mat2QImageView(resizeImage);
 		}
 
 		if (!img.colorTable().isEmpty())
@@ -746,6 +757,71 @@ QImage DkImage::mat2QImage(cv::Mat img) {
 	return qImg;
 }
 
+/**
+ * Returns a Mat header that borrows the QImage's buffer (no pixels are copied).
+ * The view is read-only and only valid as long as img (or one of its shallow copies) is alive and unchanged.
+ * The buffer is shared with other QImages and OpenCV does not know about QImage's implicit sharing:
+ * never write to the view (e.g. in-place OpenCV calls) - clone() it or use qImage2Mat instead.
+ * Formats other than ARGB32 | RGB32 | RGB888 are converted (and thus copied) using qImage2Mat.
+ * @param img the image to be viewed
+ * @return const cv::Mat a Mat that shares the buffer of img
+ **/ 
+const cv::Mat DkImage::qImage2MatView(const QImage& img) {
+
+	// constBits() does not detach the image - so we never copy a shared buffer here
+	if (img.format() == QImage::Format_ARGB32 || img.format() == QImage::Format_RGB32)
+		return cv::Mat(img.height(), img.width(), CV_8UC4, (uchar*)img.constBits(), img.bytesPerLine());
+	else if (img.format() == QImage::Format_RGB888)
+		return cv::Mat(img.height(), img.width(), CV_8UC3, (uchar*)img.constBits(), img.bytesPerLine());
+
+	return qImage2Mat(img);
+}
+
+/**
+ * Converts a cv::Mat to a QImage without copying its pixels.
+ * The QImage adopts the Mat's (reference counted) buffer which is released
+ * if the last copy of the QImage is destroyed.
+ * Mats that do not own their buffer, CV_32F Mats and Qt4 fall back to mat2QImage.
+ * @param img supported formats CV8UC1 | CV_8UC3 | CV_8UC4
+ * @return QImage a QImage that shares the buffer of img
+ **/ 
+QImage DkImage::mat2QImageView(const cv::Mat& img) {
+
+#if QT_VERSION >= 0x050000
+
+#if CV_MAJOR_VERSION >= 3
+	bool ownsBuffer = img.u != 0;
+#else
+	bool ownsBuffer = img.refcount != 0;
+#endif
+
+	QImage::Format format;
+
+	if (img.type() == CV_8UC1)
+		format = QImage::Format_Indexed8;
+	else if (img.type() == CV_8UC3)
+		format = QImage::Format_RGB888;
+	else if (img.type() == CV_8UC4)
+		format = QImage::Format_ARGB32;
+	else
+		ownsBuffer = false;
+
+	if (!ownsBuffer)
+		return mat2QImage(img);
+
+	// the heap allocated header holds a reference to the buffer until the QImage releases it
+	cv::Mat* owner = new cv::Mat(img);
+	return QImage(owner->data, owner->cols, owner->rows, (int)owner->step, format, &DkImage::releaseMat, owner);
+#else
+	return mat2QImage(img);
+#endif
+}
+
+void DkImage::releaseMat(void* mat) {
+
+	delete static_cast<cv::Mat*>(mat);
+}
+
 cv::Mat DkImage::get1DGauss(double sigma) {
 
 	// correct -> checked with matlab reference
@@ -818,15 +894,15 @@ bool DkImage::unsharpMask(QImage& img, float sigma, float weight) {
 #ifdef WITH_OPENCV
 	DkTimer dt;
 	//DkImage::gammaToLinear(img);
-	cv::Mat imgCv = DkImage::qImage2Mat(img);
+	const cv::Mat imgCv = DkImage::qImage2MatView(img);	// read-only: all results are written to imgG
 
 	cv::Mat imgG;
 	cv::Mat gx = cv::getGaussianKernel(qRound(4*sigma+1), sigma);
 	cv::Mat gy = gx.t();
 	cv::sepFilter2D(imgCv, imgG, CV_8U, gx, gy);
 	//cv::GaussianBlur(imgCv, imgG, cv::Size(4*sigma+1, 4*sigma+1), sigma);		// this is awesomely slow
-	cv::addWeighted(imgCv, weight, imgG, 1-weight, 0, imgCv);
-	img = DkImage::mat2QImage(imgCv);
+	cv::addWeighted(imgCv, weight, imgG, 1-weight, 0, imgG);	// imgCv is a view of img - write the result to the blurred buffer
+	img = DkImage::mat2QImageView(imgG);
 
 	qDebug() << "unsharp mask takes: " << dt.getTotal();
 	//DkImage::linearToGamma(img);
@@ -836,6 +912,108 @@ bool DkImage::unsharpMask(QImage& img, float sigma, float weight) {
 	return true;
 }
 
+// 2x2 box filter kernels: each destination pixel is the mean of a 2x2 source block
+// the vertical mean is computed first, then the horizontal mean (both rounded like _mm_avg_epu8)
+static inline uchar avg2(int a, int b) {
+	return (uchar)((a + b + 1) >> 1);
+}
+
+static void downSampleRow32(const uchar* r0, const uchar* r1, uchar* dst, int width) {
+
+	int x = 0;
+
+#ifdef DK_AVX2
+	for (; x + 8 <= width; x += 8) {
+		__m256i v0 = _mm256_avg_epu8(_mm256_loadu_si256((const __m256i*)(r0 + 8*x)), _mm256_loadu_si256((const __m256i*)(r1 + 8*x)));
+		__m256i v1 = _mm256_avg_epu8(_mm256_loadu_si256((const __m256i*)(r0 + 8*x + 32)), _mm256_loadu_si256((const __m256i*)(r1 + 8*x + 32)));
+		__m256 even = _mm256_shuffle_ps(_mm256_castsi256_ps(v0), _mm256_castsi256_ps(v1), _MM_SHUFFLE(2,0,2,0));
+		__m256 odd = _mm256_shuffle_ps(_mm256_castsi256_ps(v0), _mm256_castsi256_ps(v1), _MM_SHUFFLE(3,1,3,1));
+		__m256i res = _mm256_avg_epu8(_mm256_castps_si256(even), _mm256_castps_si256(odd));
+		// shuffle_ps works within 128 bit lanes - restore the pixel order
+		_mm256_storeu_si256((__m256i*)(dst + 4*x), _mm256_permute4x64_epi64(res, _MM_SHUFFLE(3,1,2,0)));
+	}
+#endif
+#ifdef DK_SSE2
+	for (; x + 4 <= width; x += 4) {
+		__m128i v0 = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(r0 + 8*x)), _mm_loadu_si128((const __m128i*)(r1 + 8*x)));
+		__m128i v1 = _mm_avg_epu8(_mm_loadu_si128((const __m128i*)(r0 + 8*x + 16)), _mm_loadu_si128((const __m128i*)(r1 + 8*x + 16)));
+		__m128 even = _mm_shuffle_ps(_mm_castsi128_ps(v0), _mm_castsi128_ps(v1), _MM_SHUFFLE(2,0,2,0));
+		__m128 odd = _mm_shuffle_ps(_mm_castsi128_ps(v0), _mm_castsi128_ps(v1), _MM_SHUFFLE(3,1,3,1));
+		_mm_storeu_si128((__m128i*)(dst + 4*x), _mm_avg_epu8(_mm_castps_si128(even), _mm_castps_si128(odd)));
+	}
+#endif
+
+	for (; x < width; x++) {
+		for (int c = 0; c < 4; c++)
+			dst[4*x+c] = avg2(avg2(r0[8*x+c], r1[8*x+c]), avg2(r0[8*x+4+c], r1[8*x+4+c]));
+	}
+}
+
+static void downSampleRow24(const uchar* r0, const uchar* r1, uchar* dst, int width) {
+
+	for (int x = 0; x < width; x++) {
+		for (int c = 0; c < 3; c++)
+			dst[3*x+c] = avg2(avg2(r0[6*x+c], r1[6*x+c]), avg2(r0[6*x+3+c], r1[6*x+3+c]));
+	}
+}
+
+void DkImage::downSampleRows(const QImage* src, QImage* dst, int startRow, int endRow) {
+
+	bool rgb888 = dst->format() == QImage::Format_RGB888;
+
+	for (int row = startRow; row < endRow; row++) {
+
+		const uchar* r0 = src->constScanLine(2*row);
+		const uchar* r1 = src->constScanLine(2*row+1);
+		uchar* d = dst->scanLine(row);
+
+		if (rgb888)
+			downSampleRow24(r0, r1, d, dst->width());
+		else
+			downSampleRow32(r0, r1, d, dst->width());
+	}
+}
+
+/**
+ * Down samples an image by a factor of two using a 2x2 box filter.
+ * The kernel works directly on the scanlines of 32 bit (SSE2, AVX2 if the compiler 
+ * targets it) and RGB888 images. Other formats are converted first.
+ * Images with alpha are averaged premultiplied (like QImage::scaled does), otherwise
+ * transparent pixels would bleed their color into the edges.
+ * The rows are split into bands which are processed in parallel.
+ * An odd last row or column is dropped.
+ * @param img the image.
+ * @return QImage the image with half its size.
+ **/ 
+QImage DkImage::downSample2x(const QImage& img) {
+
+	QImage src = img;
+
+	if (src.format() != QImage::Format_RGB32 && src.format() != QImage::Format_ARGB32_Premultiplied && 
+		src.format() != QImage::Format_RGB888)
+		src = src.convertToFormat(src.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+
+	QImage dst(src.width()/2, src.height()/2, src.format());
+
+	if (dst.isNull())
+		return dst;
+
+	// a band should have at least 64 rows - otherwise threading does not pay off
+	int numBands = qMax(1, qMin(QThread::idealThreadCount(), dst.height()/64));
+	QVector<QFuture<void> > futures;
+
+	dst.bits();	// detach before we go parallel
+	for (int idx = 1; idx < numBands; idx++)
+		futures.append(QtConcurrent::run(&DkImage::downSampleRows, &src, &dst, idx*dst.height()/numBands, (idx+1)*dst.height()/numBands));
+
+	downSampleRows(&src, &dst, 0, dst.height()/numBands);
+
+	for (int idx = 0; idx < futures.size(); idx++)
+		futures[idx].waitForFinished();
+
+	return dst;
+}
+
 QImage DkImage::createThumb(const QImage& image) {
 
 	if (image.isNull())
@@ -931,12 +1109,18 @@ DkImageStorage::DkImageStorage(QImage img) {
 
 	busy = false;
 	stop = true;
+	tiles.setMaxCost(max_tile_memory*1024);
+	tilesBusy = false;
 }
 
 void DkImageStorage::setImage(QImage img) {
 
 	stop = true;
-	imgs.clear();	// is it save (if the thread is still working?)
+	clearTiles();
+
+	// the compute thread reads img & imgs
+	QMutexLocker locker(&mutex);
+	imgs.clear();
 	this->img = img;
 }
 
@@ -946,6 +1130,7 @@ void DkImageStorage::antiAliasingChanged(bool antiAliasing) {
 
 	if (!antiAliasing) {
 		stop = true;
+		QMutexLocker locker(&mutex);
 		imgs.clear();
 	}
 
@@ -961,9 +1146,12 @@ QImage DkImageStorage::getImageConst() const {
 
 QImage DkImageStorage::getImage(float factor) {
 
-	if (factor >= 0.5f || img.isNull() || !DkSettings::display.antiAliasing)
+	// tiled images do not have full frame sub-images (see drawTiles)
+	if (factor >= 0.5f || img.isNull() || !DkSettings::display.antiAliasing || isTiled())
 		return img;
 
+	QMutexLocker locker(&mutex);
+
 	// check if we have an image similar to that requested
 	for (int idx = 0; idx < imgs.size(); idx++) {
 
@@ -984,23 +1172,23 @@ QImage DkImageStorage::getImage(float factor) {
 
 void DkImageStorage::computeImage() {
 
+	mutex.lock();
 	// obviously, computeImage gets called multiple times in some wired cases...
-	if (!imgs.empty())
+	if (!imgs.empty()) {
+		mutex.unlock();
 		return;
+	}
 
 	DkTimer dt;
 	busy = true;
-	QImage resizedImg = img;
+	QImage resizedImg = img;	// our own copy - setImage might replace img meanwhile
+	mutex.unlock();
 	
 
 	// down sample the image until it is twice times full HD
-	QSize iSize = img.size();
-	while (iSize.width() > 2*1920 && iSize.height() > 2*1920)	// in general we need less than 200 ms for the whole downscaling if we start at 1500 x 1500
-		iSize *= 0.5;
-
-	// for extreme panorama images the Qt scaling crashes (if we have a width > 30000) so we simply 
-	if (qMax(iSize.width(), iSize.height()) < 20000)
-		resizedImg = resizedImg.scaled(iSize, Qt::KeepAspectRatio, Qt::FastTransformation);
+	// the 2x2 box filter reads each pixel once - so this is much faster than scaling the image
+	while (resizedImg.width() > 2*1920 && resizedImg.height() > 2*1920 && !stop)
+		resizedImg = DkImage::downSample2x(resizedImg);
 
 	// it would be pretty strange if we needed more than 30 sub-images
 	for (int idx = 0; idx < 30; idx++) {
@@ -1014,14 +1202,7 @@ void DkImageStorage::computeImage() {
 		// // mapping here introduces bugs
 		//DkImage::gammaToLinear(resizedImg);
 
-#ifdef WITH_OPENCV
-		cv::Mat rImgCv = DkImage::qImage2Mat(resizedImg);
-		cv::Mat tmp;
-		cv::resize(rImgCv, tmp, cv::Size(s.width(), s.height()), 0, 0, CV_INTER_AREA);
-		resizedImg = DkImage::mat2QImage(tmp);
-#else
-		resizedImg = resizedImg.scaled(s, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-#endif
+		resizedImg = DkImage::downSample2x(resizedImg);
 
 		// // mapping here introduces bugs
 		//DkImage::linearToGamma(resizedImg);
@@ -1049,4 +1230,261 @@ void DkImageStorage::computeImage() {
 
 }
 
+/**
+ * Returns true if the image is drawn in tiles.
+ * @return bool true if the image is larger than tiled_min_pixels.
+ **/ 
+bool DkImageStorage::isTiled() const {
+
+	return (qint64)img.width()*img.height() > tiled_min_pixels;
+}
+
+static QRectF mapToView(const QRect& r, const QRectF& imgViewRect, double scale) {
+
+	return QRectF(imgViewRect.left() + r.x()*scale, imgViewRect.top() + r.y()*scale, r.width()*scale, r.height()*scale);
+}
+
+/**
+ * Draws the visible part of a tiled image.
+ * The pyramid level is chosen such that it is just larger than the displayed image.
+ * Tiles that are not computed yet are queued for the compute thread. Meanwhile, 
+ * the corresponding part of a coarser tile is drawn (if there is one).
+ * @param painter a painter which has the world matrix set.
+ * @param imgViewRect the rectangle (in painter coordinates) the whole image is drawn to.
+ * @param factor the current scale factor (image -> screen).
+ **/ 
+void DkImageStorage::drawTiles(QPainter* painter, const QRectF& imgViewRect, float factor) {
+
+	if (img.isNull() || imgViewRect.isEmpty() || !painter->device())
+		return;
+
+	double scale = imgViewRect.width()/img.width();
+
+	// map the visible area to image coordinates
+	QRectF deviceRect(QPointF(), QSizeF(painter->device()->width(), painter->device()->height()));
+	QRectF viewRect = painter->worldTransform().inverted().mapRect(deviceRect);
+	QRectF imgRect((viewRect.left()-imgViewRect.left())/scale, (viewRect.top()-imgViewRect.top())/scale, 
+		viewRect.width()/scale, viewRect.height()/scale);
+	QRect visRect = imgRect.toAlignedRect().intersected(img.rect());
+
+	if (visRect.isEmpty())
+		return;
+
+	int level = 0;
+	while (level < max_tile_levels && factor*(1 << (level+1)) <= 1.0f)
+		level++;
+
+	// we are zoomed in - just draw the visible part of the image
+	if (level == 0) {
+		painter->drawImage(mapToView(visRect, imgViewRect, scale), img, visRect);
+		return;
+	}
+
+	int ts = tile_size << level;	// tile size in image coordinates
+
+	QMutexLocker locker(&mutex);
+
+	// tiles we did not compute yet are not visible anymore
+	pendingTiles.clear();
+
+	for (int ty = visRect.top()/ts; ty <= visRect.bottom()/ts; ty++) {
+		for (int tx = visRect.left()/ts; tx <= visRect.right()/ts; tx++) {
+
+			quint64 key = tileKey(level, tx, ty);
+			QRect r = tileRect(img.size(), level, tx, ty);
+
+			// object() marks the tile as recently used
+			if (QImage* tile = tiles.object(key)) {
+				painter->drawImage(mapToView(r, imgViewRect, scale), *tile, tile->rect());
+				continue;
+			}
+
+			pendingTiles.append(key);
+
+			// draw the coarser tile meanwhile
+			for (int pl = level+1; pl <= max_tile_levels; pl++) {
+
+				quint64 pKey = tileKey(pl, tx >> (pl-level), ty >> (pl-level));
+
+				QImage* pTile = tiles.object(pKey);
+
+				if (!pTile)
+					continue;
+
+				QRect pr = tileRect(img.size(), pl, tx >> (pl-level), ty >> (pl-level));
+				double ps = 1.0/(1 << pl);
+				QRectF srcRect((r.x()-pr.x())*ps, (r.y()-pr.y())*ps, r.width()*ps, r.height()*ps);
+
+				painter->drawImage(mapToView(r, imgViewRect, scale), *pTile, srcRect);
+				break;
+			}
+		}
+	}
+
+	// nobody is busy so start working
+	if (!pendingTiles.empty() && !tilesBusy) {
+		tilesBusy = true;
+		QMetaObject::invokeMethod(this, "computeTiles", Qt::QueuedConnection);
+	}
+}
+
+/**
+ * Computes all pending tiles.
+ * This function runs in the compute thread.
+ **/ 
+void DkImageStorage::computeTiles() {
+
+	DkTimer dt;
+	int numTiles = 0;
+
+	while (true) {
+
+		mutex.lock();
+		if (pendingTiles.empty()) {
+			tilesBusy = false;
+			mutex.unlock();
+			break;
+		}
+		quint64 key = pendingTiles.takeFirst();
+		QImage srcImg = img;
+		mutex.unlock();
+
+		int level = (int)(key >> 56);
+		int ty = (int)((key >> 28) & 0xfffffff);
+		int tx = (int)(key & 0xfffffff);
+
+		QImage tile = computeTile(srcImg, level, tx, ty);
+
+		mutex.lock();
+		if (srcImg.cacheKey() == img.cacheKey())	// new image assigned?
+			addTile(key, tile);
+		mutex.unlock();
+
+		// show the progress
+		if (++numTiles % 8 == 0)
+			emit imageUpdated();
+	}
+
+	emit imageUpdated();
+
+	qDebug() << numTiles << "tiles computed in" << dt.getTotal() << "tile memory:" << tiles.totalCost()/1024 << "MB";
+}
+
+/**
+ * Computes a single tile.
+ * Level 1 tiles are down sampled from the image region (2*tile_size pixels at most).
+ * Coarser tiles are composed from their four children (level-1) which are
+ * computed (and cached) if needed - so no tile touches more than 2*tile_size pixels.
+ * @param srcImg the full resolution image.
+ * @param level the pyramid level (the tile is down sampled by 2^level).
+ * @param tx the tile column.
+ * @param ty the tile row.
+ * @return QImage the tile (null if a new image was assigned meanwhile).
+ **/ 
+QImage DkImageStorage::computeTile(const QImage& srcImg, int level, int tx, int ty) {
+
+	QRect r = tileRect(srcImg.size(), level, tx, ty);
+	QSize tSize(qMax(1, (r.width() + (1 << level) - 1) >> level), qMax(1, (r.height() + (1 << level) - 1) >> level));
+
+	if (r.isEmpty())
+		return QImage();
+
+	QImage src;
+
+	if (level > 1) {
+
+		QSize cSize(qMax(1, (r.width() + (1 << (level-1)) - 1) >> (level-1)), qMax(1, (r.height() + (1 << (level-1)) - 1) >> (level-1)));
+		src = QImage(cSize, srcImg.hasAlphaChannel() ? QImage::Format_ARGB32_Premultiplied : QImage::Format_RGB32);
+		src.fill(0);
+
+		QPainter p(&src);
+		for (int idx = 0; idx < 4; idx++) {
+
+			int cx = tx*2 + idx%2;
+			int cy = ty*2 + idx/2;
+			quint64 cKey = tileKey(level-1, cx, cy);
+
+			if (tileRect(srcImg.size(), level-1, cx, cy).isEmpty())
+				continue;	// outside the image
+
+			mutex.lock();
+			bool changed = srcImg.cacheKey() != img.cacheKey();
+			QImage* cached = tiles.object(cKey);
+			QImage child = cached ? *cached : QImage();
+			mutex.unlock();
+
+			if (changed)
+				return QImage();
+
+			if (child.isNull()) {
+				child = computeTile(srcImg, level-1, cx, cy);
+
+				if (child.isNull())
+					return QImage();
+
+				mutex.lock();
+				if (srcImg.cacheKey() == img.cacheKey())
+					addTile(cKey, child);
+				mutex.unlock();
+			}
+
+			p.drawImage(QPoint((idx%2)*tile_size, (idx/2)*tile_size), child);
+		}
+		p.end();
+	}
+	else if (srcImg.depth() >= 8) {
+		// the image region (without copying it)
+		src = QImage(srcImg.constBits() + (qint64)r.y()*srcImg.bytesPerLine() + r.x()*(srcImg.depth()/8), 
+			r.width(), r.height(), srcImg.bytesPerLine(), srcImg.format());
+		src.setColorTable(srcImg.colorTable());
+	}
+	else
+		src = srcImg.copy(r);
+
+	if (src.size() == tSize*2)
+		return DkImage::downSample2x(src);
+
+	// odd sized border tiles
+	return src.scaled(tSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+}
+
+/**
+ * Adds a tile to the cache - the least recently used tiles are released if needed.
+ * The mutex must be locked.
+ **/ 
+void DkImageStorage::addTile(quint64 key, const QImage& tile) {
+
+	if (tile.isNull() || tiles.contains(key))
+		return;
+
+	tiles.insert(key, new QImage(tile), qMax(tile.byteCount()/1024, 1));
+}
+
+void DkImageStorage::clearTiles() {
+
+	QMutexLocker locker(&mutex);
+	tiles.clear();
+	pendingTiles.clear();
+}
+
+quint64 DkImageStorage::tileKey(int level, int tx, int ty) {
+
+	return ((quint64)level << 56) | ((quint64)ty << 28) | (quint64)tx;
+}
+
+/**
+ * Returns the image region of a tile.
+ * @param imgSize the full resolution image size.
+ * @param level the pyramid level.
+ * @param tx the tile column.
+ * @param ty the tile row.
+ * @return QRect the tile's rectangle in image coordinates (empty if the tile is outside the image).
+ **/ 
+QRect DkImageStorage::tileRect(const QSize& imgSize, int level, int tx, int ty) {
+
+	int ts = tile_size << level;
+
+	return QRect(tx*ts, ty*ts, ts, ts).intersected(QRect(QPoint(), imgSize));
+}
+
 }
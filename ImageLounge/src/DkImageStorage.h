@@ -32,6 +32,9 @@
 #include <QMutex>
 #include <QVector>
 #include <QObject>
+#include <QHash>
+#include <QList>
+#include <QCache>
 
 // opencv
 #ifdef WITH_OPENCV
@@ -44,6 +47,8 @@
 #endif
 #pragma warning(pop)		// no warnings from includes - end
 
+class QPainter;
+
 #ifdef WIN32
 #pragma warning(disable: 4251)	// TODO: remove
 #endif
@@ -85,6 +90,8 @@ public:
 #ifdef WITH_OPENCV
 	static cv::Mat qImage2Mat(const QImage& img);
 	static QImage mat2QImage(cv::Mat img);
+	static const cv::Mat qImage2MatView(const QImage& img);
+	static QImage mat2QImageView(const cv::Mat& img);
 	static cv::Mat get1DGauss(double sigma);
 	static void mapGammaTable(cv::Mat& img, const QVector<unsigned short>& gammaTable);
 	static void gammaToLinear(cv::Mat& img);
@@ -113,23 +120,49 @@ public:
 	static QImage createThumb(const QImage& img);
 	static QColor getMeanColor(const QImage& img);
 	static uchar findHistPeak(const int* hist, float quantile = 0.005f);
+	static QImage downSample2x(const QImage& img);
+
+protected:
+	static void downSampleRows(const QImage* src, QImage* dst, int startRow, int endRow);
+#ifdef WITH_OPENCV
+	static void releaseMat(void* mat);
+#endif
 };
 
+/**
+ * Stores the image that is displayed and its down sampled versions.
+ * Small images get a pyramid of full frame images (computeImage).
+ * Large images (see isTiled) are split into tiles of tile_size x tile_size pixels
+ * per pyramid level. Tiles are computed on demand (computeTiles) from the level below
+ * and the least recently used tiles are released if they exceed max_tile_memory.
+ * Note that level 0 is the decoded image itself: tiles bound the memory of the
+ * down sampled levels and the drawing costs, but the full image is still kept in memory.
+ **/ 
 class DllExport DkImageStorage : public QObject {
 	Q_OBJECT
 
 public:
 	DkImageStorage(QImage img = QImage());
 
+	enum {
+		tile_size = 512,
+		tiled_min_pixels = 8192*8192,	// images larger than that are tiled
+		max_tile_levels = 12,
+		max_tile_memory = 256,			// MB
+	};
+
 	void setImage(QImage img);
 	QImage getImageConst() const;
 	QImage getImage(float factor = 1.0f);
 	bool hasImage() const {
 		return !img.isNull();
 	}
+	bool isTiled() const;
+	void drawTiles(QPainter* painter, const QRectF& imgViewRect, float factor);
 
 public slots:
 	void computeImage();
+	void computeTiles();
 	void antiAliasingChanged(bool antiAliasing);
 
 signals:
@@ -144,6 +177,17 @@ protected:
 	QThread* computeThread;
 	bool busy;
 	bool stop;
+
+	// tiles
+	QCache<quint64, QImage> tiles;	// cost in KB, releases the least recently used tiles
+	QList<quint64> pendingTiles;
+	bool tilesBusy;
+
+	static quint64 tileKey(int level, int tx, int ty);
+	static QRect tileRect(const QSize& imgSize, int level, int tx, int ty);
+	QImage computeTile(const QImage& srcImg, int level, int tx, int ty);
+	void addTile(quint64 key, const QImage& tile);
+	void clearTiles();
 };
 
 };
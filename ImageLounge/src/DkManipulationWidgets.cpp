@@ -41,6 +41,8 @@
 #include <QPushButton>
 #include <QPainter>
 #include <QApplication>
+#include <QThread>
+#include <QtConcurrentRun>
 #pragma warning(pop)		// no warnings from includes - end
 
 namespace nmc {
@@ -64,6 +66,92 @@ bool DkImageManipulationWidget::doARedraw;
 		cv::Mat DkImageManipulationWidget::imgMat;
 		cv::Mat DkImageManipulationWidget::origMat;
 		cv::Mat DkImageManipulationWidget::tempLUT;
+
+/**
+ * A run of consecutive history steps that work in the same color space.
+ * The 16 bit LUTs of all steps are quantized & composed to one 8 bit table per channel.
+ **/
+struct DkLutStage {
+	bool isHsv;
+	uchar lut[3][256];
+};
+
+/**
+ * Applies all LUT stages to the rows [startRow endRow[ of img (CV_8UC1, CV_8UC3 or CV_8UC4).
+ * Rows are processed in small chunks so that they stay in the cache while passing all stages.
+ **/
+static void applyLutStageRows(const std::vector<DkLutStage>* stages, cv::Mat* img, int startRow, int endRow) {
+
+	const int chunkRows = 16;
+	int cn = img->channels();
+	cv::Mat hsv, rgb;
+
+	for (int cStart = startRow; cStart < endRow; cStart += chunkRows) {
+
+		cv::Mat chunk = img->rowRange(cStart, qMin(cStart+chunkRows, endRow));
+
+		for (size_t sIdx = 0; sIdx < stages->size(); sIdx++) {
+
+			const DkLutStage& s = stages->at(sIdx);
+
+			if (!s.isHsv) {
+
+				for (int rIdx = 0; rIdx < chunk.rows; rIdx++) {
+
+					uchar* ptr = chunk.ptr<uchar>(rIdx);
+
+					if (cn < 3) {
+						for (int cIdx = 0; cIdx < chunk.cols; cIdx++)
+							ptr[cIdx] = s.lut[0][ptr[cIdx]];
+					}
+					else {
+						for (int cIdx = 0; cIdx < chunk.cols; cIdx++, ptr += cn) {
+							ptr[0] = s.lut[0][ptr[0]];
+							ptr[1] = s.lut[1][ptr[1]];
+							ptr[2] = s.lut[2][ptr[2]];
+						}
+					}
+				}
+			}
+			else if (cn >= 3) {
+
+				// one HSV round trip per run of saturation/hue steps
+				cvtColor(chunk, hsv, CV_RGB2HSV);
+
+				for (int rIdx = 0; rIdx < hsv.rows; rIdx++) {
+
+					uchar* ptr = hsv.ptr<uchar>(rIdx);
+
+					for (int cIdx = 0; cIdx < hsv.cols; cIdx++, ptr += 3) {
+						ptr[0] = s.lut[0][ptr[0]];
+						ptr[1] = s.lut[1][ptr[1]];
+						ptr[2] = s.lut[2][ptr[2]];
+					}
+				}
+
+				if (cn == 3) {
+					cvtColor(hsv, chunk, CV_HSV2RGB);	// chunk has the right size - so this writes to img directly
+					continue;
+				}
+
+				cvtColor(hsv, rgb, CV_HSV2RGB);
+
+				// write back & keep alpha
+				for (int rIdx = 0; rIdx < chunk.rows; rIdx++) {
+
+					uchar* dPtr = chunk.ptr<uchar>(rIdx);
+					const uchar* sPtr = rgb.ptr<uchar>(rIdx);
+
+					for (int cIdx = 0; cIdx < chunk.cols; cIdx++, dPtr += cn, sPtr += 3) {
+						dPtr[0] = sPtr[0];
+						dPtr[1] = sPtr[1];
+						dPtr[2] = sPtr[2];
+					}
+				}
+			}
+		}
+	}
+}
 #endif
 
 /**
@@ -212,7 +300,15 @@ void DkImageManipulationDialog::createImgPreview() {
 	previewImgRect.setWidth(previewImgRect.width()-1);			// we have a border... correct that...
 	previewImgRect.setHeight(previewImgRect.height()-1);
 
-	if(rMin < 1) imgPreview = img->scaled(imgSizeScaled, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+	if(rMin < 1) {
+		
+		// box filter the proxy down to twice the preview size - smooth scaling the full image is slow
+		QImage proxy = *img;
+		while (proxy.width() >= imgSizeScaled.width()*4 && proxy.height() >= imgSizeScaled.height()*4)
+			proxy = DkImage::downSample2x(proxy);
+
+		imgPreview = proxy.scaled(imgSizeScaled, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+	}
 	else imgPreview = *img;
 	
 	if (imgPreview.format() == QImage::Format_Mono || imgPreview.format() == QImage::Format_MonoLSB || 
@@ -623,6 +719,107 @@ cv::Mat DkImageManipulationWidget::applyLutToImage(cv::Mat inImg, cv::Mat inLUT,
 	else return tempImg;
 }
 
+/**
+ * applies the whole manipulation history to an image
+ * consecutive steps of the same color space are composed to a single LUT and
+ * all of them are applied in one row-parallel pass (8 bit images only).
+ * @param input image
+ * @param optional progress dialog, the image is not processed if it gets canceled
+ * @return modified image or an empty image if the user canceled
+ **/
+cv::Mat DkImageManipulationWidget::applyHistoryToImage(cv::Mat inImg, QProgressDialog* progress) {
+
+	cv::Mat outImg = inImg.clone();
+
+	if (historyToolsVec.empty() || outImg.empty())
+		return outImg;
+
+	cv::Mat lut16 = createMatLut16();
+	int step = (int) (90 / historyToolsVec.size());
+
+	// fallback for non 8 bit images: step by step
+	if (outImg.depth() != CV_8U || (outImg.channels() != 1 && outImg.channels() != 3 && outImg.channels() != 4)) {
+
+		for (unsigned int i = 0; i < historyToolsVec.size(); i++) {
+
+			cv::Mat lut = historyToolsVec[i]->compute(lut16.clone(), historyDataVec[i].arg1, historyDataVec[i].arg2);
+			outImg = applyLutToImage(outImg, lut, historyDataVec[i].isHsv);
+
+			if (progress) {
+				progress->setValue(step*(i+1));
+				if (progress->wasCanceled()) return cv::Mat();
+			}
+		}
+
+		return outImg;
+	}
+
+	std::vector<DkLutStage> stages;
+	int maxIdx = lut16.cols-1;
+
+	for (unsigned int i = 0; i < historyToolsVec.size(); i++) {
+
+		cv::Mat lut = historyToolsVec[i]->compute(lut16.clone(), historyDataVec[i].arg1, historyDataVec[i].arg2);
+		bool isHsv = historyDataVec[i].isHsv;
+
+		// quantize exactly like applyLutToImage does
+		uchar stepLut[3][256];
+		for (int c = 0; c < 3; c++) {
+
+			const unsigned short* ptrLut = lut.ptr<unsigned short>(c);
+			int maxVal = (isHsv && c == 0) ? 180 : 255;
+
+			for (int v = 0; v < 256; v++) {
+
+				if (v > maxVal) {
+					stepLut[c][v] = (uchar)v;
+					continue;
+				}
+
+				float val = ptrLut[cvRound(v / (float)maxVal * maxIdx)];
+				stepLut[c][v] = (uchar)cvRound((c == 0 && isHsv) ? val / 65535.0f * 180.0f : val / 257.0f);
+			}
+		}
+
+		// compose with the previous step if it works in the same color space
+		if (!stages.empty() && stages.back().isHsv == isHsv) {
+
+			DkLutStage& s = stages.back();
+			for (int c = 0; c < 3; c++)
+				for (int v = 0; v < 256; v++)
+					s.lut[c][v] = stepLut[c][s.lut[c][v]];
+		}
+		else {
+			DkLutStage s;
+			s.isHsv = isHsv;
+			memcpy(s.lut, stepLut, sizeof(stepLut));
+			stages.push_back(s);
+		}
+
+		if (progress) {
+			progress->setValue(step*(i+1)/2);
+			if (progress->wasCanceled()) return cv::Mat();
+		}
+	}
+
+	// a band should have at least 64 rows - otherwise threading does not pay off
+	int numBands = qMax(1, qMin(QThread::idealThreadCount(), outImg.rows/64));
+	QVector<QFuture<void> > futures;
+
+	for (int idx = 1; idx < numBands; idx++)
+		futures.append(QtConcurrent::run(&applyLutStageRows, (const std::vector<DkLutStage>*)&stages, &outImg, idx*outImg.rows/numBands, (idx+1)*outImg.rows/numBands));
+
+	applyLutStageRows(&stages, &outImg, 0, outImg.rows/numBands);
+
+	for (int idx = 0; idx < futures.size(); idx++)
+		futures[idx].waitForFinished();
+
+	if (progress)
+		progress->setValue(99);
+
+	return outImg;
+}
+
 /**
  * called from DkNoMacs.cpp: applies manipulation history to the viewport image
  * @param input image
@@ -636,29 +833,15 @@ cv::Mat DkImageManipulationWidget::manipulateImage(cv::Mat inImg){
 	if (historyToolsVec.size() > 0) {
 
 		QProgressDialog* progress = new QProgressDialog("Applying changes to image...", "Cancel", 0, 100, qApp->activeWindow());
-		int step = (int) (100 / historyToolsVec.size());
 		progress->setWindowModality(Qt::WindowModal);
 		progress->setValue(1);	// a strange behavior of the progress dialog: first setValue shows an empty dialog (setting to zero won't work)
 		progress->setValue(2);	// second setValue shows the progress bar with 2% (setting to zero won't work)
 		progress->setValue(0);	// finally set the progress to zero
 
-		outImg = inImg.clone();
-		cv::Mat lut16 = createMatLut16();
-		unsigned int i;
-		for (i = 0; i < historyToolsVec.size(); i++) {
-
-			cv::Mat lut = lut16.clone();
-			lut = historyToolsVec[i]->compute(lut, historyDataVec[i].arg1, historyDataVec[i].arg2);
-			progress->setValue((int)(step*(i+0.5f)));
-			if (progress->wasCanceled()) break;
-			outImg = applyLutToImage(outImg, lut, historyDataVec[i].isHsv);
-			progress->setValue(step*(i+1)-1);
-			if (progress->wasCanceled()) break;
-		}
-
+		outImg = applyHistoryToImage(inImg, progress);
 		progress->close(); 
 
-		if (historyToolsVec.size() != i) return nullImg;
+		if (outImg.empty()) return nullImg;
 	}
 
 	return outImg;
@@ -956,7 +1139,7 @@ void DkBrightness::redrawImage() {
 
 #ifdef WITH_OPENCV
 	cv::Mat manipulationLUT = compute(tempLUT, currData.arg1, currData.arg2);
-	emit updateDialogImgSignal(DkImage::mat2QImage(applyLutToImage(imgMat, manipulationLUT, currData.isHsv)));
+	emit updateDialogImgSignal(DkImage::mat2QImageView(applyLutToImage(imgMat, manipulationLUT, currData.isHsv)));
 #endif
 
 };
@@ -1050,7 +1233,7 @@ void DkContrast::redrawImage() {
 
 #ifdef WITH_OPENCV
 	cv::Mat manipulationLUT = compute(tempLUT, currData.arg1, currData.arg2);
-	emit updateDialogImgSignal(DkImage::mat2QImage(applyLutToImage(imgMat, manipulationLUT, currData.isHsv)));
+	emit updateDialogImgSignal(DkImage::mat2QImageView(applyLutToImage(imgMat, manipulationLUT, currData.isHsv)));
 #endif
 
 };
@@ -1144,7 +1327,7 @@ void DkSaturation::redrawImage() {
 
 #ifdef WITH_OPENCV
 	cv::Mat manipulationLUT = compute(tempLUT, currData.arg1, currData.arg2);
-	emit updateDialogImgSignal(DkImage::mat2QImage(applyLutToImage(imgMat, manipulationLUT, currData.isHsv)));
+	emit updateDialogImgSignal(DkImage::mat2QImageView(applyLutToImage(imgMat, manipulationLUT, currData.isHsv)));
 #endif
 
 };
@@ -1250,7 +1433,7 @@ void DkHue::redrawImage() {
 	setSaturationSliderColor(QColor(hueGradientImg.pixel(hue/2 + 90, 0)).name());
 #ifdef WITH_OPENCV
 	cv::Mat manipulationLUT = compute(tempLUT, currData.arg1, currData.arg2);
-	emit updateDialogImgSignal(DkImage::mat2QImage(applyLutToImage(imgMat, manipulationLUT, currData.isHsv)));
+	emit updateDialogImgSignal(DkImage::mat2QImageView(applyLutToImage(imgMat, manipulationLUT, currData.isHsv)));
 #endif
 
 };
@@ -1352,7 +1535,7 @@ void DkGamma::redrawImage() {
 
 #ifdef WITH_OPENCV
 	cv::Mat manipulationLUT = compute(tempLUT, currData.arg1, currData.arg2);
-	emit updateDialogImgSignal(DkImage::mat2QImage(applyLutToImage(imgMat, manipulationLUT, currData.isHsv)));
+	emit updateDialogImgSignal(DkImage::mat2QImageView(applyLutToImage(imgMat, manipulationLUT, currData.isHsv)));
 #endif
 
 };
@@ -1465,7 +1648,7 @@ void DkExposure::redrawImage() {
 
 #ifdef WITH_OPENCV
 	cv::Mat manipulationLUT = compute(tempLUT, currData.arg1, currData.arg2);
-	emit updateDialogImgSignal(DkImage::mat2QImage(applyLutToImage(imgMat, manipulationLUT, currData.isHsv)));
+	emit updateDialogImgSignal(DkImage::mat2QImageView(applyLutToImage(imgMat, manipulationLUT, currData.isHsv)));
 #endif
 
 };
@@ -1533,15 +1716,10 @@ void DkUndoRedo::undoPressed() {
 #ifdef WITH_OPENCV
 	if (historyToolsVec.size() > 0) {
 
-		cv::Mat imgToDisplay = origMat.clone();
-		for (unsigned int i = 0; i < historyToolsVec.size(); i++) {
-
-			cv::Mat lut = historyToolsVec[i]->compute(tempLUT, historyDataVec[i].arg1, historyDataVec[i].arg2);
-			imgToDisplay = applyLutToImage(imgToDisplay, lut, historyDataVec[i].isHsv);
-		}
+		cv::Mat imgToDisplay = applyHistoryToImage(origMat);
 
 		imgMat = imgToDisplay.clone();
-		emit updateDialogImgSignal(DkImage::mat2QImage(imgToDisplay));
+		emit updateDialogImgSignal(DkImage::mat2QImageView(imgToDisplay));
 	}
 	else {
 		buttonUndo->setEnabled(false);
@@ -1573,17 +1751,12 @@ void DkUndoRedo::redoPressed() {
 	buttonUndo->setEnabled(true);
 
 #ifdef WITH_OPENCV
-	cv::Mat imgToDisplay = origMat.clone();
-	for (unsigned int i = 0; i < historyToolsVec.size(); i++) {
-
-		cv::Mat lut = historyToolsVec[i]->compute(tempLUT, historyDataVec[i].arg1, historyDataVec[i].arg2);
-		imgToDisplay = applyLutToImage(imgToDisplay, lut, historyDataVec[i].isHsv);
-	}
+	cv::Mat imgToDisplay = applyHistoryToImage(origMat);
 
 	if(historyDataVec.size() != historyDataVecCopy.size()) imgMat = imgToDisplay.clone();
 	else prepareUndo = true;
 
-	emit updateDialogImgSignal(DkImage::mat2QImage(imgToDisplay));
+	emit updateDialogImgSignal(DkImage::mat2QImageView(imgToDisplay));
 #endif
 
 };
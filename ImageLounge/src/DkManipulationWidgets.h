@@ -52,6 +52,7 @@ class QDoubleSpinBox;
 class QSlider;
 class QLabel;
 class QPushButton;
+class QProgressDialog;
 
 namespace nmc {
 
@@ -143,6 +144,7 @@ class DkImageManipulationWidget : public QWidget {
 		static cv::Mat origMat;
 
 		static cv::Mat applyLutToImage(cv::Mat inImg, cv::Mat tempLUT, bool isMatHsv);
+		static cv::Mat applyHistoryToImage(cv::Mat inImg, QProgressDialog* progress = 0);
 		static cv::Mat createMatLut16();
 #endif
 
@@ -39,6 +39,10 @@
 #include <QBuffer>
 #include <QVector2D>
 #include <QApplication>
+
+#if QT_VERSION >= 0x050100
+#include <QSaveFile>
+#endif
 #pragma warning(pop)		// no warnings from includes - end
 
 namespace nmc {
@@ -129,9 +133,18 @@ bool DkMetaDataT::saveMetaData(const QFileInfo& fileInfo, bool force) {
 		return false;
 	}
 
+#if QT_VERSION >= 0x050100
+	// replace the file atomically - a failed write does not destroy the old file
+	QSaveFile saveFile(fileInfo.absoluteFilePath());
+	saveFile.open(QFile::WriteOnly);
+	saveFile.write(ba->data(), ba->size());
+	if (!saveFile.commit())
+		return false;
+#else
 	file.open(QFile::WriteOnly);
 	file.write(ba->data(), ba->size());
 	file.close();
+#endif
 
 	qDebug() << "[DkMetaDataT] I saved: " << ba->size() << " bytes";
 
@@ -1700,7 +1700,7 @@ void DkNoMacs::moveEvent(QMoveEvent *event) {
 
 void DkNoMacs::mouseDoubleClickEvent(QMouseEvent* event) {
 
-	if (event->button() != Qt::LeftButton || (viewport() && viewport()->getImage().isNull()))
+	if (event->button() != Qt::LeftButton || (viewport() && !viewport()->getImageStorage()->hasImage()))
 		return;
 
 	if (isFullScreen())
@@ -2741,7 +2741,8 @@ void DkNoMacs::openImgManipulationDialog() {
 
 	if(!getCurrRunningPlugin().isEmpty()) applyPluginChanges(true, false);
 
-	if (!viewport() || viewport()->getImage().isNull())
+	// the preview does not need the full size image - so take what is currently displayed
+	if (!viewport() || !viewport()->getImageStorage() || viewport()->getImageStorage()->getImageConst().isNull())
 		return;
 
 	if (!imgManipulationDialog)
@@ -2749,7 +2750,7 @@ void DkNoMacs::openImgManipulationDialog() {
 	else 
 		imgManipulationDialog->resetValues();
 
-	QImage tmpImg = viewport()->getImage();
+	QImage tmpImg = viewport()->getImageStorage()->getImageConst();
 	imgManipulationDialog->setImage(&tmpImg);
 
 	bool ok = imgManipulationDialog->exec() != 0;
@@ -2758,7 +2759,14 @@ void DkNoMacs::openImgManipulationDialog() {
 
 #ifdef WITH_OPENCV
 
-		QImage mImg = DkImage::mat2QImage(DkImageManipulationWidget::manipulateImage(DkImage::qImage2Mat(viewport()->getImage())));
+		// the changes are applied to the full size image (blocking)
+		QSharedPointer<DkImageLoader> loader = getTabWidget()->getCurrentImageLoader();
+		if (loader && loader->getCurrentImage())
+			loader->getCurrentImage()->loadFullSize();
+
+		// read-only view: applyHistoryToImage works on a clone
+		QImage img = viewport()->getImage();
+		QImage mImg = DkImage::mat2QImageView(DkImageManipulationWidget::manipulateImage(DkImage::qImage2MatView(img)));
 
 		if (!mImg.isNull())
 			viewport()->setEditedImage(mImg);
@@ -3246,8 +3254,16 @@ void DkNoMacs::setWindowTitle(QFileInfo file, QSize size, bool edited, QString a
 
 	if (!size.isEmpty())
 		attributes.sprintf(" - %i x %i", size.width(), size.height());
-	if (size.isEmpty() && viewport())
-		attributes.sprintf(" - %i x %i", viewport()->getImage().width(), viewport()->getImage().height());
+	if (size.isEmpty() && viewport()) {
+		
+		// report the size of the file if the image was decoded at screen resolution
+		QSize imgSize = viewport()->getImageStorage()->getImage().size();
+		QSharedPointer<DkImageContainerT> imgC = getTabWidget()->getCurrentImage();
+		if (imgC && imgC->isDownscaled())
+			imgSize = imgC->getLoader()->getFullSize();
+
+		attributes.sprintf(" - %i x %i", imgSize.width(), imgSize.height());
+	}
 	if (DkSettings::app.privateMode) 
 		attributes.append(tr(" [Private Mode]"));
 
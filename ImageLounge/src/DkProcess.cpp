@@ -29,11 +29,22 @@
 #include "DkUtils.h"
 #include "DkImageContainer.h"
 #include "DkImageStorage.h"
+#include "DkBasicLoader.h"
+#include "DkSettings.h"
+#include "DkTimer.h"
 
 #pragma warning(push, 0)	// no warnings from includes - begin
 #include <QFuture>
 #include <QFutureWatcher>
 #include <QtConcurrentMap>
+#include <QtConcurrentRun>
+#include <QRunnable>
+#include <QThread>
+#include <QBuffer>
+#include <QImageReader>
+#include <QTextStream>
+#include <QEventLoop>
+#include <QSettings>
 #include <QWidget>
 #pragma warning(pop)		// no warnings from includes - end
 
@@ -231,12 +242,30 @@ bool DkBatchTransform::compute(QImage& img, QStringList& logStrings) const {
 }
 
 // DkBatchProcess --------------------------------------------------------------------
+/**
+ * Adds the time spent in a scope to a counter (ms).
+ **/ 
+class DkStageTimer {
+
+public:
+	DkStageTimer(int& time) : time(time) {};
+
+	~DkStageTimer() {
+		time += qRound(dt.getTotalTime()*1000);
+	};
+
+protected:
+	int& time;
+	DkTimer dt;
+};
+
 DkBatchProcess::DkBatchProcess(const QFileInfo& fileInfoIn, const QFileInfo& fileInfoOut) {
 	this->fileInfoIn = fileInfoIn;
 	this->fileInfoOut = fileInfoOut;
 	compression = -1;
 	failure = 0;
 	isProcessed = false;
+	time = 0;
 
 	mode = DkBatchConfig::mode_skip_existing;
 }
@@ -256,6 +285,11 @@ void DkBatchProcess::setDeleteOriginal(bool deleteOriginal) {
 	this->deleteOriginal = deleteOriginal;
 }
 
+void DkBatchProcess::setCompression(int compression) {
+
+	this->compression = compression;
+}
+
 QFileInfo DkBatchProcess::inputFile() const {
 
 	return fileInfoIn;
@@ -276,62 +310,156 @@ bool DkBatchProcess::wasProcessed() const {
 	return isProcessed;
 }
 
+int DkBatchProcess::getTime() const {
+
+	return time;
+}
+
 bool DkBatchProcess::compute() {
 
-	isProcessed = true;
+	if (!prepare())
+		return failure == 0;
+
+	readFile();
+
+	if (processImage())
+		writeFile();
+
+	return failure == 0;
+}
+
+/**
+ * Checks the item & handles items that do not need to be decoded (rename, copy).
+ * @return bool true if the image needs to be processed
+ **/ 
+bool DkBatchProcess::prepare() {
+
+	DkStageTimer st(time);
 
 	// check errors
 	if (fileInfoOut.exists() && mode == DkBatchConfig::mode_skip_existing) {
 		logStrings.append(QObject::tr("%1 already exists -> skipping (check 'overwrite' if you want to overwrite the file)").arg(fileInfoOut.absoluteFilePath()));
 		failure++;
-		return failure == 0;
+		isProcessed = true;
+		return false;
 	}
 	else if (!fileInfoIn.exists()) {
 		logStrings.append(QObject::tr("Error: input file does not exist"));
 		logStrings.append(QObject::tr("Input: %1").arg(fileInfoIn.absoluteFilePath()));
 		failure++;
-		return failure == 0;
+		isProcessed = true;
+		return false;
 	}
 	else if (fileInfoIn == fileInfoOut && processFunctions.empty()) {
 		logStrings.append(QObject::tr("Skipping: nothing to do here."));
 		failure++;
-		return failure == 0;
+		isProcessed = true;
+		return false;
 	}
 	
 	// do the work
 	if (processFunctions.empty() && fileInfoIn.absolutePath() == fileInfoOut.absolutePath() && fileInfoIn.suffix() == fileInfoOut.suffix()) {	// rename?
 		if (!renameFile())
 			failure++;
-		return failure == 0;
+		isProcessed = true;
+		return false;
 	}
 	else if (processFunctions.empty() && fileInfoIn.suffix() == fileInfoOut.suffix()) {	// copy?
-		if (!copyFile())
+		
+		// copy & delete is a move - which is just a rename on the same file system
+		if (deleteOriginal) {
+			if (!moveFile())
+				failure++;
+		}
+		else if (!copyFile())
 			failure++;
 		else
 			deleteOriginalFile();
 
-		return failure == 0;
+		isProcessed = true;
+		return false;
 	}
 
-	process();
-
-	return failure == 0;
+	return true;
 }
 
-QStringList DkBatchProcess::getLog() const {
+/**
+ * Returns true if the item is just copied or renamed (no image processing).
+ * @return bool true if the file is not decoded
+ **/ 
+bool DkBatchProcess::isFileOperation() const {
 
-	return logStrings;
+	return processFunctions.empty() && fileInfoIn.suffix() == fileInfoOut.suffix();
 }
 
-bool DkBatchProcess::process() {
+/**
+ * Reads the input file (I/O stage).
+ **/ 
+void DkBatchProcess::readFile() {
+
+	DkStageTimer st(time);
 
 	logStrings.append(QObject::tr("processing %1").arg(fileInfoIn.absoluteFilePath()));
 
-	QSharedPointer<DkImageContainer> imgC(new DkImageContainer(fileInfoIn));
+	imgC = QSharedPointer<DkImageContainer>(new DkImageContainer(fileInfoIn));
+	imgC->readFile();
+}
+
+/**
+ * Estimates the memory (in bytes) that is needed to process the item.
+ * RAW files are identified by their suffix (like DkBasicLoader does) since Qt
+ * reports the embedded thumbnail's size for TIFF based RAWs (NEF, DNG, ...).
+ * If the size is unknown, we assume a compression ratio of 1:8 (1:16 for RAW files).
+ * @return qint64 the estimated memory
+ **/ 
+qint64 DkBatchProcess::estimateMemory() const {
+
+	if (!imgC)
+		return 0;
+
+	QSharedPointer<QByteArray> ba = imgC->getFileBuffer();
+	qint64 fileSize = !ba->isEmpty() ? ba->size() : fileInfoIn.size();
+
+	if (DkBasicLoader::isRawFile(fileInfoIn)) {
+
+		QSize imgSize = DkBasicLoader::rawImageSize(ba);
+
+		// libraw keeps the 16 bit sensor data (2 bytes) and the 16 bit RGBA image (8 bytes)
+		// while developing + we keep the decoded and the processed image (32 bit)
+		if (imgSize.isValid())
+			return fileSize + (qint64)imgSize.width() * imgSize.height() * (2 + 8 + 4 * 2);
+
+		return fileSize * 16;
+	}
+
+	QSize imgSize;
+
+	if (!ba->isEmpty()) {
+		QBuffer buffer(ba.data());
+		QImageReader reader(&buffer, fileInfoIn.suffix().toLower().toLatin1());
+		imgSize = reader.size();	// just reads the header
+	}
+
+	// we keep the decoded and the processed image (32 bit)
+	if (imgSize.isValid())
+		return fileSize + (qint64)imgSize.width() * imgSize.height() * 4 * 2;
+
+	return fileSize * 8;
+}
+
+/**
+ * Decodes the image, applies the process chain & encodes the result (CPU stage).
+ * @return bool true if there is an encoded image to be written
+ **/ 
+bool DkBatchProcess::processImage() {
+
+	DkStageTimer st(time);
 
-	if (!imgC->loadImage() || imgC->image().isNull()) {
+	if (!imgC || !imgC->loadImage() || imgC->image().isNull()) {
 		logStrings.append(QObject::tr("Error while loading..."));
 		failure++;
+		imgC.clear();
+		isProcessed = true;
 		return false;
 	}
 
@@ -348,18 +476,66 @@ bool DkBatchProcess::process() {
 		}
 	}
 
+	QSharedPointer<DkBasicLoader> loader = imgC->getLoader();
+
+	if (!loader->saveToBuffer(fileInfoOut, loader->image(), saveBuffer, compression) || !saveBuffer || saveBuffer->isEmpty()) {
+		logStrings.append(QObject::tr("Could not save: %1").arg(fileInfoOut.absoluteFilePath()));
+		failure++;
+		saveBuffer.clear();
+		imgC.clear();
+		isProcessed = true;
+		return false;
+	}
+
+	// we just need the encoded image from now on - this releases the decoded image and the file buffer
+	imgC.clear();
+
+	return true;
+}
+
+qint64 DkBatchProcess::encodedSize() const {
+
+	return saveBuffer ? saveBuffer->size() : 0;
+}
+
+/**
+ * Writes the encoded image (I/O stage).
+ **/ 
+void DkBatchProcess::writeFile() {
+
+	DkStageTimer st(time);
+
 	deleteExisting();
 
-	if (imgC->saveImage(fileInfoOut, compression))
+	if (DkBasicLoader::writeBufferToFile(fileInfoOut, saveBuffer))
 		logStrings.append(QObject::tr("%1 saved...").arg(fileInfoOut.absoluteFilePath()));
 	else {
 		logStrings.append(QObject::tr("Could not save: %1").arg(fileInfoOut.absoluteFilePath()));
 		failure++;
 	}
 
+	saveBuffer.clear();
+	imgC.clear();
+
 	deleteOriginalFile();
+	isProcessed = true;
+}
 
-	return true;
+/**
+ * Drops an item that was canceled while it was in the pipeline.
+ **/ 
+void DkBatchProcess::abort() {
+
+	logStrings.append(QObject::tr("Canceled: %1").arg(fileInfoIn.absoluteFilePath()));
+	failure++;
+	saveBuffer.clear();
+	imgC.clear();
+	isProcessed = true;
+}
+
+QStringList DkBatchProcess::getLog() const {
+
+	return logStrings;
 }
 
 bool DkBatchProcess::renameFile() {
@@ -385,18 +561,18 @@ bool DkBatchProcess::renameFile() {
 
 bool DkBatchProcess::copyFile() {
 
-	QFile file(fileInfoIn.absoluteFilePath());
-
 	if (fileInfoOut.exists() && mode == DkBatchConfig::mode_overwrite) {
 		if (!deleteExisting())
 			return false;	// early break
 	}
 
-	if (!file.copy(fileInfoOut.absoluteFilePath())) {
+	QString errorString;
+
+	if (!DkUtils::copyFile(fileInfoIn, fileInfoOut, errorString)) {
 		logStrings.append(QObject::tr("Error: could not copy file"));
 		logStrings.append(QObject::tr("Input: %1").arg(fileInfoIn.absoluteFilePath()));
 		logStrings.append(QObject::tr("Output: %1").arg(fileInfoOut.absoluteFilePath()));
-		logStrings.append(file.errorString());
+		logStrings.append(errorString);
 		return false;
 	}
 	else
@@ -405,6 +581,28 @@ bool DkBatchProcess::copyFile() {
 	return true;
 }
 
+bool DkBatchProcess::moveFile() {
+
+	if (fileInfoOut.exists() && mode == DkBatchConfig::mode_overwrite) {
+		if (!deleteExisting())
+			return false;	// early break
+	}
+
+	QString errorString;
+
+	if (!DkUtils::moveFile(fileInfoIn, fileInfoOut, errorString)) {
+		logStrings.append(QObject::tr("Error: could not move file"));
+		logStrings.append(QObject::tr("Input: %1").arg(fileInfoIn.absoluteFilePath()));
+		logStrings.append(QObject::tr("Output: %1").arg(fileInfoOut.absoluteFilePath()));
+		logStrings.append(errorString);
+		return false;
+	}
+	else
+		logStrings.append(QObject::tr("Moving: %1 -> %2").arg(fileInfoIn.absoluteFilePath()).arg(fileInfoOut.absoluteFilePath()));
+
+	return true;
+}
+
 bool DkBatchProcess::deleteExisting() {
 
 	if (fileInfoOut.exists() && mode == DkBatchConfig::mode_overwrite) {
@@ -456,6 +654,8 @@ void DkBatchConfig::init() {
 
 	compression = -1;
 	mode = mode_skip_existing;
+	memoryBudget = DkSettings::resources.batchMemory;
+	ioDepth = DkSettings::resources.batchIoDepth;
 }
 
 bool DkBatchConfig::isOk() const {
@@ -479,12 +679,59 @@ bool DkBatchConfig::isOk() const {
 	return true;
 }
 
+// DkBatchStage --------------------------------------------------------------------
+/**
+ * Runs one stage of the batch pipeline on a thread of the pipeline pool.
+ **/ 
+class DkBatchStage : public QRunnable {
+
+public:
+	DkBatchStage(DkBatchProcessing* batch, void (DkBatchProcessing::*stage)()) {
+		this->batch = batch;
+		this->stage = stage;
+	};
+
+	void run() {
+		(batch->*stage)();
+	};
+
+protected:
+	DkBatchProcessing* batch;
+	void (DkBatchProcessing::*stage)();
+};
+
+/**
+ * Copies or renames a single item on a thread of the copy pool.
+ **/ 
+class DkBatchFileOperation : public QRunnable {
+
+public:
+	DkBatchFileOperation(DkBatchProcessing* batch, int idx) {
+		this->batch = batch;
+		this->idx = idx;
+	};
+
+	void run() {
+		batch->copyItem(idx);
+	};
+
+protected:
+	DkBatchProcessing* batch;
+	int idx;
+};
+
 // DkBatchProcessing --------------------------------------------------------------------
 DkBatchProcessing::DkBatchProcessing(const DkBatchConfig& config, QWidget* parent /*= 0*/) : QObject(parent) {
 
 	this->batchConfig = config;
+	memoryUsed = 0;
+	memoryBudget = 0;
+	maxQueueSize = 1;
+	numWorkersRunning = 0;
+	numDone = 0;
+	readingDone = false;
+	canceled = false;
 
-	connect(&batchWatcher, SIGNAL(progressValueChanged(int)), this, SIGNAL(progressValueChanged(int)));
 	connect(&batchWatcher, SIGNAL(finished()), this, SIGNAL(finished()));
 }
 
@@ -504,6 +751,7 @@ void DkBatchProcessing::init() {
 		DkBatchProcess cProcess(cFileInfo, newFileInfo);
 		cProcess.setMode(batchConfig.getMode());
 		cProcess.setDeleteOriginal(batchConfig.getDeleteOriginal());
+		cProcess.setCompression(batchConfig.getCompression());
 		cProcess.setProcessChain(batchConfig.getProcessFunctions());
 
 		batchItems.push_back(cProcess);
@@ -512,17 +760,221 @@ void DkBatchProcessing::init() {
 
 void DkBatchProcessing::compute() {
 
+	if (batchWatcher.isRunning())
+		batchWatcher.waitForFinished();
+
 	init();
 
 	qDebug() << "computing...";
 
-	if (batchWatcher.isRunning())
-		batchWatcher.waitForFinished();
-
-	QFuture<void> future = QtConcurrent::map(batchItems, &nmc::DkBatchProcessing::computeItem);
+	QFuture<void> future = QtConcurrent::run(this, &nmc::DkBatchProcessing::runPipeline);
 	batchWatcher.setFuture(future);
 }
 
+/**
+ * Processes all batch items in a pipeline.
+ * A reader (this thread) loads the files, workers decode, process & encode them
+ * and a writer saves the results. The queues between the stages are bounded and
+ * an item is just read if its estimated memory fits into the memory budget.
+ * So disk I/O overlaps with computing and we do not run out of memory
+ * if we have many cores & large images.
+ **/ 
+void DkBatchProcessing::runPipeline() {
+
+	// reader & writer are mostly waiting for the disk
+	int numWorkers = qMax(1, QThread::idealThreadCount()-1);
+
+	float budgetMB = batchConfig.getMemoryBudget();
+	if (budgetMB <= 0)
+		budgetMB = (float)DkMemory::getFreeMemory()*0.5f;
+	if (budgetMB <= 0)
+		budgetMB = 1024;
+
+	pipeMutex.lock();
+	decodeQueue.clear();
+	writeQueue.clear();
+	itemMemory = QVector<qint64>(batchItems.size(), 0);
+	memoryUsed = 0;
+	memoryBudget = (qint64)(budgetMB*1024.0f*1024.0f);
+	maxQueueSize = numWorkers;
+	numWorkersRunning = numWorkers;
+	numDone = 0;
+	readingDone = false;
+	canceled = false;
+	pipeMutex.unlock();
+
+	qDebug() << "[Batch] pipeline with" << numWorkers << "workers and" << budgetMB << "MB memory budget";
+
+	// copies are limited by the storage - not by the CPU
+	copyPool.setMaxThreadCount(qMax(1, batchConfig.getIoDepth()));
+
+	pipelinePool.setMaxThreadCount(numWorkers+1);
+	pipelinePool.start(new DkBatchStage(this, &DkBatchProcessing::writeItems));
+
+	for (int idx = 0; idx < numWorkers; idx++)
+		pipelinePool.start(new DkBatchStage(this, &DkBatchProcessing::processItems));
+
+	readItems();
+	pipelinePool.waitForDone();
+	copyPool.waitForDone();
+
+	// clean up items that were canceled within the pipeline
+	while (!decodeQueue.empty())
+		batchItems[decodeQueue.dequeue()].abort();
+	while (!writeQueue.empty())
+		batchItems[writeQueue.dequeue()].abort();
+}
+
+void DkBatchProcessing::readItems() {
+
+	for (int idx = 0; idx < batchItems.size(); idx++) {
+
+		pipeMutex.lock();
+		bool stop = canceled;
+		pipeMutex.unlock();
+
+		if (stop)
+			break;
+
+		DkBatchProcess& item = batchItems[idx];
+
+		if (item.isFileOperation()) {
+			copyPool.start(new DkBatchFileOperation(this, idx));
+			continue;
+		}
+
+		// errors are handled here
+		if (!item.prepare()) {
+			itemDone();
+			continue;
+		}
+
+		item.readFile();
+		qint64 mem = item.estimateMemory();
+
+		QMutexLocker locker(&pipeMutex);
+
+		// wait until the item fits into the memory budget - a single large item is always allowed
+		while (!canceled && ((memoryUsed > 0 && memoryUsed + mem > memoryBudget) || decodeQueue.size() >= maxQueueSize))
+			pipeCondition.wait(&pipeMutex);
+
+		if (canceled) {
+			item.abort();
+			break;
+		}
+
+		memoryUsed += mem;
+		itemMemory[idx] = mem;
+		decodeQueue.enqueue(idx);
+		pipeCondition.wakeAll();
+	}
+
+	QMutexLocker locker(&pipeMutex);
+	readingDone = true;
+	pipeCondition.wakeAll();
+}
+
+void DkBatchProcessing::processItems() {
+
+	while (true) {
+
+		pipeMutex.lock();
+
+		while (decodeQueue.empty() && !readingDone && !canceled)
+			pipeCondition.wait(&pipeMutex);
+
+		if (decodeQueue.empty() || canceled) {
+			pipeMutex.unlock();
+			break;
+		}
+
+		int idx = decodeQueue.dequeue();
+		pipeCondition.wakeAll();	// the reader might wait for space in the queue
+		pipeMutex.unlock();
+
+		DkBatchProcess& item = batchItems[idx];
+		bool encoded = item.processImage();
+
+		QMutexLocker locker(&pipeMutex);
+
+		// the decoded image is released - keep just the encoded buffer in the budget
+		qint64 mem = encoded ? qMin(item.encodedSize(), itemMemory[idx]) : 0;
+		memoryUsed -= itemMemory[idx] - mem;
+		itemMemory[idx] = mem;
+
+		if (encoded) {
+			
+			while (writeQueue.size() >= maxQueueSize && !canceled)
+				pipeCondition.wait(&pipeMutex);
+
+			writeQueue.enqueue(idx);
+		}
+		else {
+			locker.unlock();
+			itemDone();
+			locker.relock();
+		}
+
+		pipeCondition.wakeAll();
+	}
+
+	QMutexLocker locker(&pipeMutex);
+	numWorkersRunning--;
+	pipeCondition.wakeAll();
+}
+
+void DkBatchProcessing::writeItems() {
+
+	while (true) {
+
+		pipeMutex.lock();
+
+		while (writeQueue.empty() && numWorkersRunning > 0 && !canceled)
+			pipeCondition.wait(&pipeMutex);
+
+		if (writeQueue.empty() || canceled) {
+			pipeMutex.unlock();
+			break;
+		}
+
+		int idx = writeQueue.dequeue();
+		pipeCondition.wakeAll();	// workers might wait for space in the queue
+		pipeMutex.unlock();
+
+		batchItems[idx].writeFile();
+
+		pipeMutex.lock();
+		memoryUsed -= itemMemory[idx];
+		itemMemory[idx] = 0;
+		pipeCondition.wakeAll();
+		pipeMutex.unlock();
+
+		itemDone();
+	}
+}
+
+void DkBatchProcessing::copyItem(int idx) {
+
+	pipeMutex.lock();
+	bool stop = canceled;
+	pipeMutex.unlock();
+
+	if (stop)
+		return;
+
+	batchItems[idx].prepare();	// copies, moves or renames the file
+	itemDone();
+}
+
+void DkBatchProcessing::itemDone() {
+
+	pipeMutex.lock();
+	int cDone = ++numDone;
+	pipeMutex.unlock();
+
+	emit progressValueChanged(cDone);
+}
+
 bool DkBatchProcessing::computeItem(DkBatchProcess& item) {
 
 	return item.compute();
@@ -623,7 +1075,298 @@ bool DkBatchProcessing::isComputing() const {
 
 void DkBatchProcessing::cancel() {
 
-	batchWatcher.cancel();
+	QMutexLocker locker(&pipeMutex);
+	canceled = true;
+	pipeCondition.wakeAll();
+}
+
+// DkBatchCommandLine --------------------------------------------------------------------
+DkBatchCommandLine::DkBatchCommandLine() {
+}
+
+/**
+ * Returns true if nomacs should run the batch processing without GUI.
+ * @param args the command line arguments
+ * @return bool true if --batch is among the arguments
+ **/ 
+bool DkBatchCommandLine::isBatchMode(const QStringList& args) {
+
+	return args.contains("--batch");
+}
+
+QString DkBatchCommandLine::usage() {
+
+	return QString(
+		"usage: nomacs --batch [options] files/folders...\n"
+		"  --config <file>          ini file with a [Batch] group, keys are the options below (input = files/folders)\n"
+		"  -o, --output <dir>       output directory\n"
+		"  --pattern <pattern>      file name pattern, e.g. img-<d:3>.jpg (default: <c:0>.<old>)\n"
+		"  --resize <value>         scale factor or side length in px\n"
+		"  --resize-mode <mode>     factor | long | short | width | height (default: factor)\n"
+		"  --resize-only <prop>     decrease | increase\n"
+		"  --interpolation <ipl>    nearest | area | linear | cubic | lanczos (default: area)\n"
+		"  --gamma                  resize in linear RGB\n"
+		"  --rotate <angle>         rotation angle in degrees\n"
+		"  --flip-h, --flip-v       mirror the image\n"
+		"  --compression <0-100>    compression/quality of the saved images\n"
+		"  --memory <MB>            memory budget (default: half of the free memory)\n"
+		"  --io-depth <n>           number of files copied concurrently if no image is processed\n"
+		"  --overwrite              overwrite existing files\n"
+		"  --delete-original        delete the input files if they were processed successfully\n");
 }
 
-}
\ No newline at end of file
+QString DkBatchCommandLine::getError() const {
+
+	return errorMsg;
+}
+
+/**
+ * Creates the batch configuration from a config file (--config) & the command line arguments.
+ * Arguments override the values of the config file.
+ * @param args the command line arguments
+ * @return bool true if the configuration is valid
+ **/ 
+bool DkBatchCommandLine::parse(const QStringList& args) {
+
+	QStringList flags;
+	flags << "--overwrite" << "--delete-original" << "--flip-h" << "--flip-v" << "--gamma";
+	QStringList values;
+	values << "--output" << "--pattern" << "--resize" << "--resize-mode" << "--resize-only" << "--interpolation" 
+		<< "--rotate" << "--compression" << "--memory" << "--io-depth";
+
+	QMap<QString, QString> options;
+	QStringList paths;
+
+	// config file
+	int cfgIdx = args.indexOf("--config");
+	if (cfgIdx != -1) {
+
+		if (cfgIdx+1 >= args.size() || !QFileInfo(args[cfgIdx+1]).exists()) {
+			errorMsg = QObject::tr("I cannot find the config file.");
+			return false;
+		}
+
+		QSettings cfg(args[cfgIdx+1], QSettings::IniFormat);
+		cfg.beginGroup("Batch");
+
+		QStringList keys = cfg.childKeys();
+		for (int idx = 0; idx < keys.size(); idx++) {
+
+			if (keys[idx] == "input")
+				paths << cfg.value(keys[idx]).toStringList();
+			else
+				options.insert("--" + keys[idx], cfg.value(keys[idx]).toString());
+		}
+		cfg.endGroup();
+	}
+
+	// command line arguments (the first one is the executable)
+	for (int idx = 1; idx < args.size(); idx++) {
+
+		QString arg = args[idx];
+
+		if (arg == "--batch")
+			continue;
+		else if (arg == "--config") {
+			idx++;
+			continue;
+		}
+		else if (arg == "-o")
+			arg = "--output";
+
+		if (flags.contains(arg))
+			options.insert(arg, "true");
+		else if (values.contains(arg)) {
+
+			if (idx+1 >= args.size()) {
+				errorMsg = QObject::tr("%1 needs a value.").arg(arg);
+				return false;
+			}
+			options.insert(arg, args[++idx]);
+		}
+		else if (arg.startsWith("-")) {
+			errorMsg = QObject::tr("Unknown option: %1").arg(arg);
+			return false;
+		}
+		else
+			paths << arg;
+	}
+
+	QStringList keys = options.keys();
+	for (int idx = 0; idx < keys.size(); idx++) {
+		if (!flags.contains(keys[idx]) && !values.contains(keys[idx])) {
+			errorMsg = QObject::tr("Unknown option: %1").arg(keys[idx]);
+			return false;
+		}
+	}
+
+	config = DkBatchConfig(collectFiles(paths), options.value("--output"), options.value("--pattern", "<c:0>.<old>"));
+	config.setMode(QVariant(options.value("--overwrite")).toBool() ? DkBatchConfig::mode_overwrite : DkBatchConfig::mode_skip_existing);
+	config.setDeleteOriginal(QVariant(options.value("--delete-original")).toBool());
+
+	bool ok = true;
+
+	if (options.contains("--compression")) {
+		config.setCompression(options.value("--compression").toInt(&ok));
+		if (!ok) {
+			errorMsg = QObject::tr("The compression must be a number.");
+			return false;
+		}
+	}
+
+	if (options.contains("--memory")) {
+		config.setMemoryBudget(options.value("--memory").toFloat(&ok));
+		if (!ok) {
+			errorMsg = QObject::tr("The memory budget must be a number (MB).");
+			return false;
+		}
+	}
+
+	if (options.contains("--io-depth")) {
+		config.setIoDepth(options.value("--io-depth").toInt(&ok));
+		if (!ok) {
+			errorMsg = QObject::tr("The I/O depth must be a number.");
+			return false;
+		}
+	}
+
+	QVector<QSharedPointer<DkAbstractBatch> > processFunctions;
+
+	// resize
+	if (options.contains("--resize")) {
+
+		float value = options.value("--resize").toFloat(&ok);
+		if (!ok || value <= 0) {
+			errorMsg = QObject::tr("--resize needs a positive number.");
+			return false;
+		}
+
+		QStringList modes;
+		modes << "factor" << "long" << "short" << "width" << "height";
+		int mode = modes.indexOf(options.value("--resize-mode", "factor"));
+
+		QStringList props;
+		props << "" << "decrease" << "increase";
+		int prop = props.indexOf(options.value("--resize-only"));
+
+		QStringList ipls;
+		ipls << "nearest" << "area" << "linear" << "cubic" << "lanczos";
+		int ipl = ipls.indexOf(options.value("--interpolation", "area"));
+
+		if (mode == -1 || prop == -1 || ipl == -1) {
+			errorMsg = QObject::tr("Unknown resize mode, property or interpolation.");
+			return false;
+		}
+
+		QSharedPointer<DkResizeBatch> resizeBatch(new DkResizeBatch);
+		resizeBatch->setProperties(value, DkResizeBatch::mode_default + mode, DkResizeBatch::prop_default + prop, 
+			DkImage::ipl_nearest + ipl, QVariant(options.value("--gamma")).toBool());
+
+		if (resizeBatch->isActive())
+			processFunctions.append(resizeBatch);
+	}
+
+	// transform
+	int angle = options.value("--rotate", "0").toInt(&ok);
+	if (!ok) {
+		errorMsg = QObject::tr("The rotation angle must be a number.");
+		return false;
+	}
+
+	QSharedPointer<DkBatchTransform> transformBatch(new DkBatchTransform);
+	transformBatch->setProperties(angle, QVariant(options.value("--flip-h")).toBool(), QVariant(options.value("--flip-v")).toBool());
+
+	if (transformBatch->isActive())
+		processFunctions.append(transformBatch);
+
+	config.setProcessFunctions(processFunctions);
+
+	if (!config.isOk()) {
+
+		if (config.getOutputDirPath().isEmpty())
+			errorMsg = QObject::tr("Please select an output directory.");
+		else if (!QDir(config.getOutputDirPath()).exists())
+			errorMsg = QObject::tr("Sorry, I cannot create %1.").arg(config.getOutputDirPath());
+		else if (config.getFileList().empty())
+			errorMsg = QObject::tr("Sorry, I cannot find files to process.");
+		else
+			errorMsg = QObject::tr("Sorry, the file pattern is empty.");
+		
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * Expands folders to the images they contain.
+ * @param paths files and folders
+ * @return QStringList the files to be processed
+ **/ 
+QStringList DkBatchCommandLine::collectFiles(const QStringList& paths) const {
+
+	QStringList files;
+
+	for (int idx = 0; idx < paths.size(); idx++) {
+
+		QFileInfo fileInfo(paths[idx]);
+
+		if (fileInfo.isDir()) {
+			QFileInfoList dirFiles = QDir(fileInfo.absoluteFilePath()).entryInfoList(DkSettings::app.fileFilters, QDir::Files, QDir::Name);
+			
+			for (int fIdx = 0; fIdx < dirFiles.size(); fIdx++)
+				files << dirFiles[fIdx].absoluteFilePath();
+		}
+		else
+			files << fileInfo.absoluteFilePath();	// missing files are reported by the batch process
+	}
+
+	return files;
+}
+
+/**
+ * Runs the batch processing & reports the results on stdout.
+ * @return int 0 if all files were processed successfully
+ **/ 
+int DkBatchCommandLine::run() {
+
+	QTextStream out(stdout);
+
+	DkBatchProcessing batch(config);
+
+	QEventLoop loop;
+	QObject::connect(&batch, SIGNAL(finished()), &loop, SLOT(quit()));
+
+	DkTimer dt;
+	batch.compute();
+	loop.exec();
+	QString totalTime = dt.getTotal();
+
+	QVector<DkBatchProcess> items = batch.getBatchItems();
+
+	for (int idx = 0; idx < items.size(); idx++) {
+
+		const DkBatchProcess& item = items[idx];
+
+		if (!item.wasProcessed())
+			continue;
+
+		out << (item.hasFailed() ? "[FAIL] " : "[OK]   ") << item.getTime() << " ms\t" 
+			<< item.inputFile().absoluteFilePath() << " -> " << item.outputFile().absoluteFilePath() << "\n";
+
+		if (item.hasFailed()) {
+
+			QStringList log = item.getLog();
+			for (int lIdx = 0; lIdx < log.size(); lIdx++)
+				out << "\t" << log[lIdx] << "\n";
+		}
+	}
+
+	out << QObject::tr("%1/%2 files processed, %3 failed in%4").arg(batch.getNumProcessed()).arg(batch.getNumItems())
+		.arg(batch.getNumFailures()).arg(totalTime) << "\n";
+	out.flush();
+
+	return batch.getNumFailures() ? 1 : 0;
+}
+
+}
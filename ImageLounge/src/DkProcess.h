@@ -34,8 +34,22 @@
 #include <QDir>
 #include <QStringList>
 #include <QUrl>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QThreadPool>
 #pragma warning(pop)		// no warnings from includes - end
 
+#ifndef DllExport
+#ifdef DK_DLL_EXPORT
+#define DllExport Q_DECL_EXPORT
+#elif DK_DLL_IMPORT
+#define DllExport Q_DECL_IMPORT
+#else
+#define DllExport
+#endif
+#endif
+
 // Qt defines
 class QImage;
 
@@ -131,10 +145,23 @@ public:
 	void setProcessChain(const QVector<QSharedPointer<DkAbstractBatch> > processes);
 	void setMode(int mode);
 	void setDeleteOriginal(bool deleteOriginal);
+	void setCompression(int compression);
 	bool compute();	// do the work
+
+	// pipeline stages - compute() runs them in a row
+	bool prepare();
+	bool isFileOperation() const;
+	void readFile();
+	qint64 estimateMemory() const;
+	bool processImage();
+	qint64 encodedSize() const;
+	void writeFile();
+	void abort();
+
 	QStringList getLog() const;
 	bool hasFailed() const;
 	bool wasProcessed() const;
+	int getTime() const;
 	QFileInfo inputFile() const;
 	QFileInfo outputFile() const;
 
@@ -146,14 +173,18 @@ protected:
 	int compression;
 	int failure;
 	bool isProcessed;
+	int time;	// processing time in ms (without waiting in the pipeline)
 
 	QVector<QSharedPointer<DkAbstractBatch> > processFunctions;
 	QStringList logStrings;
 
-	bool process();
+	QSharedPointer<DkImageContainer> imgC;
+	QSharedPointer<QByteArray> saveBuffer;
+
 	bool deleteExisting();
 	bool deleteOriginalFile();
 	bool copyFile();
+	bool moveFile();
 	bool renameFile();
 };
 
@@ -172,6 +203,8 @@ public:
 	void setCompression(int compression) { this->compression = compression; };
 	void setMode(int mode) { this->mode = mode; };
 	void setDeleteOriginal(bool deleteOriginal) { this->deleteOriginal = deleteOriginal; };
+	void setMemoryBudget(float memoryBudget) { this->memoryBudget = memoryBudget; };
+	void setIoDepth(int ioDepth) { this->ioDepth = ioDepth; };
 
 	QStringList getFileList() const { return fileList; };
 	QString getOutputDirPath() const { return outputDirPath; };
@@ -180,6 +213,8 @@ public:
 	int getCompression() const { return compression; };
 	int getMode() const { return mode; };
 	bool getDeleteOriginal() const { return deleteOriginal; };
+	float getMemoryBudget() const { return memoryBudget; };
+	int getIoDepth() const { return ioDepth; };
 
 	enum {
 		mode_overwrite,
@@ -197,6 +232,8 @@ protected:
 	int compression;
 	int mode;
 	bool deleteOriginal;
+	float memoryBudget;		// in MB, <= 0 lets the batch processing decide
+	int ioDepth;			// number of files copied/moved concurrently
 	
 	QVector<QSharedPointer<DkAbstractBatch> > processFunctions;
 };
@@ -228,6 +265,7 @@ public:
 	QList<int> getCurrentResults();
 	QStringList getResultList() const;
 	QString getBatchSummary(const DkBatchProcess& batch) const;
+	QVector<DkBatchProcess> getBatchItems() const { return batchItems; };
 
 	// getter, setter
 	void setBatchConfig(const DkBatchConfig& config) { this->batchConfig = config; };
@@ -248,8 +286,55 @@ protected:
 	
 	// threading
 	QFutureWatcher<void> batchWatcher;
+
+	// pipeline: read -> decode, process & encode -> write
+	QThreadPool pipelinePool;
+	QThreadPool copyPool;		// copy & rename items
+	QMutex pipeMutex;
+	QWaitCondition pipeCondition;
+	QQueue<int> decodeQueue;
+	QQueue<int> writeQueue;
+	QVector<qint64> itemMemory;
+	qint64 memoryUsed;
+	qint64 memoryBudget;
+	int maxQueueSize;
+	int numWorkersRunning;
+	int numDone;
+	bool readingDone;
+	bool canceled;
 	
 	void init();
+	void runPipeline();
+	void readItems();
+	void processItems();
+	void writeItems();
+	void copyItem(int idx);
+	void itemDone();
+
+	friend class DkBatchStage;
+	friend class DkBatchFileOperation;
+};
+
+/**
+ * Runs the batch processing from the command line - no widgets are created.
+ **/ 
+class DllExport DkBatchCommandLine {
+
+public:
+	DkBatchCommandLine();
+
+	static bool isBatchMode(const QStringList& args);
+	static QString usage();
+
+	bool parse(const QStringList& args);
+	QString getError() const;
+	int run();
+
+protected:
+	QStringList collectFiles(const QStringList& paths) const;
+
+	DkBatchConfig config;
+	QString errorMsg;
 };
 
 }
\ No newline at end of file
@@ -430,13 +430,19 @@ void DkSettings::load() {
 	settings.beginGroup("ResourceSettings");
 
 	resources_p.cacheMemory = settings.value("cacheMemory", resources_p.cacheMemory).toFloat();
+	resources_p.batchMemory = settings.value("batchMemory", resources_p.batchMemory).toFloat();
+	resources_p.batchIoDepth = settings.value("batchIoDepth", resources_p.batchIoDepth).toInt();
 	resources_p.maxImagesCached = settings.value("maxImagesCached", resources_p.maxImagesCached).toInt();
 	resources_p.waitForLastImg = settings.value("waitForLastImg", resources_p.waitForLastImg).toBool();
 	resources_p.filterRawImages = settings.value("filterRawImages", resources_p.filterRawImages).toBool();	
+	resources_p.filterRawHalfChroma = settings.value("filterRawHalfChroma", resources_p.filterRawHalfChroma).toBool();	
 	resources_p.loadRawThumb = settings.value("loadRawThumb", resources_p.loadRawThumb).toInt();	
 	resources_p.filterDuplicats = settings.value("filterDuplicates", resources_p.filterDuplicats).toBool();
 	resources_p.preferredExtension = settings.value("preferredExtension", resources_p.preferredExtension).toString();	
 	resources_p.gammaCorrection = settings.value("gammaCorrection", resources_p.gammaCorrection).toBool();
+	resources_p.cacheThumbs = settings.value("cacheThumbs", resources_p.cacheThumbs).toBool();
+	resources_p.thumbCacheSize = settings.value("thumbCacheSize", resources_p.thumbCacheSize).toInt();
+	resources_p.loadReducedSize = settings.value("loadReducedSize", resources_p.loadReducedSize).toBool();
 
 	if (sync_p.switchModifier) {
 		global_p.altMod = Qt::ControlModifier;
@@ -672,12 +678,18 @@ void DkSettings::save(bool force) {
 
 	if (!force && resources_p.cacheMemory != resources_d.cacheMemory)
 		settings.setValue("cacheMemory", resources_p.cacheMemory);
+	if (!force && resources_p.batchMemory != resources_d.batchMemory)
+		settings.setValue("batchMemory", resources_p.batchMemory);
+	if (!force && resources_p.batchIoDepth != resources_d.batchIoDepth)
+		settings.setValue("batchIoDepth", resources_p.batchIoDepth);
 	if (!force && resources_p.maxImagesCached != resources_d.maxImagesCached)
 		settings.setValue("maxImagesCached", resources_p.maxImagesCached);
 	if (!force && resources_p.waitForLastImg != resources_d.waitForLastImg)
 		settings.setValue("waitForLastImg", resources_p.waitForLastImg);
 	if (!force && resources_p.filterRawImages != resources_d.filterRawImages)
 		settings.setValue("filterRawImages", resources_p.filterRawImages);
+	if (!force && resources_p.filterRawHalfChroma != resources_d.filterRawHalfChroma)
+		settings.setValue("filterRawHalfChroma", resources_p.filterRawHalfChroma);
 	if (!force && resources_p.loadRawThumb != resources_d.loadRawThumb)
 		settings.setValue("loadRawThumb", resources_p.loadRawThumb);
 	if (!force && resources_p.filterDuplicats != resources_d.filterDuplicats)
@@ -686,6 +698,12 @@ void DkSettings::save(bool force) {
 		settings.setValue("preferredExtension", resources_p.preferredExtension);
 	if (!force && resources_p.gammaCorrection != resources_d.gammaCorrection)
 		settings.setValue("gammaCorrection", resources_p.gammaCorrection);
+	if (!force && resources_p.cacheThumbs != resources_d.cacheThumbs)
+		settings.setValue("cacheThumbs", resources_p.cacheThumbs);
+	if (!force && resources_p.thumbCacheSize != resources_d.thumbCacheSize)
+		settings.setValue("thumbCacheSize", resources_p.thumbCacheSize);
+	if (!force && resources_p.loadReducedSize != resources_d.loadReducedSize)
+		settings.setValue("loadReducedSize", resources_p.loadReducedSize);
 	settings.endGroup();
 
 	// keep loaded settings in mind
@@ -805,8 +823,11 @@ void DkSettings::setToDefaultSettings() {
 	sync_p.syncActions = false;
 
 	resources_p.cacheMemory = 0;
+	resources_p.batchMemory = 0;
+	resources_p.batchIoDepth = 4;
 	resources_p.maxImagesCached = 5;
 	resources_p.filterRawImages = true;
+	resources_p.filterRawHalfChroma = false;
 	resources_p.loadRawThumb = raw_thumb_always;
 	resources_p.filterDuplicats = false;
 	resources_p.preferredExtension = "*.jpg";
@@ -814,6 +835,9 @@ void DkSettings::setToDefaultSettings() {
 	resources_p.maxThumbsLoading = 5;
 	resources_p.gammaCorrection = true;
 	resources_p.waitForLastImg = true;
+	resources_p.cacheThumbs = true;
+	resources_p.thumbCacheSize = 200;
+	resources_p.loadReducedSize = true;
 
 	qDebug() << "ok... default settings are set";
 }
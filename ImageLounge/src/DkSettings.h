@@ -115,6 +115,7 @@ public:
 		raw_thumb_always,
 		raw_thumb_if_large,
 		raw_thumb_never,
+		raw_thumb_progressive,
 
 		raw_thumb_end,
 	};
@@ -254,15 +255,21 @@ public:
 		
 	struct Resources {
 		float cacheMemory;
+		float batchMemory;
+		int batchIoDepth;
 		int maxImagesCached;
 		bool waitForLastImg;
 		bool filterRawImages;
+		bool filterRawHalfChroma;
 		bool filterDuplicats;
 		int loadRawThumb;
 		QString preferredExtension;
-		int numThumbsLoading;
-		int maxThumbsLoading;
+		int numThumbsLoading;	// running thumbnail requests
+		int maxThumbsLoading;	// read once by the DkThumbScheduler
 		bool gammaCorrection;
+		bool cacheThumbs;
+		int thumbCacheSize;		// in MB
+		bool loadReducedSize;
 	};
 
 	//enums for checkboxes - divide in camera data and description
@@ -513,7 +513,7 @@ void DkDisplaySettingsWidget::createLayout() {
 
 	keepZoomButtonGroup = new QButtonGroup(this);
 
-	keepZoomButtons.resize(DkSettings::raw_thumb_end);
+	keepZoomButtons.resize(DkSettings::zoom_end);
 	keepZoomButtons[DkSettings::zoom_always_keep] = new QRadioButton(tr("Always keep zoom"), this);
 	keepZoomButtons[DkSettings::zoom_keep_same_size] = new QRadioButton(tr("Keep zoom if equal size"), this);
 	keepZoomButtons[DkSettings::zoom_keep_same_size]->setToolTip(tr("If checked, the zoom level is only kept, if the image loaded has the same level as the previous."));
@@ -944,7 +944,9 @@ void DkResourceSettingsWidgets::init() {
 	sliderMemory->setValue(qRound(curCache));
 	this->memorySliderChanged(qRound(curCache));
 	cbFilterRawImages->setChecked(DkSettings::resources.filterRawImages);
+	cbFilterRawHalfChroma->setChecked(DkSettings::resources.filterRawHalfChroma);
 	cbRemoveDuplicates->setChecked(DkSettings::resources.filterDuplicats);
+	cbCacheThumbs->setChecked(DkSettings::resources.cacheThumbs);
 
 	rawThumbButtons[DkSettings::resources.loadRawThumb]->setChecked(true);
 }
@@ -1000,6 +1002,10 @@ void DkResourceSettingsWidgets::createLayout() {
 	cacheLayout->addWidget(memoryGradient,2,0);
 	cacheLayout->addWidget(captionWidget,3,0);
 
+	cbCacheThumbs = new QCheckBox(tr("Cache Thumbnails on Disk"), gbCache);
+	cbCacheThumbs->setToolTip(tr("If checked, thumbnails are stored in the cache directory.\nThe image files are not modified."));
+	cacheLayout->addWidget(cbCacheThumbs,4,0);
+
 	QGroupBox* gbRawLoader = new QGroupBox(tr("Raw Loader Settings"));
 
 	rawThumbButtonGroup = new QButtonGroup(this);
@@ -1009,6 +1015,8 @@ void DkResourceSettingsWidgets::createLayout() {
 	rawThumbButtons[DkSettings::raw_thumb_always] = new QRadioButton(tr("Always load JPG if embedded"), this);
 	rawThumbButtons[DkSettings::raw_thumb_if_large] = new QRadioButton(tr("Load JPG if it fits the screen resolution"), this);
 	rawThumbButtons[DkSettings::raw_thumb_never] = new QRadioButton(tr("Never load embedded JPG"), this);
+	rawThumbButtons[DkSettings::raw_thumb_progressive] = new QRadioButton(tr("Show embedded JPG first, then develop the RAW"), this);
+	rawThumbButtons[DkSettings::raw_thumb_progressive]->setToolTip(tr("The embedded JPG is replaced by the full RAW image once it is developed in the background."));
 
 	QWidget* rawThumbWidget = new QWidget(this);
 	QVBoxLayout* rawThumbButtonLayout = new QVBoxLayout(rawThumbWidget);
@@ -1043,10 +1051,13 @@ void DkResourceSettingsWidgets::createLayout() {
 
 	QGridLayout* rawLoaderLayout = new QGridLayout(gbRawLoader);
 	cbFilterRawImages = new QCheckBox(tr("filter raw images"));
+	cbFilterRawHalfChroma = new QCheckBox(tr("filter color noise at half resolution"));
+	cbFilterRawHalfChroma->setToolTip(tr("If checked, the color noise filter is faster but fine color details might be lost."));
 
 	rawLoaderLayout->addWidget(rawThumbWidget);
 	rawLoaderLayout->addWidget(dupWidget);
 	rawLoaderLayout->addWidget(cbFilterRawImages);
+	rawLoaderLayout->addWidget(cbFilterRawHalfChroma);
 
 	widgetVBoxLayout->addWidget(gbCache);
 	widgetVBoxLayout->addWidget(gbRawLoader);
@@ -1057,7 +1068,9 @@ void DkResourceSettingsWidgets::writeSettings() {
 
 	DkSettings::resources.cacheMemory = (float)((sliderMemory->value()/stepSize)/100.0 * totalMemory);
 	DkSettings::resources.filterRawImages = cbFilterRawImages->isChecked();
+	DkSettings::resources.filterRawHalfChroma = cbFilterRawHalfChroma->isChecked();
 	DkSettings::resources.filterDuplicats = cbRemoveDuplicates->isChecked();
+	DkSettings::resources.cacheThumbs = cbCacheThumbs->isChecked();
 	DkSettings::resources.preferredExtension = DkSettings::app.fileFilters.at(cmExtensions->currentIndex());
 
 	for (int idx = 0; idx < rawThumbButtons.size(); idx++) {
@@ -314,7 +314,9 @@ private:
 	void createLayout();
 
 	QCheckBox* cbFilterRawImages;
+	QCheckBox* cbFilterRawHalfChroma;
 	QCheckBox* cbRemoveDuplicates;
+	QCheckBox* cbCacheThumbs;
 	QComboBox* cmExtensions;
 	QSlider* sliderMemory;
 	QLabel* labelMemory;
@@ -40,10 +40,223 @@
 #include <QtConcurrentRun>
 #include <QTimer>
 #include <QBuffer>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QCoreApplication>
+#include <QThreadStorage>
+#include <QTemporaryFile>
+#include <QDirIterator>
+#include <QAtomicInt>
+#include <QMap>
+
+#if QT_VERSION >= 0x050000
+#include <QStandardPaths>
+#else
+#include <QDesktopServices>
+#endif
 #pragma warning(pop)		// no warnings from includes - end
 
+#ifdef Q_OS_LINUX
+#include <sys/vfs.h>
+#endif
+
 namespace nmc {
 
+/**
+ * Decoding objects that are reused for all thumbnails computed in a thread.
+ **/ 
+class DkThumbDecodeContext {
+
+public:
+	QImageReader reader;
+	QBuffer buffer;
+};
+
+// deleted by Qt as soon as the thread finishes
+static QThreadStorage<DkThumbDecodeContext*> decodeContexts;
+
+static DkThumbDecodeContext* decodeContext() {
+
+	if (!decodeContexts.hasLocalData())
+		decodeContexts.setLocalData(new DkThumbDecodeContext());
+
+	return decodeContexts.localData();
+}
+
+// DkThumbCache --------------------------------------------------------------------
+/**
+ * Returns the directory where cached thumbnails are stored.
+ * Portable nomacs versions keep the thumbnails next to the executable.
+ * @return QString the thumbnail cache directory.
+ **/ 
+QString DkThumbCache::cacheDir() {
+
+	if (DkSettings::isPortable())
+		return QCoreApplication::applicationDirPath() + "/thumbs";
+
+#if QT_VERSION >= 0x050000
+	QString cachePath = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+#else
+	QString cachePath = QDesktopServices::storageLocation(QDesktopServices::CacheLocation);
+#endif
+
+	return cachePath + "/thumbs";
+}
+
+/**
+ * Returns true if thumbnails of the given file may be cached.
+ * Files within zip archives and files that do not exist are never cached.
+ * @param file the image file
+ * @return bool true if the cache can be used for this file.
+ **/ 
+bool DkThumbCache::isEnabled(const QFileInfo& file) {
+
+	if (!DkSettings::resources.cacheThumbs || DkSettings::app.privateMode)
+		return false;
+
+#ifdef WITH_QUAZIP
+	if (file.absoluteFilePath().contains(DkZipContainer::zipMarker()))
+		return false;
+#endif
+
+	return file.exists() && file.isFile();
+}
+
+/**
+ * Computes the cache file of a thumbnail.
+ * The key is built from the file path, the file size, its modification date
+ * and the parameters the thumbnail was computed with.
+ * Thus, if a file is changed, its old thumbnail is not found anymore.
+ * The thumbnails are distributed to 256 sub folders to keep directories small.
+ * @param file the image file
+ * @param maxThumbSize the maximal thumbnail size
+ * @param minThumbSize the minimal thumbnail size
+ * @param rescale true if the thumbnail is rescaled to maxThumbSize
+ * @return QString the absolute path of the cached thumbnail.
+ **/ 
+QString DkThumbCache::cacheFilePath(const QFileInfo& file, int maxThumbSize, int minThumbSize, bool rescale) {
+
+	QString key = file.absoluteFilePath() + "|" + 
+		QString::number(file.size()) + "|" + 
+		QString::number(file.lastModified().toMSecsSinceEpoch()) + "|" + 
+		QString::number(maxThumbSize) + "|" + 
+		QString::number(minThumbSize) + "|" + 
+		QString::number(rescale ? 1 : 0);
+
+	QString hash = QCryptographicHash::hash(key.toUtf8(), QCryptographicHash::Md5).toHex();
+
+	return cacheDir() + "/" + hash.left(2) + "/" + hash;
+}
+
+/**
+ * Loads a thumbnail from the cache.
+ * @param file the image file
+ * @param maxThumbSize the maximal thumbnail size
+ * @param minThumbSize the minimal thumbnail size
+ * @param rescale true if the thumbnail is rescaled to maxThumbSize
+ * @return QImage the cached thumbnail or a null image if it is not cached.
+ **/ 
+QImage DkThumbCache::load(const QFileInfo& file, int maxThumbSize, int minThumbSize, bool rescale) {
+
+	QImage thumb;
+
+	// the format is detected from the file's content
+	if (!thumb.load(cacheFilePath(file, maxThumbSize, minThumbSize, rescale)))
+		return QImage();
+
+	return thumb;
+}
+
+/**
+ * Saves a thumbnail to the cache.
+ * The thumbnail is first written to a unique temporary file which is then renamed.
+ * So, concurrent readers never see partially written thumbnails and
+ * threads that save the same thumbnail do not write to the same file.
+ * @param file the image file
+ * @param maxThumbSize the maximal thumbnail size
+ * @param minThumbSize the minimal thumbnail size
+ * @param rescale true if the thumbnail is rescaled to maxThumbSize
+ * @param thumb the thumbnail
+ * @return bool true if the thumbnail was saved.
+ **/ 
+bool DkThumbCache::save(const QFileInfo& file, int maxThumbSize, int minThumbSize, bool rescale, const QImage& thumb) {
+
+	if (thumb.isNull())
+		return false;
+
+	pruneOnce();
+
+	QFileInfo cacheFile(cacheFilePath(file, maxThumbSize, minThumbSize, rescale));
+
+	if (!cacheFile.absoluteDir().exists() && !QDir().mkpath(cacheFile.absolutePath()))
+		return false;
+
+	QTemporaryFile tmpFile(cacheFile.absoluteFilePath() + ".XXXXXX.tmp");
+	const char* format = thumb.hasAlphaChannel() ? "PNG" : "JPG";
+
+	if (!tmpFile.open() || !thumb.save(&tmpFile, format, 90))
+		return false;
+
+	tmpFile.close();
+	QFile::remove(cacheFile.absoluteFilePath());
+
+	// another thread might have saved the thumbnail meanwhile
+	if (!tmpFile.rename(cacheFile.absoluteFilePath()))
+		return cacheFile.exists();
+
+	tmpFile.setAutoRemove(false);
+
+	return true;
+}
+
+/**
+ * Prunes the cache once per session (in a background thread).
+ **/ 
+void DkThumbCache::pruneOnce() {
+
+	static QAtomicInt pruned(0);
+
+	if (pruned.testAndSetOrdered(0, 1))
+		QtConcurrent::run(&DkThumbCache::prune, (qint64)DkSettings::resources.thumbCacheSize*1024*1024);
+}
+
+/**
+ * Removes the oldest thumbnails until the cache is smaller than maxSize.
+ * Temporary files that were left behind (e.g. by a crash) are removed too.
+ * @param maxSize the maximal cache size in bytes
+ **/ 
+void DkThumbCache::prune(qint64 maxSize) {
+
+	QMultiMap<QDateTime, QString> cachedFiles;
+	qint64 cacheSize = 0;
+
+	QDirIterator dirIter(cacheDir(), QDir::Files, QDirIterator::Subdirectories);
+	while (dirIter.hasNext()) {
+
+		dirIter.next();
+		QFileInfo cFile = dirIter.fileInfo();
+
+		if (cFile.suffix() == "tmp" && cFile.lastModified().secsTo(QDateTime::currentDateTime()) > 3600) {
+			QFile::remove(cFile.absoluteFilePath());
+			continue;
+		}
+
+		cachedFiles.insert(cFile.lastModified(), cFile.absoluteFilePath());
+		cacheSize += cFile.size();
+	}
+
+	QMultiMap<QDateTime, QString>::const_iterator fIter = cachedFiles.constBegin();
+	for (; fIter != cachedFiles.constEnd() && cacheSize > maxSize; fIter++) {
+
+		QFileInfo cFile(fIter.value());
+		cacheSize -= cFile.size();
+		QFile::remove(cFile.absoluteFilePath());
+	}
+
+	qDebug() << "[DkThumbCache] pruned, cache size: " << cacheSize/(1024*1024) << " MB";
+}
+
+// DkThumbNail --------------------------------------------------------------------
 /**
 * Default constructor.
 * @param file the corresponding file
@@ -108,6 +321,19 @@ QImage DkThumbNail::computeIntern(const QFileInfo file, const QSharedPointer<QBy
 	DkTimer dt;
 	//qDebug() << "[thumb] file: " << file.absoluteFilePath();
 
+	bool useCache = rescale && DkThumbCache::isEnabled(file);
+
+	// see if we have computed the thumbnail before
+	if (useCache && forceLoad == do_not_force) {
+		
+		QImage cachedThumb = DkThumbCache::load(file, maxThumbSize, minThumbSize, rescale);
+
+		if (!cachedThumb.isNull()) {
+			qDebug() << "[thumb] " << file.fileName() << " loaded in: " << dt.getTotal() << " from cache";
+			return cachedThumb;
+		}
+	}
+
 	// see if we can read the thumbnail from the exif data
 	QImage thumb;
 	DkMetaDataT metaData;
@@ -146,16 +372,21 @@ QImage DkThumbNail::computeIntern(const QFileInfo file, const QSharedPointer<QBy
 
 	// as found at: http://olliwang.com/2010/01/30/creating-thumbnail-images-in-qt/
 	QString filePath = (file.isSymLink()) ? file.symLinkTarget() : file.absoluteFilePath();
-	QImageReader* imageReader = 0;
 	
-	if (!ba || ba->isEmpty())
-		imageReader = new QImageReader(filePath);
+	// the reader is reused - so reset everything we set last time
+	DkThumbDecodeContext* context = decodeContext();
+	QImageReader* imageReader = &context->reader;
+	imageReader->setScaledSize(QSize());
+
+	if (!ba || ba->isEmpty()) {
+		imageReader->setFormat(QByteArray());
+		imageReader->setFileName(filePath);
+	}
 	else {
-		QBuffer buffer;
-		buffer.setData(ba->data());
-		buffer.open(QIODevice::ReadOnly);
-		imageReader = new QImageReader(&buffer, QFileInfo(filePath).suffix().toStdString().c_str());
-		buffer.close();
+		context->buffer.setData(*ba);
+		context->buffer.open(QIODevice::ReadOnly);
+		imageReader->setDevice(&context->buffer);
+		imageReader->setFormat(QFileInfo(filePath).suffix().toLatin1());
 	}
 
 	if (thumb.isNull() || (thumb.width() < tS && thumb.height() < tS)) {
@@ -233,16 +464,15 @@ QImage DkThumbNail::computeIntern(const QFileInfo file, const QSharedPointer<QBy
 			thumb = thumb.scaled(QSize(imgW*2, imgH*2), Qt::KeepAspectRatio, Qt::FastTransformation);
 			thumb = thumb.scaled(QSize(imgW, imgH), Qt::KeepAspectRatio, Qt::SmoothTransformation);
 		}
-
-		// is there a nice solution to do so??
-		imageReader->setFileName("josef");	// image reader locks the file -> but there should not be one so we just set it to another file...
 	}
 	else if (rescale) {
 		thumb = thumb.scaled(QSize(imgW, imgH), Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
 	}
 
-	if (imageReader)
-		delete imageReader;
+	// the image reader locks the file - release it
+	imageReader->setDevice(0);
+	context->buffer.close();
+	context->buffer.setData(QByteArray());
 
 	if (orientation != -1 && orientation != 0 && (metaData.isJpg() || metaData.isRaw())) {
 		QTransform rotationMatrix;
@@ -277,6 +507,10 @@ QImage DkThumbNail::computeIntern(const QFileInfo file, const QSharedPointer<QBy
 	}
 
 
+	// keep the thumbnail for the next time - force_exif_thumb results are not cached since they might be incomplete
+	if (useCache && forceLoad != force_exif_thumb && !thumb.isNull())
+		DkThumbCache::save(file, maxThumbSize, minThumbSize, rescale, thumb);
+
 	if (!thumb.isNull())
 		qDebug() << "[thumb] " << file.fileName() << "(" << thumb.width() << " x " << thumb.height() << ") loaded in: " << dt.getTotal() << ((exifThumb) ? " from EXIV" : " from File");
 
@@ -364,10 +598,8 @@ DkThumbNailT::DkThumbNailT(QFileInfo file, QImage img) : DkThumbNail(file, img)
 
 DkThumbNailT::~DkThumbNailT() {
 
-	if (fetching && DkSettings::resources.numThumbsLoading > 0)
-		DkSettings::resources.numThumbsLoading--;
-	thumbWatcher.blockSignals(true);
-	thumbWatcher.cancel();
+	// a running request is dropped by the scheduler
+	cancelFetch();
 }
 
 void DkThumbNailT::fetchColor() {
@@ -404,52 +636,310 @@ void DkThumbNailT::colorLoaded() {
 	qDebug() << "mean color: " << meanColor;
 }
 
-bool DkThumbNailT::fetchThumb(int forceLoad /* = false */,  QSharedPointer<QByteArray> ba) {
+/**
+ * Requests the thumbnail from the DkThumbScheduler.
+ * thumbLoadedSignal is emitted as soon as the thumbnail is computed.
+ * @param forceLoad the loading flag (e.g. exiv only)
+ * @param ba the file buffer (can be empty)
+ * @param priority the DkThumbScheduler priority (if the thumbnail is requested already, its priority might be raised)
+ * @return bool true if a new request was scheduled
+ **/ 
+bool DkThumbNailT::fetchThumb(int forceLoad /* = false */,  QSharedPointer<QByteArray> ba, int priority) {
 
 	if (forceLoad == force_full_thumb || forceLoad == force_save_thumb || forceLoad == save_thumb)
 		img = QImage();
 
-	if (!img.isNull() || !imgExists || fetching)
+	if (!img.isNull() || !imgExists)
+		return false;
+
+	if (fetching) {
+		DkThumbScheduler::instance().raisePriority(this, priority);
 		return false;
+	}
 
 	// we have to do our own bool here
-	// watcher.isRunning() returns false if the thread is waiting in the pool
+	// the request might wait in the scheduler's queue
 	fetching = true;
 	this->forceLoad = forceLoad;
 
-	connect(&thumbWatcher, SIGNAL(finished()), this, SLOT(thumbLoaded()));
-	thumbWatcher.setFuture(QtConcurrent::run(this, 
-		&nmc::DkThumbNailT::computeCall, forceLoad, ba));
-	
-	DkSettings::resources.numThumbsLoading++;
+	// no rescale if we load from exif - memory should not be an issue here
+	if (forceLoad == DkThumbNailT::force_exif_thumb)
+		rescale = false;
+
+	DkThumbScheduler::instance().schedule(this, forceLoad, ba, priority);
 
 	return true;
 }
 
+/**
+ * Cancels a pending request.
+ * Requests that are computed already cannot be cancelled.
+ * @return bool true if the request was cancelled.
+ **/ 
+bool DkThumbNailT::cancelFetch() {
 
-QImage DkThumbNailT::computeCall(int forceLoad, QSharedPointer<QByteArray> ba) {
+	if (!fetching || !DkThumbScheduler::instance().cancel(this))
+		return false;
 
-	// no rescale if we load from exif - memory should not be an issue here
-	if (forceLoad == DkThumbNailT::force_exif_thumb)
-		rescale = false;
+	fetching = false;
 
-	return DkThumbNail::computeIntern(file, ba, forceLoad, maxThumbSize, minThumbSize, rescale);
+	return true;
 }
 
-void DkThumbNailT::thumbLoaded() {
+void DkThumbNailT::thumbLoaded(const QImage& thumb) {
 	
-	QFuture<QImage> future = thumbWatcher.future();
-
-	img = future.result();
+	img = thumb;
 	
 	if (img.isNull() && forceLoad != force_exif_thumb)
 		imgExists = false;
 
 	fetching = false;
-	DkSettings::resources.numThumbsLoading--;
 	emit thumbLoadedSignal(!img.isNull());
 }
 
+// DkThumbRequest --------------------------------------------------------------------
+DkThumbRequest::DkThumbRequest(int id, DkThumbNailT* thumb, int forceLoad, QSharedPointer<QByteArray> ba, int priority, int source) {
+
+	this->id = id;
+	this->thumb = thumb;
+	this->forceLoad = forceLoad;
+	this->ba = ba;
+	this->priority = priority;
+	this->source = source;
+
+	if (thumb)
+		thumbData = *thumb;
+}
+
+// DkThumbScheduler --------------------------------------------------------------------
+DkThumbScheduler::DkThumbScheduler(QObject* parent) : QObject(parent) {
+
+	lastId = 0;
+
+	for (int idx = 0; idx < source_end; idx++)
+		numRunning[idx] = 0;
+
+	sourceLimits[source_local] = qMax(DkSettings::resources.maxThumbsLoading, 1);
+	sourceLimits[source_network] = 2;
+	sourceLimits[source_zip] = 1;	// the archive is opened for every thumbnail
+
+	int numThreads = 0;
+	for (int idx = 0; idx < source_end; idx++)
+		numThreads += sourceLimits[idx];
+	pool.setMaxThreadCount(numThreads);
+}
+
+DkThumbScheduler::~DkThumbScheduler() {
+
+	// the pool waits for running requests - their results are dropped
+	for (int idx = 0; idx < priority_end; idx++)
+		queues[idx].clear();
+	requests.clear();
+	pendingIds.clear();
+}
+
+/**
+ * Returns the scheduler shared by all thumbnails.
+ * @return DkThumbScheduler& the thumbnail scheduler.
+ **/ 
+DkThumbScheduler& DkThumbScheduler::instance() {
+
+	static QPointer<DkThumbScheduler> inst;
+	if (!inst)
+		inst = new DkThumbScheduler(QCoreApplication::instance());
+	return *inst;
+}
+
+/**
+ * Queues a thumbnail request.
+ * @param thumb the thumbnail that receives the result
+ * @param forceLoad the loading flag (e.g. exiv only)
+ * @param ba the file buffer (can be empty)
+ * @param priority the request's priority
+ **/ 
+void DkThumbScheduler::schedule(DkThumbNailT* thumb, int forceLoad, QSharedPointer<QByteArray> ba, int priority) {
+
+	if (!thumb)
+		return;
+
+	if (pendingIds.contains(thumb)) {
+		raisePriority(thumb, priority);
+		return;
+	}
+
+	priority = qBound(0, priority, (int)priority_end-1);
+	int id = ++lastId;
+
+	requests.insert(id, DkThumbRequest(id, thumb, forceLoad, ba, priority, fileSource(thumb->getFile())));
+	pendingIds.insert(thumb, id);
+	queues[priority].append(id);
+
+	dispatch();
+}
+
+/**
+ * Moves a pending request to a more important queue.
+ * @param thumb the requested thumbnail
+ * @param priority the new priority (lower priorities are ignored)
+ **/ 
+void DkThumbScheduler::raisePriority(DkThumbNailT* thumb, int priority) {
+
+	int id = pendingIds.value(thumb, -1);
+
+	if (id == -1)
+		return;
+
+	DkThumbRequest& request = requests[id];
+
+	if (priority >= request.priority || priority < 0)
+		return;
+
+	queues[request.priority].removeOne(id);
+	queues[priority].append(id);
+	request.priority = priority;
+}
+
+/**
+ * Removes a pending request.
+ * @param thumb the requested thumbnail
+ * @return bool true if a pending request was removed
+ **/ 
+bool DkThumbScheduler::cancel(DkThumbNailT* thumb) {
+
+	int id = pendingIds.value(thumb, -1);
+
+	if (id == -1)
+		return false;
+
+	queues[requests.value(id).priority].removeOne(id);
+	requests.remove(id);
+	pendingIds.remove(thumb);
+
+	return true;
+}
+
+/**
+ * Returns where a file is read from.
+ * The source of each directory is cached.
+ * @param file the file
+ * @return int the source (local, network or zip)
+ **/ 
+int DkThumbScheduler::fileSource(const QFileInfo& file) {
+
+#ifdef WITH_QUAZIP
+	if (file.absoluteFilePath().contains(DkZipContainer::zipMarker()))
+		return source_zip;
+#endif
+
+	QString dirPath = file.absolutePath();
+
+	if (dirSources.contains(dirPath))
+		return dirSources.value(dirPath);
+
+	int source = source_local;
+
+	// UNC paths
+	if (dirPath.startsWith("//"))
+		source = source_network;
+
+#ifdef Q_OS_LINUX
+	struct statfs fsInfo;
+
+	if (source == source_local && statfs(QFile::encodeName(dirPath).constData(), &fsInfo) == 0) {
+
+		switch ((unsigned int)fsInfo.f_type) {
+		case 0x6969:		// nfs
+		case 0x517B:		// smb
+		case 0xFF534D42:	// cifs
+		case 0xFE534D42:	// smb2
+		case 0x65735546:	// fuse (e.g. sshfs)
+			source = source_network;
+			break;
+		}
+	}
+#endif
+
+	dirSources.insert(dirPath, source);
+
+	return source;
+}
+
+/**
+ * Starts as many requests as the source limits allow.
+ * Requests with a high priority are started first.
+ **/ 
+void DkThumbScheduler::dispatch() {
+
+	for (int pIdx = 0; pIdx < priority_end; pIdx++) {
+
+		QList<int>& queue = queues[pIdx];
+
+		for (int idx = 0; idx < queue.size();) {
+
+			bool allBusy = true;
+			for (int sIdx = 0; sIdx < source_end; sIdx++)
+				allBusy &= numRunning[sIdx] >= sourceLimits[sIdx];
+
+			if (allBusy)
+				return;
+
+			DkThumbRequest& request = requests[queue.at(idx)];
+
+			if (numRunning[request.source] >= sourceLimits[request.source]) {
+				idx++;
+				continue;
+			}
+
+			queue.removeAt(idx);
+			pendingIds.remove(request.thumb.data());
+			numRunning[request.source]++;
+			DkSettings::resources.numThumbsLoading++;
+
+			pool.start(new DkThumbRunnable(this, request));
+		}
+	}
+}
+
+/**
+ * Passes a computed thumbnail to its DkThumbNailT.
+ * This slot is called (queued) by DkThumbRunnable.
+ * @param id the request id
+ * @param thumb the thumbnail (null if it could not be computed)
+ **/ 
+void DkThumbScheduler::requestFinished(int id, const QImage& thumb) {
+
+	if (!requests.contains(id))
+		return;
+
+	DkThumbRequest request = requests.take(id);
+	numRunning[request.source]--;
+	DkSettings::resources.numThumbsLoading--;
+
+	// the thumbnail might be deleted already
+	if (request.thumb)
+		request.thumb->thumbLoaded(thumb);
+
+	dispatch();
+}
+
+// DkThumbRunnable --------------------------------------------------------------------
+DkThumbRunnable::DkThumbRunnable(DkThumbScheduler* scheduler, const DkThumbRequest& request) {
+
+	this->scheduler = scheduler;
+	this->id = request.id;
+	this->forceLoad = request.forceLoad;
+	this->thumbData = request.thumbData;
+	this->ba = request.ba;
+}
+
+void DkThumbRunnable::run() {
+
+	QImage thumb = thumbData.computeIntern(thumbData.getFile(), ba, forceLoad, 
+		thumbData.getMaxThumbSize(), thumbData.getMinThumbSize(), thumbData.rescale);
+
+	QMetaObject::invokeMethod(scheduler, "requestFinished", Qt::QueuedConnection, Q_ARG(int, id), Q_ARG(QImage, thumb));
+}
+
 /**
  * Default constructor of the thumbnail loader.
  * Note: currently the init calls the getFilteredFileList which might be slow.
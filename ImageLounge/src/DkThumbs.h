@@ -34,6 +34,11 @@
 #include <QDir>
 #include <QThread>
 #include <QImage>
+#include <QPointer>
+#include <QHash>
+#include <QList>
+#include <QThreadPool>
+#include <QRunnable>
 #pragma warning(pop)		// no warnings from includes - end
 
 #ifndef DllExport
@@ -50,6 +55,28 @@ namespace nmc {
 
 #define max_thumb_size 160
 
+class DkThumbNailT;
+
+/**
+ * Persistent thumbnail store.
+ * Thumbnails are kept outside the image files (in the user's cache directory)
+ * and are addressed by a hash of the file path, its size and its modification date.
+ * Hence, outdated thumbnails are never returned and the originals are not touched.
+ **/ 
+class DllExport DkThumbCache {
+
+public:
+	static QImage load(const QFileInfo& file, int maxThumbSize, int minThumbSize, bool rescale);
+	static bool save(const QFileInfo& file, int maxThumbSize, int minThumbSize, bool rescale, const QImage& thumb);
+	static bool isEnabled(const QFileInfo& file);
+	static QString cacheDir();
+	static void prune(qint64 maxSize);
+
+protected:
+	static QString cacheFilePath(const QFileInfo& file, int maxThumbSize, int minThumbSize, bool rescale);
+	static void pruneOnce();
+};
+
 /**
  * This class holds thumbnails.
  **/ 
@@ -171,6 +198,8 @@ public:
 	};
 
 protected:
+	friend class DkThumbRunnable;
+
 	QImage computeIntern(QFileInfo file, QSharedPointer<QByteArray> ba, int forceLoad, int maxThumbSize, int minThumbSize, bool rescale);
 	QColor computeColorIntern();
 
@@ -185,6 +214,97 @@ protected:
 	bool colorExists;
 };
 
+/**
+ * A thumbnail request of the DkThumbScheduler.
+ * It keeps a copy of the thumbnail's parameters since the 
+ * worker thread must not touch the thumbnail (it might be deleted meanwhile).
+ **/ 
+class DkThumbRequest {
+
+public:
+	DkThumbRequest(int id = -1, DkThumbNailT* thumb = 0, int forceLoad = DkThumbNail::do_not_force, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>(), int priority = 0, int source = 0);
+
+	int id;
+	int forceLoad;
+	int priority;
+	int source;
+	QPointer<DkThumbNailT> thumb;
+	DkThumbNail thumbData;
+	QSharedPointer<QByteArray> ba;
+};
+
+/**
+ * Schedules the computation of thumbnails.
+ * Requests are queued by priority (visible > near visible > prefetch) and
+ * pending requests can be cancelled if the thumbnails are not needed anymore
+ * (e.g. the user scrolled away). The number of concurrent requests is
+ * limited per source so that slow network shares or zip archives do not
+ * block local files. The thumbnails are computed in a dedicated thread pool.
+ **/ 
+class DllExport DkThumbScheduler : public QObject {
+	Q_OBJECT
+
+public:
+	enum {
+		priority_visible = 0,
+		priority_near,
+		priority_prefetch,
+
+		priority_end
+	};
+
+	enum {
+		source_local = 0,
+		source_network,
+		source_zip,
+
+		source_end
+	};
+
+	static DkThumbScheduler& instance();
+
+	void schedule(DkThumbNailT* thumb, int forceLoad, QSharedPointer<QByteArray> ba, int priority);
+	void raisePriority(DkThumbNailT* thumb, int priority);
+	bool cancel(DkThumbNailT* thumb);
+	int fileSource(const QFileInfo& file);
+
+public slots:
+	void requestFinished(int id, const QImage& thumb);
+
+protected:
+	DkThumbScheduler(QObject* parent = 0);
+	virtual ~DkThumbScheduler();
+
+	void dispatch();
+
+	int lastId;
+	QHash<int, DkThumbRequest> requests;	// id -> pending or running request
+	QHash<DkThumbNailT*, int> pendingIds;	// thumb -> id of its pending request
+	QList<int> queues[priority_end];
+	int numRunning[source_end];
+	int sourceLimits[source_end];
+	QHash<QString, int> dirSources;			// cached source of each directory
+	QThreadPool pool;
+};
+
+/**
+ * Computes one thumbnail of the DkThumbScheduler.
+ **/ 
+class DkThumbRunnable : public QRunnable {
+
+public:
+	DkThumbRunnable(DkThumbScheduler* scheduler, const DkThumbRequest& request);
+
+	void run();
+
+protected:
+	DkThumbScheduler* scheduler;
+	int id;
+	int forceLoad;
+	DkThumbNail thumbData;
+	QSharedPointer<QByteArray> ba;
+};
+
 class DkThumbNailT : public QObject, public DkThumbNail {
 	Q_OBJECT
 
@@ -192,7 +312,8 @@ public:
 	DkThumbNailT(QFileInfo file = QFileInfo(), QImage img = QImage());
 	~DkThumbNailT();
 
-	bool fetchThumb(int forceLoad = do_not_force, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>());
+	bool fetchThumb(int forceLoad = do_not_force, QSharedPointer<QByteArray> ba = QSharedPointer<QByteArray>(), int priority = DkThumbScheduler::priority_visible);
+	bool cancelFetch();
 	void fetchColor();
 
 	/**
@@ -201,7 +322,8 @@ public:
 	 **/ 
 	int hasImage() const {
 		
-		if (thumbWatcher.isRunning())
+		// a scheduled thumbnail might still wait in the queue
+		if (fetching)
 			return loading;
 		else
 			return DkThumbNail::hasImage();
@@ -217,14 +339,14 @@ signals:
 	void colorUpdated();
 
 protected slots:
-	void thumbLoaded();
 	void colorLoaded();
 
 protected:
-	QImage computeCall(int forceLoad, QSharedPointer<QByteArray> ba);
+	friend class DkThumbScheduler;
+
+	void thumbLoaded(const QImage& thumb);
 	QColor computeColorCall();
 
-	QFutureWatcher<QImage> thumbWatcher;
 	QFutureWatcher<QColor> colorWatcher;
 	bool fetching;
 	bool fetchingColor;
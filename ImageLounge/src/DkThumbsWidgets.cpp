@@ -90,6 +90,7 @@ void DkFilePreview::init() {
 	mouseTrace = 0;
 	scrollToCurrentImage = false;
 	isPainted = false;
+	thumbExtentsDirty = true;
 
 	winPercent = 0.1f;
 	borderTrigger = (orientation == Qt::Horizontal) ? (float)width()*winPercent : (float)height()*winPercent;
@@ -163,6 +164,7 @@ void DkFilePreview::initOrientations() {
 	worldMatrix.reset();
 	currentDx = 0;
 	scrollToCurrentImage = true;
+	thumbExtentsDirty = true;
 	update();
 
 }
@@ -225,6 +227,7 @@ void DkFilePreview::paintEvent(QPaintEvent*) {
 		yOffset = qCeil(DkSettings::display.thumbSize*0.1f);
 
 		minHeight = DkSettings::display.thumbSize + yOffset;
+		thumbExtentsDirty = true;
 		
 		if (orientation == Qt::Horizontal)
 			setMaximumSize(QWIDGETSIZE_MAX, minHeight);
@@ -254,10 +257,8 @@ void DkFilePreview::paintEvent(QPaintEvent*) {
 	painter.setWorldTransform(worldMatrix);
 	painter.setWorldMatrixEnabled(true);
 
-	if (thumbs.empty()) {
-		thumbRects.clear();
+	if (thumbs.empty())
 		return;
-	}
 
 	painter.setRenderHint(QPainter::SmoothPixmapTransform);
 	drawThumbs(&painter);
@@ -275,70 +276,58 @@ void DkFilePreview::drawThumbs(QPainter* painter) {
 
 	//qDebug() << "drawing thumbs: " << worldMatrix.dx();
 
+	if (thumbExtentsDirty)
+		updateThumbExtents();
+
 	bufferDim = (orientation == Qt::Horizontal) ? QRectF(QPointF(0, yOffset/2), QSize(xOffset, 0)) : QRectF(QPointF(yOffset/2, 0), QSize(0, xOffset));
-	thumbRects.clear();
 
-	DkTimer dt;
+	if (orientation == Qt::Horizontal)
+		bufferDim.setRight(thumbOffset(thumbs.size()));
+	else
+		bufferDim.setBottom(thumbOffset(thumbs.size()));
+
+	// update file rect for move to current file timer
+	if (scrollToCurrentImage && currentFileIdx >= 0 && currentFileIdx < thumbs.size()) {
+		QRectF r = thumbRect(currentFileIdx);
+		if (!r.isEmpty())
+			newFileRect = worldMatrix.mapRect(r);
+	}
+
+	// just visit the thumbs within the canvas
+	float translation = orientation == Qt::Horizontal ? (float)worldMatrix.dx() : (float)worldMatrix.dy();
+	int limit = orientation == Qt::Horizontal ? width() : height();
+	int firstIdx = thumbAt(qFloor(-translation));
+	int lastIdx = thumbAt(qCeil(-translation + limit));
+	bool extentsChanged = false;
 
 	// mouse over effect
 	QPoint p = worldMatrix.inverted().map(mapFromGlobal(QCursor::pos()));
 
-	for (int idx = 0; idx < thumbs.size(); idx++) {
+	for (int idx = firstIdx; idx <= lastIdx; idx++) {
 
 		QSharedPointer<DkThumbNailT> thumb = thumbs.at(idx)->getThumb();
+		QRectF r = thumbRect(idx);
 
-		if (thumb->hasImage() == DkThumbNail::exists_not) {
-			thumbRects.push_back(QRectF());
-			continue;
+		// the thumbnail might have been loaded by someone else (e.g. the thumbnail scene)
+		int extent = thumbExtent(r.size());
+		if (extent != thumbExtents.at(idx)) {
+			setThumbExtent(idx, extent);
+			extentsChanged = true;
 		}
 
+		// this thumbnail cannot be shown
+		if (r.isEmpty())
+			continue;
+
 		QImage img;
 		if (thumb->hasImage() == DkThumbNail::loaded)
 			img = thumb->getImage();
 
-		QPointF anchor = orientation == Qt::Horizontal ? bufferDim.topRight() : bufferDim.bottomLeft();
-		QRectF r = !img.isNull() ? QRectF(anchor, img.size()) : QRectF(anchor, QSize(DkSettings::display.thumbSize, DkSettings::display.thumbSize));
-		if (orientation == Qt::Horizontal && height()-yOffset < r.height()*2)
-			r.setSize(QSizeF(qFloor(r.width()*(float)(height()-yOffset)/r.height()), height()-yOffset));
-		else if (orientation == Qt::Vertical && width()-yOffset < r.width()*2)
-			r.setSize(QSizeF(width()-yOffset, qFloor(r.height()*(float)(width()-yOffset)/r.width())));
-
-		// check if the size is still valid
-		if (r.width() < 1 || r.height() < 1) 
-			continue;	// this brings us in serious problems with the selection
-
-		// center vertically
-		if (orientation == Qt::Horizontal)
-			r.moveCenter(QPoint(qFloor(r.center().x()), height()/2));
-		else
-			r.moveCenter(QPoint(width()/2, qFloor(r.center().y())));
-
-		// update the buffer dim
-		if (orientation == Qt::Horizontal)
-			bufferDim.setRight(qFloor(bufferDim.right() + r.width()) + cvCeil(xOffset/2.0f));
-		else
-			bufferDim.setBottom(qFloor(bufferDim.bottom() + r.height()) + cvCeil(xOffset/2.0f));
-		thumbRects.push_back(r);
-
 		QRectF imgWorldRect = worldMatrix.mapRect(r);
 
-		// update file rect for move to current file timer
-		if (scrollToCurrentImage && idx == currentFileIdx)
-			newFileRect = imgWorldRect;
-
-		// is the current image within the canvas?
-		if (orientation == Qt::Horizontal && imgWorldRect.right() < 0 || orientation == Qt::Vertical && imgWorldRect.bottom() < 0)
-			continue;
-		if ((orientation == Qt::Horizontal && imgWorldRect.left() > width() || orientation == Qt::Vertical && imgWorldRect.top() > height()) && scrollToCurrentImage) 
-			continue;
-		else if (orientation == Qt::Horizontal && imgWorldRect.left() > width() || orientation == Qt::Vertical && imgWorldRect.top() > height())
-			break;
-
-		if (thumb->hasImage() == DkThumbNail::not_loaded && 
-			DkSettings::resources.numThumbsLoading < DkSettings::resources.maxThumbsLoading) {
-				thumb->fetchThumb();
-				connect(thumb.data(), SIGNAL(thumbLoadedSignal()), this, SLOT(update()));
-		}
+		// the scheduler raises the priority of thumbs that are requested already
+		if (thumb->hasImage() == DkThumbNail::not_loaded || thumb->hasImage() == DkThumbNail::loading)
+			requestThumb(idx, DkThumbScheduler::priority_visible);
 
 		bool isLeftGradient = (orientation == Qt::Horizontal && worldMatrix.dx() < 0 && imgWorldRect.left() < leftGradient.finalStop().x()) ||
 			(orientation == Qt::Vertical && worldMatrix.dy() < 0 && imgWorldRect.top() < leftGradient.finalStop().y());
@@ -363,6 +352,225 @@ void DkFilePreview::drawThumbs(QPainter* painter) {
 
 		//painter->fillRect(QRect(0,0,200, 110), leftGradient);
 	}
+
+	// prefetch the thumbs next to the canvas & drop requests of thumbs that are far away
+	if (firstIdx >= 0 && lastIdx >= firstIdx) {
+
+		int margin = lastIdx-firstIdx+1;
+		int nearFirst = qMax(firstIdx-margin, 0);
+		int nearLast = qMin(lastIdx+margin, thumbs.size()-1);
+
+		for (int idx = nearFirst; idx <= nearLast; idx++) {
+			
+			if (idx < firstIdx || idx > lastIdx)
+				requestThumb(idx, DkThumbScheduler::priority_near);
+		}
+
+		QHash<DkThumbNailT*, int>::iterator tIter = loadingThumbs.begin();
+		while (tIter != loadingThumbs.end()) {
+
+			if ((tIter.value() < nearFirst || tIter.value() > nearLast) && tIter.key()->cancelFetch())
+				tIter = loadingThumbs.erase(tIter);
+			else
+				tIter++;
+		}
+	}
+
+	// thumbs moved - draw them again at their new position
+	if (extentsChanged)
+		update();
+}
+
+/**
+ * Requests a thumbnail that is not loaded yet.
+ * @param idx the thumbnail index
+ * @param priority the DkThumbScheduler priority
+ **/ 
+void DkFilePreview::requestThumb(int idx, int priority) {
+
+	QSharedPointer<DkThumbNailT> thumb = thumbs.at(idx)->getThumb();
+
+	if (thumb->hasImage() != DkThumbNail::not_loaded && thumb->hasImage() != DkThumbNail::loading)
+		return;
+
+	if (thumb->fetchThumb(DkThumbNail::do_not_force, QSharedPointer<QByteArray>(), priority) || 
+		!loadingThumbs.contains(thumb.data())) {
+		loadingThumbs.insert(thumb.data(), idx);
+		connect(thumb.data(), SIGNAL(thumbLoadedSignal()), this, SLOT(thumbLoaded()), Qt::UniqueConnection);
+	}
+}
+
+/**
+ * Returns the size of a thumbnail in the film strip.
+ * @param idx the thumbnail index
+ * @return QSizeF the size or an empty size if the thumbnail cannot be shown.
+ **/ 
+QSizeF DkFilePreview::thumbRectSize(int idx) const {
+
+	QSharedPointer<DkThumbNailT> thumb = thumbs.at(idx)->getThumb();
+
+	if (thumb->hasImage() == DkThumbNail::exists_not)
+		return QSizeF();
+
+	QSizeF s(DkSettings::display.thumbSize, DkSettings::display.thumbSize);
+
+	if (thumb->hasImage() == DkThumbNail::loaded && !thumb->getImage().isNull())
+		s = thumb->getImage().size();
+
+	if (orientation == Qt::Horizontal && height()-yOffset < s.height()*2)
+		s = QSizeF(qFloor(s.width()*(float)(height()-yOffset)/s.height()), height()-yOffset);
+	else if (orientation == Qt::Vertical && width()-yOffset < s.width()*2)
+		s = QSizeF(width()-yOffset, qFloor(s.height()*(float)(width()-yOffset)/s.width()));
+
+	// check if the size is still valid
+	if (s.width() < 1 || s.height() < 1) 
+		return QSizeF();
+
+	return s;
+}
+
+/**
+ * Returns the rectangle of a thumbnail in film strip coordinates.
+ * @param idx the thumbnail index
+ * @return QRectF the rectangle or an empty rectangle if the thumbnail cannot be shown.
+ **/ 
+QRectF DkFilePreview::thumbRect(int idx) const {
+
+	QSizeF s = thumbRectSize(idx);
+
+	if (s.isEmpty())
+		return QRectF();
+
+	int offset = thumbOffset(idx);
+	QPointF anchor = orientation == Qt::Horizontal ? QPointF(offset, yOffset/2) : QPointF(yOffset/2, offset);
+	QRectF r(anchor, s);
+
+	// center vertically
+	if (orientation == Qt::Horizontal)
+		r.moveCenter(QPoint(qFloor(r.center().x()), height()/2));
+	else
+		r.moveCenter(QPoint(width()/2, qFloor(r.center().y())));
+
+	return r;
+}
+
+/**
+ * Returns the space a thumbnail needs along the film strip.
+ * @param size the thumbnail's size (see thumbRectSize)
+ * @return int the extent (including the border) or 0 if the thumbnail is not shown.
+ **/ 
+int DkFilePreview::thumbExtent(const QSizeF& size) const {
+
+	if (size.isEmpty())
+		return 0;
+
+	return qFloor(orientation == Qt::Horizontal ? size.width() : size.height()) + cvCeil(xOffset/2.0f);
+}
+
+/**
+ * Recomputes the extents of all thumbnails.
+ * This is needed if the thumbnails or the widget size change.
+ **/ 
+void DkFilePreview::updateThumbExtents() {
+
+	int n = thumbs.size();
+	thumbExtents.resize(n);
+	extentTree = QVector<int>(n+1, 0);
+
+	for (int idx = 0; idx < n; idx++)
+		thumbExtents[idx] = thumbExtent(thumbRectSize(idx));
+
+	// build the binary indexed tree in O(n)
+	for (int idx = 1; idx <= n; idx++) {
+		extentTree[idx] += thumbExtents[idx-1];
+		int pIdx = idx + (idx & -idx);
+		if (pIdx <= n)
+			extentTree[pIdx] += extentTree[idx];
+	}
+
+	thumbExtentsDirty = false;
+}
+
+/**
+ * Updates the extent of a single thumbnail in O(log n).
+ * @param idx the thumbnail index
+ * @param extent the new extent
+ **/ 
+void DkFilePreview::setThumbExtent(int idx, int extent) {
+
+	int delta = extent - thumbExtents[idx];
+
+	if (!delta)
+		return;
+
+	thumbExtents[idx] = extent;
+
+	for (int tIdx = idx+1; tIdx < extentTree.size(); tIdx += tIdx & -tIdx)
+		extentTree[tIdx] += delta;
+}
+
+/**
+ * Returns where a thumbnail starts along the film strip.
+ * @param idx the thumbnail index (thumbs.size() returns the end of the film strip)
+ * @return int the thumbnail's offset in film strip coordinates
+ **/ 
+int DkFilePreview::thumbOffset(int idx) const {
+
+	int offset = xOffset;
+
+	for (int tIdx = idx; tIdx > 0; tIdx -= tIdx & -tIdx)
+		offset += extentTree[tIdx];
+
+	return offset;
+}
+
+/**
+ * Returns the thumbnail at a given position (binary search).
+ * @param pos the position along the film strip
+ * @return int the thumbnail index (clipped to the first/last thumbnail) or -1 if there are no thumbnails
+ **/ 
+int DkFilePreview::thumbAt(int pos) {
+
+	if (thumbExtentsDirty)
+		updateThumbExtents();
+
+	int n = thumbExtents.size();
+
+	if (!n)
+		return -1;
+
+	int step = 1;
+	while (step*2 <= n)
+		step *= 2;
+
+	// find the number of thumbnails that end before pos
+	int idx = 0;
+	int rest = pos - xOffset;
+
+	for (; step > 0; step /= 2) {
+
+		if (idx + step <= n && extentTree[idx + step] <= rest) {
+			idx += step;
+			rest -= extentTree[idx];
+		}
+	}
+
+	return qMin(idx, n-1);
+}
+
+/**
+ * Updates the extent of a thumbnail that was loaded.
+ **/ 
+void DkFilePreview::thumbLoaded() {
+
+	DkThumbNailT* thumb = qobject_cast<DkThumbNailT*>(sender());
+	int idx = loadingThumbs.value(thumb, -1);
+	loadingThumbs.remove(thumb);
+
+	if (!thumbExtentsDirty && idx >= 0 && idx < thumbs.size() && thumbs.at(idx)->getThumb().data() == thumb)
+		setThumbExtent(idx, thumbExtent(thumbRectSize(idx)));
+
+	update();
 }
 
 void DkFilePreview::drawNoImgEffect(QPainter* painter, const QRectF& r) {
@@ -457,6 +665,9 @@ void DkFilePreview::drawFadeOut(QLinearGradient gradient, QRectF imgRect, QImage
 
 void DkFilePreview::resizeEvent(QResizeEvent *event) {
 
+	// the thumbnails are scaled if the film strip is small
+	thumbExtentsDirty = true;
+
 	if (event->size() == event->oldSize() && 
 		(orientation == Qt::Horizontal && this->width() == parent->width()  ||
 		orientation == Qt::Vertical && this->height() == parent->height())) {
@@ -551,12 +762,15 @@ void DkFilePreview::mouseMoveEvent(QMouseEvent *event) {
 		selected = -1;
 
 		// find out where the mouse is
-		for (int idx = 0; idx < thumbRects.size(); idx++) {
+		QPointF sPos = worldMatrix.inverted().map(QPointF(event->pos()));
+		int idx = thumbAt(qFloor(orientation == Qt::Horizontal ? sPos.x() : sPos.y()));
 
-			if (worldMatrix.mapRect(thumbRects.at(idx)).contains(event->pos())) {
+		if (idx != -1) {
+
+			if (thumbRect(idx).contains(sPos)) {
 				selected = idx;
 
-				if (selected <= thumbs.size() && selected >= 0) {
+				if (selected < thumbs.size() && selected >= 0) {
 					QSharedPointer<DkThumbNailT> thumb = thumbs.at(selected)->getThumb();
 					//selectedImg = DkImage::colorizePixmap(QPixmap::fromImage(thumb->getImage()), DkSettings::display.highlightColor, 0.3f);
 
@@ -570,7 +784,6 @@ void DkFilePreview::mouseMoveEvent(QMouseEvent *event) {
 					setToolTip(toolTipInfo);
 					setStatusTip(thumb->getFile().fileName());
 				}
-				break;
 			}
 		}
 
@@ -620,9 +833,12 @@ void DkFilePreview::mouseReleaseEvent(QMouseEvent *event) {
 	if (mouseTrace < 20) {
 
 		// find out where the mouse did click
-		for (int idx = 0; idx < thumbRects.size(); idx++) {
+		QPointF sPos = worldMatrix.inverted().map(QPointF(event->pos()));
+		int idx = thumbAt(qFloor(orientation == Qt::Horizontal ? sPos.x() : sPos.y()));
+
+		if (idx != -1) {
 
-			if (idx < thumbs.size() && worldMatrix.mapRect(thumbRects.at(idx)).contains(event->pos())) {
+			if (thumbRect(idx).contains(sPos)) {
 				if (thumbs.at(idx)->isFromZip()) 
 					emit changeFileSignal(idx - currentFileIdx);
 				else 
@@ -653,6 +869,7 @@ void DkFilePreview::wheelEvent(QWheelEvent *event) {
 
 		if (newSize != DkSettings::display.thumbSize) {
 			DkSettings::display.thumbSize = newSize;
+			thumbExtentsDirty = true;
 			update();
 		}
 	}
@@ -831,6 +1048,13 @@ void DkFilePreview::updateThumbs(QVector<QSharedPointer<DkImageContainerT> > thu
 
 	this->thumbs = thumbs;
 
+	// pending requests of the old folder are not needed anymore
+	QHash<DkThumbNailT*, int>::iterator tIter = loadingThumbs.begin();
+	for (; tIter != loadingThumbs.end(); tIter++)
+		tIter.key()->cancelFetch();
+	loadingThumbs.clear();
+	thumbExtentsDirty = true;
+
 	for (int idx = 0; idx < thumbs.size(); idx++) {
 		if (thumbs.at(idx)->isSelected()) {
 			currentFileIdx = idx;
@@ -878,7 +1102,16 @@ DkThumbLabel::~DkThumbLabel() {}
 
 void DkThumbLabel::setThumb(QSharedPointer<DkThumbNailT> thumb) {
 
+	// labels are recycled by DkThumbScene
+	if (!this->thumb.isNull())
+		disconnect(this->thumb.data(), SIGNAL(thumbLoadedSignal()), this, SLOT(updateLabel()));
+
 	this->thumb = thumb;
+	thumbInitialized = false;
+	fetchingThumb = false;
+	isHovered = false;
+	icon.setPixmap(QPixmap());
+	setFlag(ItemIsSelectable, true);
 
 	if (thumb.isNull())
 		return;
@@ -1040,9 +1273,8 @@ void DkThumbLabel::setVisible(bool visible) {
 
 void DkThumbLabel::paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget* widget) {
 	
-	if (!fetchingThumb && thumb->hasImage() == DkThumbNail::not_loaded && 
-		DkSettings::resources.numThumbsLoading < DkSettings::resources.maxThumbsLoading*2) {
-			thumb->fetchThumb();
+	if (thumb->hasImage() == DkThumbNail::not_loaded || (!fetchingThumb && thumb->hasImage() == DkThumbNail::loading)) {
+			thumb->fetchThumb(DkThumbNail::do_not_force, QSharedPointer<QByteArray>(), DkThumbScheduler::priority_visible);
 			fetchingThumb = true;
 	}
 	else if (!thumbInitialized && (thumb->hasImage() == DkThumbNail::loaded || thumb->hasImage() == DkThumbNail::exists_not)) {
@@ -1132,11 +1364,13 @@ DkThumbScene::DkThumbScene(QWidget* parent /* = 0 */) : QGraphicsScene(parent) {
 	numCols = 0;
 	numRows = 0;
 	firstLayout = true;
+
+	connect(this, SIGNAL(selectionChanged()), this, SLOT(syncSelection()));
 }
 
 void DkThumbScene::updateLayout() {
 
-	if (thumbLabels.empty())
+	if (thumbs.empty())
 		return;
 
 	QSize pSize;
@@ -1146,64 +1380,182 @@ void DkThumbScene::updateLayout() {
 
 	xOffset = qCeil(DkSettings::display.thumbPreviewSize*0.1f);
 	numCols = qMax(qFloor(((float)pSize.width()-xOffset)/(DkSettings::display.thumbPreviewSize + xOffset)), 1);
-	numCols = qMin(thumbLabels.size(), numCols);
-	numRows = qCeil((float)thumbLabels.size()/numCols);
+	numCols = qMin(thumbs.size(), numCols);
+	numRows = qCeil((float)thumbs.size()/numCols);
 
 	qDebug() << "num rows x num cols: " << numCols*numRows;
-	qDebug() << " thumb labels size: " << thumbLabels.size();
+	qDebug() << " thumbs size: " << thumbs.size();
 
 	int tso = DkSettings::display.thumbPreviewSize+xOffset;
 	setSceneRect(0, 0, numCols*tso+xOffset, numRows*tso+xOffset);
-	//int fileIdx = thumbPool->getCurrentFileIdx();
 
 	DkTimer dt;
-	int cYOffset = xOffset;
+	updateVisibleThumbs();
+	qDebug() << "moving takes: " << dt.getTotal();
+
+	// show the first selected thumb
+	if (!views().empty()) {
+		for (int idx = 0; idx < selectedThumbs.size(); idx++) {
+			if (selectedThumbs.testBit(idx)) {
+				views().first()->ensureVisible(thumbRect(idx));
+				break;
+			}
+		}
+	}
 
-	for (int rIdx = 0; rIdx < numRows; rIdx++) {
+	firstLayout = false;
+}
 
-		int cXOffset = xOffset;
+/**
+ * Returns the cell of a thumb in scene coordinates.
+ * @param idx the thumb index
+ * @return QRectF the thumb's cell
+ **/ 
+QRectF DkThumbScene::thumbRect(int idx) const {
 
-		for (int cIdx = 0; cIdx < numCols; cIdx++) {
+	int ps = DkSettings::display.thumbPreviewSize;
+	int tso = ps+xOffset;
+	int cols = qMax(numCols, 1);
 
-			int tIdx = rIdx*numCols+cIdx;
+	return QRectF(xOffset + (idx % cols)*tso, xOffset + (idx / cols)*tso, ps, ps);
+}
 
-			if (tIdx < 0 || tIdx >= thumbLabels.size())
-				break;
+/**
+ * Shows labels for all thumbs in (or close to) the view.
+ * Labels of thumbs that left the view are hidden and recycled.
+ * Call this whenever the view is scrolled or resized.
+ **/ 
+void DkThumbScene::updateVisibleThumbs() {
 
-			DkThumbLabel* cLabel = thumbLabels.at(tIdx);
-			cLabel->setPos(cXOffset, cYOffset);
-			cLabel->updateSize();
+	if (thumbs.empty() || views().empty() || numCols <= 0)
+		return;
+
+	QGraphicsView* view = views().first();
+	QRectF vr = view->mapToScene(view->viewport()->rect()).boundingRect();
+	
+	// one view height is prepared above and below so that scrolling is smooth
+	int tso = DkSettings::display.thumbPreviewSize+xOffset;
+	int overscan = qCeil(vr.height()/tso);
+	int firstRow = qMax(qFloor((vr.top()-xOffset)/tso) - overscan, 0);
+	int lastRow = qMin(qFloor((vr.bottom()-xOffset)/tso) + overscan, numRows-1);
 
-			//if (tIdx == fileIdx)
-			//	cLabel->ensureVisible();
+	int first = firstRow*numCols;
+	int last = qMin((lastRow+1)*numCols, thumbs.size())-1;
 
-			//cLabel->show();
+	blockSignals(true);	// (de)selecting labels must not change selectedThumbs
 
-			cXOffset += DkSettings::display.thumbPreviewSize + xOffset;
+	QHash<int, DkThumbLabel*>::iterator lIter = thumbLabels.begin();
+	while (lIter != thumbLabels.end()) {
+
+		if (lIter.key() < first || lIter.key() > last) {
+			recycleThumbLabel(lIter.value());
+			lIter = thumbLabels.erase(lIter);
 		}
+		else
+			lIter++;
+	}
 
-		// update ypos
-		cYOffset += DkSettings::display.thumbPreviewSize + xOffset;	// 20 for label 
+	for (int idx = first; idx <= last; idx++) {
+
+		DkThumbLabel* label = thumbLabels.value(idx, 0);
+
+		if (!label) {
+			label = (freeLabels.empty()) ? createThumbLabel() : freeLabels.takeLast();
+			label->setThumb(thumbs.at(idx)->getThumb());
+			connect(label->getThumb().data(), SIGNAL(thumbLoadedSignal()), this, SIGNAL(thumbLoadedSignal()), Qt::UniqueConnection);
+			label->show();
+			thumbLabels.insert(idx, label);
+		}
+
+		QRectF r = thumbRect(idx);
+		label->setPos(r.topLeft());
+		label->updateSize();
+		label->setSelected(selectedThumbs.testBit(idx));
+
+		// labels in the view request their thumbs when they are painted
+		if (!vr.intersects(r) && label->getThumb()->hasImage() == DkThumbNail::not_loaded)
+			label->getThumb()->fetchThumb(DkThumbNail::do_not_force, QSharedPointer<QByteArray>(), DkThumbScheduler::priority_near);
 	}
 
-	qDebug() << "moving takes: " << dt.getTotal();
+	blockSignals(false);
+}
+
+DkThumbLabel* DkThumbScene::createThumbLabel() {
+
+	DkThumbLabel* label = new DkThumbLabel();
+	connect(label, SIGNAL(loadFileSignal(QFileInfo&)), this, SLOT(loadFile(QFileInfo&)));
+	connect(label, SIGNAL(showFileSignal(const QFileInfo&)), this, SLOT(showFile(const QFileInfo&)));
+	addItem(label);
+
+	return label;
+}
 
-	for (int idx = 0; idx < thumbLabels.size(); idx++) {
+void DkThumbScene::recycleThumbLabel(DkThumbLabel* label) {
 
-		//if (thumbs.at(idx)->isSelected()) {
-		//	thumbLabels.at(idx)->ensureVisible();
-		//	thumbLabels.at(idx)->setSelected(true);	// not working here?!
-		//}
-		if (thumbLabels.at(idx)->isSelected())
-			thumbLabels.at(idx)->ensureVisible();
+	if (!label->getThumb().isNull()) {
+		disconnect(label->getThumb().data(), SIGNAL(thumbLoadedSignal()), this, SIGNAL(thumbLoadedSignal()));
+		label->getThumb()->cancelFetch();
 	}
 
-	//update();
+	label->hide();
+	label->setThumb(QSharedPointer<DkThumbNailT>());
+	freeLabels.append(label);
+}
 
-	//if (verticalScrollBar()->isVisible())
-	//	verticalScrollBar()->update();
+/**
+ * Copies the selection state of the visible labels to selectedThumbs.
+ **/ 
+void DkThumbScene::syncSelection() {
 
-	firstLayout = false;
+	QHash<int, DkThumbLabel*>::const_iterator lIter = thumbLabels.constBegin();
+	for (; lIter != thumbLabels.constEnd(); lIter++)
+		selectedThumbs.setBit(lIter.key(), lIter.value()->isSelected());
+}
+
+void DkThumbScene::mousePressEvent(QGraphicsSceneMouseEvent* event) {
+
+#if QT_VERSION < 0x050000
+	QGraphicsItem* item = itemAt(event->scenePos());
+#else
+	QGraphicsItem* item = itemAt(event->scenePos(), QTransform());
+#endif
+
+	// QGraphicsScene clears the selection of visible labels only - so we clear the hidden ones
+	// a click on a selected thumb keeps the selection (dragging)
+	bool clearSelection = event->button() == Qt::LeftButton && 
+		!(event->modifiers() & Qt::ControlModifier) && 
+		!(item && item->isSelected());
+
+	if (clearSelection)
+		selectedThumbs.fill(false);
+
+	QGraphicsScene::mousePressEvent(event);
+
+	if (clearSelection)
+		emit selectionChanged();
+}
+
+void DkThumbScene::mouseReleaseEvent(QGraphicsSceneMouseEvent* event) {
+
+#if QT_VERSION < 0x050000
+	QGraphicsItem* item = itemAt(event->scenePos());
+#else
+	QGraphicsItem* item = itemAt(event->scenePos(), QTransform());
+#endif
+
+	// QGraphicsItem selects just the clicked item if it was not moved
+	bool clearSelection = event->button() == Qt::LeftButton && 
+		!(event->modifiers() & Qt::ControlModifier) && 
+		item && (item->flags() & QGraphicsItem::ItemIsSelectable) &&
+		event->scenePos() == event->buttonDownScenePos(Qt::LeftButton);
+
+	if (clearSelection)
+		selectedThumbs.fill(false);
+
+	QGraphicsScene::mouseReleaseEvent(event);
+
+	if (clearSelection)
+		emit selectionChanged();
 }
 
 void DkThumbScene::updateThumbs(QVector<QSharedPointer<DkImageContainerT> > thumbs) {
@@ -1219,31 +1571,18 @@ void DkThumbScene::updateThumbLabels() {
 	DkTimer dt;
 
 	blockSignals(true);	// do not emit selection changed while clearing!
-	clear();	// deletes the thumbLabels
+	QHash<int, DkThumbLabel*>::iterator lIter = thumbLabels.begin();
+	for (; lIter != thumbLabels.end(); lIter++)
+		recycleThumbLabel(lIter.value());
 	blockSignals(false);
 
-	qDebug() << "clearing viewport: " << dt.getTotal();
 	thumbLabels.clear();
-	thumbsNotLoaded.clear();
+	selectedThumbs = QBitArray(thumbs.size(), false);
 
 	qDebug() << "clearing labels takes: " << dt.getTotal();
 
-	for (int idx = 0; idx < thumbs.size(); idx++) {
-		DkThumbLabel* thumb = new DkThumbLabel(thumbs.at(idx)->getThumb());
-		connect(thumb, SIGNAL(loadFileSignal(QFileInfo&)), this, SLOT(loadFile(QFileInfo&)));
-		connect(thumb, SIGNAL(showFileSignal(const QFileInfo&)), this, SLOT(showFile(const QFileInfo&)));
-		connect(thumbs.at(idx).data(), SIGNAL(thumbLoadedSignal()), this, SIGNAL(thumbLoadedSignal()));
-
-		//thumb->show();
-		addItem(thumb);
-		thumbLabels.append(thumb);
-		//thumbsNotLoaded.append(thumb);
-	}
-
 	showFile(QFileInfo());
 
-	qDebug() << "creating labels takes: " << dt.getTotal();
-
 	if (!thumbs.empty())
 		updateLayout();
 
@@ -1275,24 +1614,24 @@ void DkThumbScene::connectLoader(QSharedPointer<DkImageLoader> loader, bool conn
 void DkThumbScene::showFile(const QFileInfo& file) {
 
 	if (file.absoluteFilePath() == QDir::currentPath() || file.absoluteFilePath().isEmpty())
-		emit statusInfoSignal(tr("%1 Images").arg(QString::number(thumbLabels.size())));
+		emit statusInfoSignal(tr("%1 Images").arg(QString::number(thumbs.size())));
 	else
 		emit statusInfoSignal(file.fileName());
 }
 
 void DkThumbScene::ensureVisible(QSharedPointer<DkImageContainerT> img) const {
 
-	if (!img)
+	if (!img || views().empty())
 		return;
 
-	for (DkThumbLabel* label : thumbLabels) {
+	QString filePath = img->file().absoluteFilePath();
 
-		if (label->getThumb()->getFile().absoluteFilePath() == img->file().absoluteFilePath()) {
-			label->ensureVisible();
+	for (int idx = 0; idx < thumbs.size(); idx++) {
+
+		if (thumbs.at(idx)->file().absoluteFilePath() == filePath) {
+			views().first()->ensureVisible(thumbRect(idx));
 			break;
 		}
-
-
 	}
 
 }
@@ -1301,8 +1640,10 @@ void DkThumbScene::toggleThumbLabels(bool show) {
 
 	DkSettings::display.showThumbLabel = show;
 
-	for (int idx = 0; idx < thumbLabels.size(); idx++)
-		thumbLabels.at(idx)->updateLabel();
+	// recycled labels are updated when they are shown
+	QHash<int, DkThumbLabel*>::const_iterator lIter = thumbLabels.constBegin();
+	for (; lIter != thumbLabels.constEnd(); lIter++)
+		lIter.value()->updateLabel();
 
 	//// well, that's not too beautiful
 	//if (DkSettings::display.displaySquaredThumbs)
@@ -1313,8 +1654,9 @@ void DkThumbScene::toggleSquaredThumbs(bool squares) {
 
 	DkSettings::display.displaySquaredThumbs = squares;
 
-	for (int idx = 0; idx < thumbLabels.size(); idx++)
-		thumbLabels.at(idx)->updateLabel();
+	QHash<int, DkThumbLabel*>::const_iterator lIter = thumbLabels.constBegin();
+	for (; lIter != thumbLabels.constEnd(); lIter++)
+		lIter.value()->updateLabel();
 
 	// well, that's not too beautiful
 	if (DkSettings::display.displaySquaredThumbs)
@@ -1359,7 +1701,7 @@ void DkThumbScene::selectAllThumbs(bool selected) {
 void DkThumbScene::selectThumbs(bool selected /* = true */, int from /* = 0 */, int to /* = -1 */) {
 
 	if (to == -1)
-		to = thumbLabels.size()-1;
+		to = thumbs.size()-1;
 
 	if (from > to) {
 		int tmp = to;
@@ -1367,9 +1709,19 @@ void DkThumbScene::selectThumbs(bool selected /* = true */, int from /* = 0 */,
 		from = tmp;
 	}
 
+	from = qMax(from, 0);
+	to = qMin(to, thumbs.size()-1);
+
+	if (from > to)
+		return;
+
+	selectedThumbs.fill(selected, from, to+1);
+
 	blockSignals(true);
-	for (int idx = from; idx <= to && idx < thumbLabels.size(); idx++) {
-		thumbLabels.at(idx)->setSelected(selected);
+	QHash<int, DkThumbLabel*>::const_iterator lIter = thumbLabels.constBegin();
+	for (; lIter != thumbLabels.constEnd(); lIter++) {
+		if (lIter.key() >= from && lIter.key() <= to)
+			lIter.value()->setSelected(selected);
 	}
 	blockSignals(false);
 	emit selectionChanged();
@@ -1503,11 +1855,10 @@ QStringList DkThumbScene::getSelectedFiles() const {
 
 	QStringList fileList;
 
-	for (int idx = 0; idx < thumbLabels.size(); idx++) {
+	for (int idx = 0; idx < selectedThumbs.size() && idx < thumbs.size(); idx++) {
 
-		if (thumbLabels.at(idx) && thumbLabels.at(idx)->isSelected()) {
-			fileList.append(thumbLabels.at(idx)->getThumb()->getFile().absoluteFilePath());
-		}
+		if (selectedThumbs.testBit(idx))
+			fileList.append(thumbs.at(idx)->file().absoluteFilePath());
 	}
 
 	return fileList;
@@ -1515,23 +1866,21 @@ QStringList DkThumbScene::getSelectedFiles() const {
 
 int DkThumbScene::findThumb(DkThumbLabel* thumb) const {
 
-	int thumbIdx = -1;
-
-	for (int idx = 0; idx < thumbLabels.size(); idx++) {
-		if (thumb == thumbLabels.at(idx)) {
-			thumbIdx = idx;
-			break;
-		}
-	}
-
-	return thumbIdx;
+	return thumbLabels.key(thumb, -1);
 }
 
 bool DkThumbScene::allThumbsSelected() const {
 
-	for (DkThumbLabel* label : thumbLabels)
-		if (label->flags() & QGraphicsItem::ItemIsSelectable && !label->isSelected())
+	for (int idx = 0; idx < selectedThumbs.size(); idx++) {
+
+		if (selectedThumbs.testBit(idx))
+			continue;
+
+		// visible labels that cannot be loaded are not selectable
+		DkThumbLabel* label = thumbLabels.value(idx, 0);
+		if (!label || label->flags() & QGraphicsItem::ItemIsSelectable)
 			return false;
+	}
 
 	return true;
 }
@@ -1542,6 +1891,7 @@ DkThumbsView::DkThumbsView(DkThumbScene* scene, QWidget* parent /* = 0 */) : QGr
 	setObjectName("DkThumbsView");
 	this->scene = scene;
 	connect(scene, SIGNAL(thumbLoadedSignal()), this, SLOT(fetchThumbs()));
+	connect(verticalScrollBar(), SIGNAL(valueChanged(int)), scene, SLOT(updateVisibleThumbs()));
 
 	//setDragMode(QGraphicsView::RubberBandDrag);
 
@@ -1771,14 +2121,7 @@ void DkThumbsView::dropEvent(QDropEvent *event) {
 
 void DkThumbsView::fetchThumbs() {
 
-	int maxThreads = DkSettings::resources.maxThumbsLoading*2;
-
-	// don't do anything if it is loading anyway
-	if (DkSettings::resources.numThumbsLoading/* > maxThreads*/) {
-		//qDebug() << "rejected because num thumbs loading: " << 
-		return;
-	}
-
+	// the DkThumbScheduler limits the concurrent requests
 	qDebug() << "currently loading: " << DkSettings::resources.numThumbsLoading << " thumbs";
 
 	//bool firstReached = false;
@@ -1789,9 +2132,6 @@ void DkThumbsView::fetchThumbs() {
 
 	for (int idx = 0; idx < items.size(); idx++) {
 
-		if (!maxThreads)
-			break;
-
 		DkThumbLabel* th = dynamic_cast<DkThumbLabel*>(items.at(idx));
 
 		if (!th) {
@@ -1799,10 +2139,12 @@ void DkThumbsView::fetchThumbs() {
 			continue;
 		}
 
-		if (th->pixmap().isNull()) {
+		// recycled label
+		if (!th->isVisible())
+			continue;
+
+		if (th->pixmap().isNull())
 			th->update();
-			maxThreads--;
-		}
 		//else if (!thumbLabels.at(idx)->pixmap().isNull())
 		//	firstReached = true;
 	}
@@ -2021,6 +2363,8 @@ void DkThumbScrollWidget::resizeEvent(QResizeEvent *event) {
 
 	if (event->oldSize().width() != event->size().width() && isVisible())
 		thumbsScene->updateLayout();
+	else if (event->oldSize().height() != event->size().height() && isVisible())
+		thumbsScene->updateVisibleThumbs();
 
 	DkWidget::resizeEvent(event);
 
@@ -37,6 +37,8 @@
 #include <QGraphicsScene>
 #include <QGraphicsView>
 #include <QDir>
+#include <QBitArray>
+#include <QHash>
 #pragma warning(pop)		// no warnings from includes - end
 
 #include "DkBaseWidgets.h"
@@ -103,6 +105,9 @@ public slots:
 	void setFileInfo(QSharedPointer<DkImageContainerT> cImage);
 	void newPosition();
 
+protected slots:
+	void thumbLoaded();
+
 signals:
 	void loadFileSignal(QFileInfo file);
 	//void loadThumbsSignal(int start, int end);
@@ -133,7 +138,13 @@ private:
 	QTimer* moveImageTimer;
 
 	QRectF bufferDim;
-	QVector<QRectF> thumbRects;
+
+	// the extents of all thumbnails along the film strip are stored in a 
+	// binary indexed tree so that finding the visible thumbs is O(log n)
+	QVector<int> thumbExtents;
+	QVector<int> extentTree;
+	bool thumbExtentsDirty;
+	QHash<DkThumbNailT*, int> loadingThumbs;	// thumb -> index in thumbs
 
 	QLinearGradient leftGradient;
 	QLinearGradient rightGradient;
@@ -172,6 +183,14 @@ private:
 	void drawCurrentImgEffect(QPainter* painter, const QRectF& r);
 	void drawNoImgEffect(QPainter* painter, const QRectF& r);
 	void createContextMenu();
+	QSizeF thumbRectSize(int idx) const;
+	QRectF thumbRect(int idx) const;
+	int thumbExtent(const QSizeF& size) const;
+	void updateThumbExtents();
+	void setThumbExtent(int idx, int extent);
+	int thumbOffset(int idx) const;
+	int thumbAt(int pos);
+	void requestThumb(int idx, int priority);
 
 };
 
@@ -218,6 +237,13 @@ protected:
 	QPointF lastMove;
 };
 
+/**
+ * Shows the thumbnails of a folder in a grid.
+ * The grid is virtualized: the position of each thumbnail is computed from
+ * its index and labels are just created for the visible cells (plus an overscan margin).
+ * Labels that are scrolled out of the view are recycled. The selection is
+ * stored in a bit array indexed like thumbs.
+ **/ 
 class DkThumbScene : public QGraphicsScene {
 	Q_OBJECT
 
@@ -244,6 +270,7 @@ public slots:
 	void selectThumbs(bool select = true, int from = 0, int to = -1);
 	void selectAllThumbs(bool select = true);
 	void updateThumbs(QVector<QSharedPointer<DkImageContainerT> > thumbs);
+	void updateVisibleThumbs();
 	void deleteSelected() const;
 	void copySelected() const;
 	void pasteImages() const;
@@ -254,10 +281,18 @@ signals:
 	void statusInfoSignal(QString msg, int pos = 0);
 	void thumbLoadedSignal();
 
+protected slots:
+	void syncSelection();
+
 protected:
 	QVector<QSharedPointer<DkImageContainerT> > thumbs;
 	void connectLoader(QSharedPointer<DkImageLoader> loader, bool connectSignals = true);
 	//void wheelEvent(QWheelEvent *event);
+	void mousePressEvent(QGraphicsSceneMouseEvent* event);
+	void mouseReleaseEvent(QGraphicsSceneMouseEvent* event);
+	QRectF thumbRect(int idx) const;
+	DkThumbLabel* createThumbLabel();
+	void recycleThumbLabel(DkThumbLabel* label);
 
 	int xOffset;
 	int numRows;
@@ -265,8 +300,9 @@ protected:
 	bool firstLayout;
 	bool itemClicked;
 
-	QVector<DkThumbLabel* > thumbLabels;
-	QList<DkThumbLabel* > thumbsNotLoaded;
+	QHash<int, DkThumbLabel*> thumbLabels;	// thumb index -> visible label
+	QList<DkThumbLabel* > freeLabels;		// hidden labels that can be recycled
+	QBitArray selectedThumbs;				// selection state of all thumbs
 	QSharedPointer<DkImageLoader> loader;
 };
 
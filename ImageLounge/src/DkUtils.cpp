@@ -33,9 +33,31 @@
 #include <sys/sysinfo.h>
 #endif
 
+#ifndef WIN32
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#endif
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+#ifndef RENAME_NOREPLACE
+#define RENAME_NOREPLACE (1 << 0)
+#endif
+#endif
+
 #pragma warning(push, 0)	// no warnings from includes - begin
 #include <QString>
 #include <QFileInfo>
+#include <QFile>
 #include <QDate>
 #include <QRegExp>
 #include <QStringList>
@@ -213,6 +235,50 @@ bool DkUtils::naturalCompare(const QString &s1, const QString &s2, Qt::CaseSensi
 	return QString::compare(s1, s2, cs) < 0;
 }
 
+/**
+ * Computes a key for natural (case insensitive) sorting.
+ * The key is the lower case string in which every number is replaced by
+ * a '0' marker, one character holding the number of significant digits and
+ * the significant digits. Hence, comparing two keys with QString::compare
+ * compares numbers by their value (e.g. img4 < img10) and the strings need
+ * to be parsed just once if lots of strings (e.g. file names) are sorted.
+ * Note that leading zeros are dropped (img01 and img1 have the same key)
+ * and that numbers are compared to other characters by the '0' marker, so
+ * they are sorted after spaces and most punctuation but before letters and '_'.
+ * @param str the string (e.g. a file name)
+ * @return QString the sort key.
+ **/ 
+QString DkUtils::naturalSortKey(const QString& str) {
+
+	QString lStr = str.toLower();
+	QString key;
+	key.reserve(lStr.length()+8);
+
+	for (int idx = 0; idx < lStr.length(); ) {
+
+		if (!lStr[idx].isDigit()) {
+			key.append(lStr[idx]);
+			idx++;
+			continue;
+		}
+
+		// skip leading zeros
+		while (idx < lStr.length() && lStr[idx] == '0')
+			idx++;
+
+		int numStart = idx;
+		while (idx < lStr.length() && lStr[idx].isDigit())
+			idx++;
+
+		// digits are never added directly, so the marker can be compared to any other character
+		key.append(QChar('0'));
+		key.append(QChar((ushort)(idx-numStart)));
+		key.append(lStr.mid(numStart, idx-numStart));
+	}
+
+	return key;
+}
+
 QString DkUtils::getLongestNumber(const QString& str, int startIdx) {
 
 	int idx;
@@ -312,6 +378,192 @@ void DkUtils::mSleep(int ms) {
 }
 
 
+bool DkUtils::copyFile(const QFileInfo& src, const QFileInfo& dst, QString& errorString) {
+
+#ifdef Q_OS_LINUX
+	
+	QByteArray srcPath = QFile::encodeName(src.absoluteFilePath());
+	QByteArray dstPath = QFile::encodeName(dst.absoluteFilePath());
+
+	int srcFd = ::open(srcPath.constData(), O_RDONLY);
+	struct stat srcStat;
+
+	if (srcFd < 0 || fstat(srcFd, &srcStat) != 0) {
+		errorString = QString::fromLocal8Bit(strerror(errno));
+		if (srcFd >= 0)
+			::close(srcFd);
+		return false;
+	}
+
+	int dstFd = ::open(dstPath.constData(), O_WRONLY | O_CREAT | O_EXCL, srcStat.st_mode & 0777);
+
+	if (dstFd < 0) {
+		errorString = QString::fromLocal8Bit(strerror(errno));
+		::close(srcFd);
+		return false;
+	}
+
+	// reflink: the data is shared until it is modified (btrfs, XFS with reflink=1, ...)
+	bool copied = ioctl(dstFd, FICLONE, srcFd) == 0;
+
+#ifdef __NR_copy_file_range
+	// the kernel copies the data (NFS 4.2 & SMB even copy on the server)
+	if (!copied) {
+
+		qint64 remaining = srcStat.st_size;
+
+		while (remaining > 0) {
+			ssize_t n = syscall(__NR_copy_file_range, srcFd, NULL, dstFd, NULL, (size_t)qMin(remaining, (qint64)1 << 30), 0);
+			
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				break;
+			remaining -= n;
+		}
+
+		copied = remaining == 0;
+
+		// start over if the file system does not support it
+		if (!copied && (ftruncate(dstFd, 0) != 0 || lseek(srcFd, 0, SEEK_SET) != 0 || lseek(dstFd, 0, SEEK_SET) != 0)) {
+			errorString = QString::fromLocal8Bit(strerror(errno));
+			::close(srcFd);
+			::close(dstFd);
+			::unlink(dstPath.constData());
+			return false;
+		}
+	}
+#endif
+
+	// streaming copy with large buffers
+	if (!copied) {
+
+		const int bufferSize = 4*1024*1024;
+		QByteArray buffer;
+		buffer.resize(bufferSize);
+		copied = true;
+
+		while (copied) {
+
+			ssize_t nRead = ::read(srcFd, buffer.data(), bufferSize);
+
+			if (nRead < 0 && errno == EINTR)
+				continue;
+			if (nRead <= 0) {
+				copied = nRead == 0;
+				break;
+			}
+
+			const char* ptr = buffer.constData();
+
+			while (nRead > 0) {
+				ssize_t nWritten = ::write(dstFd, ptr, nRead);
+
+				if (nWritten < 0 && errno == EINTR)
+					continue;
+				if (nWritten <= 0) {
+					copied = false;
+					break;
+				}
+				ptr += nWritten;
+				nRead -= nWritten;
+			}
+		}
+
+		if (!copied)
+			errorString = QString::fromLocal8Bit(strerror(errno));
+	}
+
+	::close(srcFd);
+
+	if (::close(dstFd) != 0 && copied) {
+		errorString = QString::fromLocal8Bit(strerror(errno));
+		copied = false;
+	}
+
+	if (!copied)
+		::unlink(dstPath.constData());
+
+	return copied;
+#else
+
+	QFile file(src.absoluteFilePath());
+
+	if (!file.copy(dst.absoluteFilePath())) {
+		errorString = file.errorString();
+		return false;
+	}
+
+	return true;
+#endif
+}
+
+bool DkUtils::moveFile(const QFileInfo& src, const QFileInfo& dst, QString& errorString) {
+
+#ifndef WIN32
+	// NOTE: rename() silently replaces dst - moves run concurrently, so we must never do that
+	QByteArray srcPath = QFile::encodeName(src.absoluteFilePath());
+	QByteArray dstPath = QFile::encodeName(dst.absoluteFilePath());
+	int error = ENOSYS;
+
+#if defined(Q_OS_LINUX) && defined(__NR_renameat2)
+	// same file system: just a new directory entry
+	if (syscall(__NR_renameat2, AT_FDCWD, srcPath.constData(), AT_FDCWD, dstPath.constData(), RENAME_NOREPLACE) == 0)
+		return true;
+
+	error = errno;
+#endif
+
+	// the kernel or the file system does not support renameat2: link() fails if dst exists
+	if (error == ENOSYS || error == EINVAL) {
+
+		if (::link(srcPath.constData(), dstPath.constData()) == 0) {
+
+			if (::unlink(srcPath.constData()) == 0)
+				return true;
+
+			errorString = QString::fromLocal8Bit(strerror(errno));
+			::unlink(dstPath.constData());
+			return false;
+		}
+
+		error = errno;
+
+		// file systems without hard links (e.g. FAT) are handled like different file systems
+		if (error == EPERM || error == EOPNOTSUPP)
+			error = EXDEV;
+	}
+
+	if (error != EXDEV) {
+		errorString = QString::fromLocal8Bit(strerror(error));
+		return false;
+	}
+
+	// different file systems: copyFile() creates dst exclusively (O_EXCL)
+	if (!copyFile(src, dst, errorString))
+		return false;
+
+	QFile file(src.absoluteFilePath());
+
+	if (!file.remove()) {
+		errorString = file.errorString();
+		return false;
+	}
+
+	return true;
+#else
+	// MoveFileEx renames on the same volume
+	QFile file(src.absoluteFilePath());
+
+	if (!file.rename(dst.absoluteFilePath())) {
+		errorString = file.errorString();
+		return false;
+	}
+
+	return true;
+#endif
+}
+
 bool DkUtils::exists(const QFileInfo& file, int waitMs) {
 
 	QFuture<bool> future = QtConcurrent::run(&DkUtils::checkFile, file);
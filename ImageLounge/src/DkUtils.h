@@ -133,6 +133,8 @@ public:
 
 	static bool naturalCompare(const QString& s1, const QString& s2, Qt::CaseSensitivity cs = Qt::CaseSensitive);
 
+	static QString naturalSortKey(const QString& str);
+
 	static QString getLongestNumber(const QString& str, int startIdx = 0);
 
 	static void addLanguages(QComboBox* langCombo, QStringList& languages);
@@ -159,6 +161,27 @@ public:
 	 **/ 
 	static bool exists(const QFileInfo& file, int waitMs = 10);
 	static bool checkFile(const QFileInfo& file);
+
+	/**
+	 * Copies a file without pushing its data through user space if possible.
+	 * Reflinks (copy-on-write clones), copy_file_range and a streaming
+	 * copy with large buffers are tried in this order (Linux).
+	 * @param src the source file
+	 * @param dst the target file, it must not exist
+	 * @param errorString the reason if the copy failed
+	 * @return bool true if the file was copied
+	 **/ 
+	static bool copyFile(const QFileInfo& src, const QFileInfo& dst, QString& errorString);
+
+	/**
+	 * Moves a file - if both files are on the same file system it is just renamed.
+	 * An existing target is never replaced (the move fails instead).
+	 * @param src the source file
+	 * @param dst the target file, it must not exist
+	 * @param errorString the reason if the move failed
+	 * @return bool true if the file was moved
+	 **/ 
+	static bool moveFile(const QFileInfo& src, const QFileInfo& dst, QString& errorString);
 	static QFileInfo urlToLocalFile(const QUrl& url);
 	static QString colorToString(const QColor& col);
 	static QString readableByte(float bytes);
@@ -335,7 +335,7 @@ void DkControlWidget::update() {
 
 void DkControlWidget::showWidgetsSettings() {
 
-	if (viewport->getImage().isNull()) {
+	if (!viewport->getImageStorage()->hasImage()) {
 		showPreview(false);
 		showScroller(false);
 		showMetaData(false);
@@ -367,7 +367,7 @@ void DkControlWidget::showPreview(bool visible) {
 	if (visible && !filePreview->isVisible())
 		filePreview->show();
 	else if (!visible && filePreview->isVisible())
-		filePreview->hide(!viewport->getImage().isNull());	// do not save settings if we have no image in the viewport
+		filePreview->hide(viewport->getImageStorage()->hasImage());	// do not save settings if we have no image in the viewport
 }
 
 void DkControlWidget::showScroller(bool visible) {
@@ -378,7 +378,7 @@ void DkControlWidget::showScroller(bool visible) {
 	if (visible && !folderScroll->isVisible())
 		folderScroll->show();
 	else if (!visible && folderScroll->isVisible())
-		folderScroll->hide(!viewport->getImage().isNull());	// do not save settings if we have no image in the viewport
+		folderScroll->hide(viewport->getImageStorage()->hasImage());	// do not save settings if we have no image in the viewport
 }
 
 void DkControlWidget::showMetaData(bool visible) {
@@ -391,7 +391,7 @@ void DkControlWidget::showMetaData(bool visible) {
 		qDebug() << "showing metadata...";
 	}
 	else if (!visible && metaDataInfo->isVisible())
-		metaDataInfo->hide(!viewport->getImage().isNull());	// do not save settings if we have no image in the viewport
+		metaDataInfo->hide(viewport->getImageStorage()->hasImage());	// do not save settings if we have no image in the viewport
 }
 
 void DkControlWidget::showFileInfo(bool visible) {
@@ -404,7 +404,7 @@ void DkControlWidget::showFileInfo(bool visible) {
 		ratingLabel->block(fileInfoLabel->isVisible());
 	}
 	else if (!visible && fileInfoLabel->isVisible()) {
-		fileInfoLabel->hide(!viewport->getImage().isNull());	// do not save settings if we have no image in the viewport
+		fileInfoLabel->hide(viewport->getImageStorage()->hasImage());	// do not save settings if we have no image in the viewport
 		ratingLabel->block(false);
 	}
 }
@@ -417,7 +417,7 @@ void DkControlWidget::showPlayer(bool visible) {
 	if (visible)
 		player->show();
 	else
-		player->hide(!viewport->getImage().isNull());	// do not save settings if we have no image in the viewport
+		player->hide(viewport->getImageStorage()->hasImage());	// do not save settings if we have no image in the viewport
 }
 
 void DkControlWidget::showOverview(bool visible) {
@@ -429,7 +429,7 @@ void DkControlWidget::showOverview(bool visible) {
 		zoomWidget->show();
 	}
 	else if (!visible && zoomWidget->isVisible()) {
-		zoomWidget->hide(!viewport->getImage().isNull());	// do not save settings if we have no image in the viewport
+		zoomWidget->hide(viewport->getImageStorage()->hasImage());	// do not save settings if we have no image in the viewport
 	}
 
 }
@@ -460,11 +460,11 @@ void DkControlWidget::showHistogram(bool visible) {
 
 	if (visible && !histogram->isVisible()) {
 		histogram->show();
-		if(!viewport->getImage().isNull()) histogram->drawHistogram(viewport->getImage());
+		if (viewport->getImageStorage()->hasImage()) histogram->drawHistogram(viewport->getImageStorage()->getImage(), viewport->getImageStorage()->getImage(0.25f));
 		else  histogram->clearHistogram();
 	}
 	else if (!visible && histogram->isVisible()) {
-		histogram->hide(!viewport->getImage().isNull());	// do not save settings if we have no image in the viewport
+		histogram->hide(viewport->getImageStorage()->hasImage());	// do not save settings if we have no image in the viewport
 	}
 }
 
@@ -477,7 +477,7 @@ void DkControlWidget::showCommentWidget(bool visible) {
 		commentWidget->show();
 	}
 	else if (!visible && commentWidget->isVisible()) {
-		commentWidget->hide(!viewport->getImage().isNull());	// do not save settings if we have no image in the viewport
+		commentWidget->hide(viewport->getImageStorage()->hasImage());	// do not save settings if we have no image in the viewport
 	}
 }
 
@@ -995,12 +995,89 @@ void DkViewPort::setImage(QImage newImg) {
 	update();
 
 	// draw a histogram from the image -> does nothing if the histogram is invisible
-	if (controller->getHistogram()) controller->getHistogram()->drawHistogram(newImg);
+	if (controller->getHistogram()) controller->getHistogram()->drawHistogram(newImg, imgStorage.getImage(0.25f));
 	if (DkSettings::sync.syncMode == DkSettings::sync_mode_remote_display)
 		tcpSendImage(true);
 
 	emit newImageSignal(&newImg);
-	emit zoomSignal((float)(worldMatrix.m11()*imgMatrix.m11()*100));
+	emit zoomSignal(fullSizeZoom()*100);
+}
+
+/**
+ * Replaces the downscaled image with its full resolution.
+ * The current zoom and position are kept.
+ * @param image the image container that was refined.
+ **/ 
+void DkViewPort::setFullSizeImage(QSharedPointer<DkImageContainerT> image) {
+
+	if (!loader || !image || image != loader->getCurrentImage() || !image->hasImage())
+		return;
+
+	QImage newImg = image->image();
+	QTransform wm = worldMatrix;
+
+	imgStorage.setImage(newImg);
+	imgRect = QRectF(0, 0, newImg.width(), newImg.height());
+	oldImgRect = imgRect;
+
+	// the image view rect does not change - so we keep the world matrix
+	updateImageMatrix();
+	worldMatrix = wm;
+
+	controller->getOverview()->setImage(newImg);
+	update();
+
+	emit zoomSignal(fullSizeZoom()*100);
+}
+
+/**
+ * Returns the current image at full resolution.
+ * Images are decoded at screen resolution - if the image is downscaled, the full
+ * resolution is loaded (blocking) since callers edit or save the image.
+ * Use getImageStorage() if the displayed image is sufficient.
+ * @return QImage the current image.
+ **/ 
+QImage DkViewPort::getImage() {
+
+	if (!movie && loader && loader->getCurrentImage() && loader->getCurrentImage()->isDownscaled())
+		loader->getCurrentImage()->loadFullSize();	// replaces the image via setFullSizeImage()
+
+	return DkBaseViewPort::getImage();
+}
+
+/**
+ * Returns the ratio between the displayed image and the image stored in the file.
+ * @return float the ratio (< 1 if the image was decoded at a reduced size).
+ **/ 
+float DkViewPort::fullSizeFactor() {
+
+	if (!loader || !loader->getCurrentImage() || !imgStorage.hasImage())
+		return 1.0f;
+
+	QSize fullSize = loader->getCurrentImage()->getLoader()->getFullSize();
+
+	if (fullSize.isEmpty())
+		return 1.0f;
+
+	return (float)imgStorage.getImage().width()/fullSize.width();
+}
+
+/**
+ * Returns the zoom level with respect to the full resolution image.
+ * @return float the zoom level (1 = 100%).
+ **/ 
+float DkViewPort::fullSizeZoom() {
+
+	return (float)(worldMatrix.m11()*imgMatrix.m11())*fullSizeFactor();
+}
+
+/**
+ * Loads the full resolution image if the downscaled image is shown at (or above) its own resolution.
+ **/ 
+void DkViewPort::loadFullSizeIfZoomed() {
+
+	if (loader && fullSizeZoom() >= fullSizeFactor())
+		loader->loadFullSize();
 }
 
 void DkViewPort::setThumbImage(QImage newImg) {
@@ -1114,14 +1191,17 @@ void DkViewPort::zoom(float factor, QPointF center) {
 
 	tcpSynchronize();
 
-	emit zoomSignal((float)(worldMatrix.m11()*imgMatrix.m11()*100));
+	loadFullSizeIfZoomed();
+
+	emit zoomSignal(fullSizeZoom()*100);
 	
 }
 
 void DkViewPort::zoomTo(float zoomLevel, const QPoint&) {
 
+	// the zoom level refers to the full resolution image
 	worldMatrix.reset();
-	zoom(zoomLevel/(float)imgMatrix.m11());
+	zoom(zoomLevel/((float)imgMatrix.m11()*fullSizeFactor()));
 }
 
 void DkViewPort::resetView() {
@@ -1146,8 +1226,9 @@ void DkViewPort::zoomToFit() {
 
 void DkViewPort::fullView() {
 
+	// 100% of the full resolution image
 	worldMatrix.reset();
-	zoom(1.0f/(float)imgMatrix.m11());
+	zoom(1.0f/((float)imgMatrix.m11()*fullSizeFactor()));
 	showZoom();
 	changeCursor();
 	update();
@@ -1157,7 +1238,7 @@ void DkViewPort::fullView() {
 void DkViewPort::showZoom() {
 
 	QString zoomStr;
-	zoomStr.sprintf("%.1f%%", imgMatrix.m11()*worldMatrix.m11()*100);
+	zoomStr.sprintf("%.1f%%", fullSizeZoom()*100);
 	
 	if (!controller->getZoomWidget()->isVisible())
 		controller->setInfo(zoomStr, 3000, DkControlWidget::bottom_left_label);
@@ -2260,6 +2341,7 @@ void DkViewPort::connectLoader(QSharedPointer<DkImageLoader> loader, bool connec
 	if (connectSignals) {
 		//connect(loader.data(), SIGNAL(imageLoadedSignal(QSharedPointer<DkImageContainerT>, bool)), this, SLOT(updateImage(QSharedPointer<DkImageContainerT>, bool)), Qt::UniqueConnection);
 		connect(loader.data(), SIGNAL(imageUpdatedSignal(QSharedPointer<DkImageContainerT>)), this, SLOT(updateImage(QSharedPointer<DkImageContainerT>)), Qt::UniqueConnection);
+		connect(loader.data(), SIGNAL(imageFullSizeSignal(QSharedPointer<DkImageContainerT>)), this, SLOT(setFullSizeImage(QSharedPointer<DkImageContainerT>)), Qt::UniqueConnection);
 
 		connect(loader.data(), SIGNAL(updateDirSignal(QVector<QSharedPointer<DkImageContainerT> >)), controller->getFilePreview(), SLOT(updateThumbs(QVector<QSharedPointer<DkImageContainerT> >)), Qt::UniqueConnection);
 		connect(loader.data(), SIGNAL(imageUpdatedSignal(QSharedPointer<DkImageContainerT>)), controller->getFilePreview(), SLOT(setFileInfo(QSharedPointer<DkImageContainerT>)), Qt::UniqueConnection);
@@ -2282,6 +2364,7 @@ void DkViewPort::connectLoader(QSharedPointer<DkImageLoader> loader, bool connec
 	else {
 		//connect(loader.data(), SIGNAL(imageLoadedSignal(QSharedPointer<DkImageContainerT>, bool)), this, SLOT(updateImage(QSharedPointer<DkImageContainerT>, bool)), Qt::UniqueConnection);
 		disconnect(loader.data(), SIGNAL(imageUpdatedSignal(QSharedPointer<DkImageContainerT>)), this, SLOT(updateImage(QSharedPointer<DkImageContainerT>)));
+		disconnect(loader.data(), SIGNAL(imageFullSizeSignal(QSharedPointer<DkImageContainerT>)), this, SLOT(setFullSizeImage(QSharedPointer<DkImageContainerT>)));
 
 		disconnect(loader.data(), SIGNAL(updateDirSignal(QVector<QSharedPointer<DkImageContainerT> >)), controller->getFilePreview(), SLOT(updateThumbs(QVector<QSharedPointer<DkImageContainerT> >)));
 		disconnect(loader.data(), SIGNAL(imageUpdatedSignal(QSharedPointer<DkImageContainerT>)), controller->getFilePreview(), SLOT(setFileInfo(QSharedPointer<DkImageContainerT>)));
@@ -2319,6 +2402,16 @@ void DkViewPort::cropImage(DkRotatingRect rect, const QColor& bgCol) {
 		return;
 	}
 
+	// the rect is given in coordinates of the displayed image which might be downscaled
+	int displayedWidth = imgStorage.getImage().width();
+	QImage srcImg = getImage();		// loads the full resolution
+
+	if (displayedWidth > 0 && srcImg.width() != displayedWidth) {
+		double s = (double)srcImg.width()/displayedWidth;
+		tForm = QTransform::fromScale(1.0/s, 1.0/s) * tForm * QTransform::fromScale(s, s);
+		cImgSize *= s;
+	}
+
 	qDebug() << cImgSize;
 
 	double angle = DkMath::normAngleRad(rect.getAngle(), 0, CV_PI*0.5);
@@ -2335,7 +2428,7 @@ void DkViewPort::cropImage(DkRotatingRect rect, const QColor& bgCol) {
 	if (minD > FLT_EPSILON)
 		painter.setRenderHints(QPainter::SmoothPixmapTransform | QPainter::Antialiasing);
 	
-	painter.drawImage(QRect(QPoint(), getImage().size()), getImage(), QRect(QPoint(), getImage().size()));
+	painter.drawImage(QRect(QPoint(), srcImg.size()), srcImg, QRect(QPoint(), srcImg.size()));
 	painter.end();
 
 	QSharedPointer<DkImageContainerT> imgC = loader->getCurrentImage();
@@ -2453,7 +2546,8 @@ void DkViewPortFrameless::zoom(float factor, QPointF center) {
 	update();
 
 	tcpSynchronize();
-	emit zoomSignal((float)(worldMatrix.m11()*imgMatrix.m11()*100));
+	loadFullSizeIfZoomed();
+	emit zoomSignal(fullSizeZoom()*100);
 }
 
 void DkViewPortFrameless::resetView() {
@@ -2500,7 +2594,10 @@ void DkViewPortFrameless::draw(QPainter *painter, float) {
 			painter->drawRect(imgViewRect);
 		}
 
-		painter->drawImage(imgViewRect, imgQt, QRect(QPoint(), imgQt.size()));
+		if (imgStorage.isTiled())
+			imgStorage.drawTiles(painter, imgViewRect, (float)(imgMatrix.m11()*worldMatrix.m11()));
+		else
+			painter->drawImage(imgViewRect, imgQt, QRect(QPoint(), imgQt.size()));
 	}
 	else {
 		painter->drawPixmap(imgViewRect, movie->currentPixmap(), movie->frameRect());
@@ -2907,8 +3004,21 @@ void DkViewPortContrast::draw(QPainter *painter, float) {
 		painter->drawRect(imgViewRect);
 	}
 
-	if (drawFalseColorImg)
-		painter->drawImage(imgViewRect, falseColorImg, imgRect);		// TODO: add storage class for falseColorImg
+	if (drawFalseColorImg && !falseColorImg.isNull()) {
+
+		// just the visible part is converted (the indexed image might be huge)
+		double scale = imgViewRect.width()/falseColorImg.width();
+		QRectF viewRect = painter->worldTransform().inverted().mapRect(QRectF(QPointF(), QSizeF(size())));
+		QRect visRect = QRectF((viewRect.left()-imgViewRect.left())/scale, (viewRect.top()-imgViewRect.top())/scale, 
+			viewRect.width()/scale, viewRect.height()/scale).toAlignedRect().intersected(falseColorImg.rect());
+
+		if (!visRect.isEmpty()) {
+			QRectF targetRect(imgViewRect.left() + visRect.x()*scale, imgViewRect.top() + visRect.y()*scale, visRect.width()*scale, visRect.height()*scale);
+			painter->drawImage(targetRect, falseColorImg.copy(visRect));
+		}
+	}
+	else if (imgStorage.isTiled())
+		imgStorage.drawTiles(painter, imgViewRect, (float)(imgMatrix.m11()*worldMatrix.m11()));
 	else 
 		painter->drawImage(imgViewRect, imgQt, QRect(QPoint(), imgQt.size()));
 
@@ -2934,7 +3044,8 @@ void DkViewPortContrast::setImage(QImage newImg) {
 			imgs = QVector<QImage>(4);
 			std::vector<cv::Mat> planes;
 			
-			cv::Mat imgUC3 = DkImage::qImage2Mat(imgStorage.getImage());
+			QImage imgQt = imgStorage.getImage();
+			const cv::Mat imgUC3 = DkImage::qImage2MatView(imgQt);	// read-only: split copies the channels anyway
 			//int format = imgQt.format();
 			//if (format == QImage::Format_RGB888)
 			//	imgUC3 = Mat(imgQt.height(), imgQt.width(), CV_8UC3, (uchar*)imgQt.bits(), imgQt.bytesPerLine());
@@ -3061,7 +3172,7 @@ QImage DkViewPortContrast::getImage() {
 	if (drawFalseColorImg)
 		return falseColorImg;
 	else
-		return imgStorage.getImage();
+		return DkViewPort::getImage();
 
 }
 
@@ -3070,7 +3181,7 @@ void DkViewPortContrast::drawImageHistogram() {
 
 	if (controller->getHistogram() && controller->getHistogram()->isVisible()) {
 		if(drawFalseColorImg) controller->getHistogram()->drawHistogram(falseColorImg);
-		else controller->getHistogram()->drawHistogram(imgStorage.getImage());
+		else controller->getHistogram()->drawHistogram(imgStorage.getImage(), imgStorage.getImage(0.25f));
 	}
 
 }
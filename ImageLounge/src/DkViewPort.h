@@ -376,6 +376,7 @@ public:
 	virtual void release();
 	
 	void zoom(float factor = 0.5, QPointF center = QPointF(-1,-1));
+	virtual QImage getImage();
 
 	void setFullScreen(bool fullScreen);
 		
@@ -475,6 +476,7 @@ public slots:
 	virtual void setEditedImage(QSharedPointer<DkImageContainerT> img);
 	virtual void setImage(QImage newImg);
 	virtual void setThumbImage(QImage newImg);
+	virtual void setFullSizeImage(QSharedPointer<DkImageContainerT> image);
 
 	void settingsChanged();
 	void pauseMovie(bool paused);
@@ -545,6 +547,9 @@ protected:
 	virtual void drawBackground(QPainter *painter);
 	virtual void updateImageMatrix();
 	void showZoom();
+	float fullSizeFactor();
+	float fullSizeZoom();
+	void loadFullSizeIfZoomed();
 	//QPoint newCenter(QSize s);	// for frameless
 	void toggleLena();
 	void getPixelInfo(const QPoint& pos);
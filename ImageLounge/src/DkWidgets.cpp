@@ -310,43 +310,64 @@ void DkThumbsSaver::processDir(QVector<QSharedPointer<DkImageContainerT> > image
 
 void DkThumbsSaver::thumbLoaded(bool) {
 
+	// other widgets might request the same thumbnail later on
+	if (sender())
+		disconnect(sender(), SIGNAL(thumbLoadedSignal(bool)), this, SLOT(thumbLoaded(bool)));
+
 	numSaved++;
 	emit numFilesSignal(numSaved);
 
-	if (numSaved == images.size() || stop) {
-		if (pd) {
-			pd->close();
-			pd->deleteLater();
-			pd = 0;
-		}
-		stop = true;
-	}
-	else
-		loadNext();
+	if (numSaved == images.size() || stop)
+		stopProgress();
 }
 
+/**
+ * Requests all remaining thumbnails.
+ * The DkThumbScheduler limits the concurrent requests - the prefetch priority
+ * ensures that visible thumbnails (e.g. of the film strip) are computed first.
+ **/ 
 void DkThumbsSaver::loadNext() {
 	
 	if (stop)
 		return;
 
-	int missing = DkSettings::resources.maxThumbsLoading-DkSettings::resources.numThumbsLoading;
-	int numLoading = cLoadIdx+missing;
 	int force = (forceSave) ? DkThumbNail::force_save_thumb : DkThumbNail::save_thumb;
 
-	qDebug() << "missing: " << missing << " num loading: " << numLoading;
-	qDebug() << "loading bounds: " << cLoadIdx << " - " << numLoading;
+	for (; cLoadIdx < images.size() && !stop; cLoadIdx++) {
 
-	for (int idx = cLoadIdx; idx < images.size() && idx < numLoading; idx++) {
-		cLoadIdx++;
-		connect(images.at(idx)->getThumb().data(), SIGNAL(thumbLoadedSignal(bool)), this, SLOT(thumbLoaded(bool)));
-		images.at(idx)->getThumb()->fetchThumb(force);
+		QSharedPointer<DkThumbNailT> thumb = images.at(cLoadIdx)->getThumb();
+		connect(thumb.data(), SIGNAL(thumbLoadedSignal(bool)), this, SLOT(thumbLoaded(bool)));
+		
+		// the file does not exist - we won't get a signal
+		if (!thumb->fetchThumb(force, QSharedPointer<QByteArray>(), DkThumbScheduler::priority_prefetch) && thumb->hasImage() != DkThumbNail::loading) {
+			disconnect(thumb.data(), SIGNAL(thumbLoadedSignal(bool)), this, SLOT(thumbLoaded(bool)));
+			numSaved++;
+			emit numFilesSignal(numSaved);
+		}
 	}
+
+	if (numSaved == images.size())
+		stopProgress();
 }
 
 void DkThumbsSaver::stopProgress() {
 
 	stop = true;
+
+	// closing the dialog emits canceled() again
+	if (pd) {
+		QProgressDialog* dialog = pd;
+		pd = 0;
+		dialog->close();
+		dialog->deleteLater();
+	}
+
+	// drop the requests that are still queued
+	for (int idx = 0; idx < cLoadIdx && idx < images.size(); idx++) {
+		QSharedPointer<DkThumbNailT> thumb = images.at(idx)->getThumb();
+		disconnect(thumb.data(), SIGNAL(thumbLoadedSignal(bool)), this, SLOT(thumbLoaded(bool)));
+		thumb->cancelFetch();
+	}
 }
 
 // DkFileSystemModel --------------------------------------------------------------------
@@ -2262,11 +2283,14 @@ DkHistogram::DkHistogram(QWidget *parent) : DkWidget(parent){
 	isPainted = false;
 	maxValue = 20;
 	scaleFactor = 1;
+
+	connect(&histWatcher, SIGNAL(finished()), this, SLOT(histogramComputed()));
 }
 
 DkHistogram::~DkHistogram() {
 
-
+	histId.fetchAndAddOrdered(1);	// cancel
+	histWatcher.waitForFinished();
 }
 
 /**
@@ -2311,154 +2335,217 @@ void DkHistogram::paintEvent(QPaintEvent*) {
 	}
 }
 
+// histogram counting ----------------------------------------------------------
+struct DkHistogramJob {
+	const QImage* img;
+	int step;					// every step-th row & column is counted
+	const QAtomicInt* currentId;	// the job is canceled if currentId != id
+	int id;
+};
+
 /**
- * Goes through the image and counts pixels values. They are used to create the image histogram.
- * @param currently displayed image
+ * Counts the pixel values of a band of rows.
+ * Every channel has 4 interleaved sub-histograms so that subsequent 
+ * (similar) pixels do not wait for each other's increments.
+ * @param job the histogram job
+ * @param startRow the first row to be processed
+ * @param endRow the row after the last row to be processed
+ * @return QVector<long> 3x256 values or an empty vector if the job was canceled
  **/ 
-void DkHistogram::drawHistogram(QImage imgQt) {
+static QVector<long> histogramRows(const DkHistogramJob* job, int startRow, int endRow) {
 
-	if (!isVisible() || imgQt.isNull()) {
-		setPainted(false);
-		return;
-	}
+	const QImage& img = *job->img;
+	const int step = job->step;
+	const int depth = img.depth();
 
-	DkTimer dt;
+	QVector<int> subHist(3*4*256, 0);
+	int* hR = subHist.data();
+	int* hG = hR + 4*256;
+	int* hB = hG + 4*256;
 
-#ifdef WITH_OPENCV
+	for (int rIdx = startRow; rIdx < endRow; rIdx += step) {
 
+		// check every 64 rows if the image changed meanwhile
+		if ((rIdx-startRow) % (64*step) == 0 && !job->currentId->testAndSetRelaxed(job->id, job->id))
+			return QVector<long>();
 
-	long histValues[3][256];
+		const uchar* line = img.constScanLine(rIdx);
 
-	for (int idx = 0; idx < 256; idx++) {
-		histValues[0][idx] = 0;
-		histValues[1][idx] = 0;
-		histValues[2][idx] = 0;
+		// 8 bit images
+		if (depth == 8) {
+			for (int cIdx = 0, sIdx = 0; cIdx < img.width(); cIdx += step, sIdx = (sIdx+256) & 1023)
+				hR[sIdx + line[cIdx]]++;
+		}
+		// 24 bit images
+		else if (depth == 24) {
+			for (int cIdx = 0, sIdx = 0; cIdx < img.width(); cIdx += step, sIdx = (sIdx+256) & 1023) {
+				const uchar* pixel = line + cIdx*3;
+				hR[sIdx + pixel[0]]++;
+				hG[sIdx + pixel[1]]++;
+				hB[sIdx + pixel[2]]++;
+			}
+		}
+		// 32 bit images
+		else if (depth == 32) {
+			const QRgb* pixel = (const QRgb*)line;
+			for (int cIdx = 0, sIdx = 0; cIdx < img.width(); cIdx += step, sIdx = (sIdx+256) & 1023) {
+				hR[sIdx + qRed(pixel[cIdx])]++;
+				hG[sIdx + qGreen(pixel[cIdx])]++;
+				hB[sIdx + qBlue(pixel[cIdx])]++;
+			}
+		}
+	}
+
+	QVector<long> hist(3*256, 0);
+
+	for (int ch = 0; ch < 3; ch++) {
+		const int* h = hR + ch*4*256;
+		for (int idx = 0; idx < 256; idx++)
+			hist[ch*256+idx] = (long)h[idx] + h[256+idx] + h[512+idx] + h[768+idx];
+	}
+
+	// gray value images count for all channels
+	if (depth == 8) {
+		for (int idx = 0; idx < 256; idx++)
+			hist[256+idx] = hist[512+idx] = hist[idx];
 	}
-	
 
-	// 8 bit images
-	if (imgQt.depth() == 8) {
+	return hist;
+}
 
-		qDebug() << "8 bit histogram -------------------";
+/**
+ * Computes the histogram of an image.
+ * The rows are split into bands which are counted in parallel.
+ * @param img the image
+ * @param step every step-th row and column is counted (approximate histogram if > 1)
+ * @param currentId the computation is canceled if currentId != id
+ * @param id the id of this computation
+ * @return QVector<long> 3x256 values (r, g, b) or an empty vector if the computation was canceled
+ **/ 
+QVector<long> DkHistogram::computeHistogram(QImage img, int step, const QAtomicInt* currentId, int id) {
 
-		for (int rIdx = 0; rIdx < imgQt.height(); rIdx++) {
+	DkTimer dt;
 
-			const unsigned char* pixel = imgQt.constScanLine(rIdx);
+	DkHistogramJob job;
+	job.img = &img;
+	job.step = step;
+	job.currentId = currentId;
+	job.id = id;
 
-			for (int cIdx = 0; cIdx < imgQt.width(); cIdx++, pixel++) {
+	// bands start at multiples of step so that the sampling grid is the same
+	int numRows = (img.height()+step-1)/step;
+	int numBands = qMax(1, qMin(QThread::idealThreadCount(), numRows/64));
+	QList<QFuture<QVector<long> > > futures;
 
-				histValues[0][*pixel]++;
-				histValues[1][*pixel]++;
-				histValues[2][*pixel]++;
-			}
-		}
-	}
-	// 24 bit images
-	else if (imgQt.depth() == 24) {
-		
-		qDebug() << "24 bit histogram -------------------";
+	for (int idx = 1; idx < numBands; idx++)
+		futures.append(QtConcurrent::run(&histogramRows, (const DkHistogramJob*)&job, idx*numRows/numBands*step, qMin((idx+1)*numRows/numBands*step, img.height())));
 
-		// TODO: not tested!!
-		for (int rIdx = 0; rIdx < imgQt.height(); rIdx++) {
+	QVector<long> hist = histogramRows(&job, 0, qMin(numRows/numBands*step, img.height()));
 
-			const unsigned char* pixel = imgQt.constScanLine(rIdx);
+	for (int idx = 0; idx < futures.size(); idx++) {
 
-			for (int cIdx = 0; cIdx < imgQt.width(); cIdx++) {
+		QVector<long> bHist = futures[idx].result();
 
-				// If I understood the api correctly, the first bits are 0 if we have 24bpp & < 8 bits per channel
-				histValues[0][*pixel]++; pixel++;
-				histValues[1][*pixel]++; pixel++;
-				histValues[2][*pixel]++; pixel++;
-			}
+		if (hist.isEmpty() || bHist.isEmpty()) {
+			hist.clear();
+			continue;	// wait for all bands - job lives on our stack
 		}
+
+		for (int vIdx = 0; vIdx < hist.size(); vIdx++)
+			hist[vIdx] += bHist[vIdx];
 	}
-	// 32 bit images
-	else if (imgQt.depth() == 32) {
-		
-		for (int rIdx = 0; rIdx < imgQt.height(); rIdx++) {
-		
-			const QRgb* pixel = (QRgb*)(imgQt.constScanLine(rIdx));
-	
-			for (int cIdx = 0; cIdx < imgQt.width(); cIdx++, pixel++) {
 
-				histValues[0][qRed(*pixel)]++;
-				histValues[1][qGreen(*pixel)]++;
-				histValues[2][qBlue(*pixel)]++;
-			}
-		}
+	qDebug() << "[DkHistogram] computed in" << dt.getTotal() << "step:" << step;
+
+	return hist;
+}
+
+/**
+ * Computes the image histogram in the background and draws it when it is ready.
+ * Computations of a previous image are canceled.
+ * Large images get a fast approximate histogram first (from preview if available, 
+ * otherwise from a subsampled image) which is then refined.
+ * @param imgQt currently displayed image
+ * @param preview a down sampled version of imgQt (e.g. a pyramid level of DkImageStorage)
+ **/ 
+void DkHistogram::drawHistogram(QImage imgQt, QImage preview) {
+
+	// cancel running computations
+	histId.fetchAndAddOrdered(1);
+	refineImg = QImage();
+
+	if (!isVisible() || imgQt.isNull()) {
+		setPainted(false);
+		return;
 	}
 
-	int maxHistValue = 0;
+#ifdef WITH_OPENCV
 
-	for (int idx = 0; idx < 256; idx++) {
-		
-		if (histValues[0][idx] > maxHistValue)
-			maxHistValue = histValues[0][idx];
-		if (histValues[1][idx] > maxHistValue)
-			maxHistValue = histValues[1][idx];
-		if (histValues[2][idx] > maxHistValue)
-			maxHistValue = histValues[2][idx];
+	int numPixels = imgQt.width()*imgQt.height();
+
+	if (numPixels <= approx_pixels) {
+		startHistogram(imgQt, 1);
+		return;
 	}
 
-	//Mat imgMat = DkImage::qImage2Mat(imgQt);
-	//
-	//vector<Mat> imgChannels;
-	//split(imgMat, imgChannels);
+	// approximate histogram first
+	refineImg = imgQt;
 
-	//int noChannels = (imgChannels.size() < 3) ? 1 : 3;
+	if (!preview.isNull() && preview.width()*preview.height() < numPixels) {
+		int step = qMax(qCeil(qSqrt((double)preview.width()*preview.height()/approx_pixels)), 1);
+		startHistogram(preview, step);
+	}
+	else
+		startHistogram(imgQt, qCeil(qSqrt((double)numPixels/approx_pixels)));
 
-	//// Set the number of bins
-	//int histSize = 256;
-	//// Set the ranges for B,G,R
-	//float range[] = { 0, 256 } ;
-	//const float* histRange = { range };
+#else
 
-	//MatND hist;
-	//// note: long == int if compiled with a 32bit compiler
-	//long histValues[3][256];
-	//long maxHistValue = 0;
+	setPainted(false);
+	update();
 
-	//for (int i = 0; i < noChannels; i++) {
+#endif
+}
 
-	//	calcHist( &imgChannels[(noChannels - 1) - i], 1, 0, Mat(), hist, 1, &histSize, &histRange, true, false); // careful! channels are rotated: B,G,R
-	//	
-	//	for (int j = 0; j < 256; j++) histValues[i][j] = hist.at<float>(j);
-	//	hist.setTo(0);
-	//}
+void DkHistogram::startHistogram(QImage img, int step) {
 
-	//if (noChannels == 1) {
+	// the previous computation was canceled (see drawHistogram) - it stops within a few rows
+	histWatcher.waitForFinished();
 
-	//	for (int i = 0; i < 256; i++) {
-	//		histValues[2][i] = histValues[1][i] = histValues[0][i];
-	//		
-	//		if(histValues[0][i] > maxHistValue) maxHistValue = histValues[0][i];
-	//	}
-	//}
-	//else {
+	int id = histId.fetchAndAddOrdered(1)+1;
+	histWatcher.setFuture(QtConcurrent::run(&DkHistogram::computeHistogram, img, step, (const QAtomicInt*)&histId, id));
+}
 
-	//	for (int i = 0; i < 256; i++) {
-	//		long maxRGB = (histValues[0][i] > histValues[1][i]) ? 
-	//			((histValues[0][i] > histValues[2][i]) ? histValues[0][i] : histValues[2][i]) :  
-	//			((histValues[1][i] > histValues[2][i]) ? histValues[1][i] : histValues[2][i]);
+void DkHistogram::histogramComputed() {
 
-	//		if(maxRGB > maxHistValue) maxHistValue = maxRGB;
-	//	}
-	//}
-	//qDebug() << "computing the histogram took me: " << dt.getTotal();
+	QVector<long> histVec = histWatcher.result();
 
-	setMaxHistogramValue(maxHistValue);
-	updateHistogramValues(histValues);
-	setPainted(true);
+	// canceled
+	if (histVec.isEmpty())
+		return;
 
-#else
+	long histValues[3][256];
+	long maxHistValue = 0;
 
-	setPainted(false);
+	for (int ch = 0; ch < 3; ch++) {
+		for (int idx = 0; idx < 256; idx++) {
+			histValues[ch][idx] = histVec[ch*256+idx];
 
-#endif
-	
-	qDebug() << "drawing the histogram took me: " << dt.getTotal();
+			if (histValues[ch][idx] > maxHistValue)
+				maxHistValue = histValues[ch][idx];
+		}
+	}
 
+	setMaxHistogramValue(maxHistValue);
+	updateHistogramValues(histValues);
+	setPainted(maxHistValue > 0);
 	update();
+
+	// refine the approximate histogram
+	if (!refineImg.isNull()) {
+		QImage img = refineImg;
+		refineImg = QImage();
+		startHistogram(img, 1);
+	}
 }
 
 /**
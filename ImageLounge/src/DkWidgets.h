@@ -724,13 +724,24 @@ class DkHistogram : public DkWidget {
 public:
 	DkHistogram(QWidget *parent);
 	~DkHistogram();
-	void drawHistogram(QImage img);
+	void drawHistogram(QImage img, QImage preview = QImage());
 	void clearHistogram();
 	void setMaxHistogramValue(long maxValue);
 	void updateHistogramValues(long histValues[][256]);
 	void setPainted(bool isPainted);
 
+	enum {
+		approx_pixels = 512*512,		// images larger than that get an approximate histogram first
+	};
+
+	static QVector<long> computeHistogram(QImage img, int step, const QAtomicInt* currentId, int id);
+
+public slots:
+	void histogramComputed();
+
 protected:
+	void startHistogram(QImage img, int step);
+
 	virtual void mousePressEvent(QMouseEvent *event);
 	virtual void mouseMoveEvent(QMouseEvent *event);
 	virtual void mouseReleaseEvent(QMouseEvent *event);
@@ -742,7 +753,10 @@ private:
 	long maxValue;
 	bool isPainted;
 	float scaleFactor;
-				
+
+	QFutureWatcher<QVector<long> > histWatcher;
+	QAtomicInt histId;		// running computations stop if the id changes
+	QImage refineImg;		// the image that is counted once the approximate histogram is drawn
 };
 
 class DkSlider : public QWidget {
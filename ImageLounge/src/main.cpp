@@ -53,6 +53,7 @@
 
 #include "DkNoMacs.h"
 #include "DkSettings.h"
+#include "DkProcess.h"
 
 #include <iostream>
 #include <cassert>
@@ -112,6 +113,33 @@ int main(int argc, char *argv[]) {
 	QCoreApplication::setOrganizationDomain("http://www.nomacs.org");
 	QCoreApplication::setApplicationName("Image Lounge");
 	
+	// headless batch processing - no widgets are created, so we do not need a GUI (or a display)
+	QStringList rawArgs;
+	for (int idx = 0; idx < argc; idx++) {
+#ifdef WIN32
+		rawArgs << QString::fromWCharArray(argv[idx]);
+#else
+		rawArgs << QString::fromLocal8Bit(argv[idx]);
+#endif
+	}
+
+	if (nmc::DkBatchCommandLine::isBatchMode(rawArgs)) {
+		
+		QCoreApplication ca(argc, (char**)argv);
+		nmc::DkSettings::initFileFilters();
+		nmc::DkSettings::load();
+
+		nmc::DkBatchCommandLine batch;
+
+		if (!batch.parse(ca.arguments())) {
+			std::cerr << batch.getError().toStdString() << std::endl << std::endl;
+			std::cerr << nmc::DkBatchCommandLine::usage().toStdString();
+			return 1;
+		}
+
+		return batch.run();
+	}
+
 	//qDebug() << "settings: " << settings.fileName();
 
 	// NOTE: raster option destroys the frameless view on mac